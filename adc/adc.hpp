@@ -71,6 +71,7 @@ APIs:
 - @ref adc::factory
 - @ref adc::builder_api
 - @ref adc::publisher_api
+- @ref adc::log_reader_api
 
 Examples:
 - @ref mpiSimpleDemo.cpp demonstrates instrumenting a trivial MPI program.
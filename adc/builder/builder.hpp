@@ -9,6 +9,13 @@
 #include <sstream>
 #include <map>
 #include <memory>
+#include <optional>
+#include <vector>
+#include <cerrno>
+#include <version>
+#if defined(__cpp_lib_span) && __cpp_lib_span >= 202002L
+#include <span>
+#endif
 #if ADC_BOOST_JSON_PUBLIC
 #include "boost/json.hpp"
 #endif
@@ -27,7 +34,7 @@ std::string format_timespec_8601(struct timespec& ts);
 /// @return utc seconds.nanoseconds formatted string based on ts
 std::string format_timespec_utc_ns(struct timespec& ts);
 
-inline version builder_api_version("1.0.0", {"none"});
+inline version builder_api_version("1.1.0", {"none"});
 
 /** @addtogroup builder_add_host_options
  *  @{
@@ -125,6 +132,27 @@ typedef int32_t adc_mpi_field_flags;
 
 /** @}*/
 
+/** @addtogroup builder_parse_options
+ *  @{
+ */
+/** @def ADC_PARSE_
+ * @brief bit values to control factory::parse_builder.
+ *
+ * The ADC_PARSE_* bit values desired are ORd (|) together.
+ */
+#define ADC_PARSE_
+/** OR-d ADC_PARSE_* bits */
+typedef int32_t adc_parse_flags;
+
+/// @brief build every section of the record while parsing.
+#define ADC_PARSE_DEFAULT 0x0
+
+/// @brief build a section only when get_section first asks for it.
+/// get_value does not need the sections built, so tools which only
+/// query values skip the per-section cost.
+#define ADC_PARSE_LAZY 0x1
+/** @}*/
+
 /*!
 @brief The builder api is used to construct structured log (json) messages that follow naming conventions.
 
@@ -237,6 +265,79 @@ public:
 	/// compatible with uint64_t.
 	virtual uint64_t get_value_uint64(std::string_view path) = 0;
 
+	/// @brief copy the existing named scalar into caller storage, without
+	/// allocating an intermediate field.
+	/// @param path a simple json path such as /a/b/c which resolves to
+	///        a value added via one of the add* functions.
+	/// @param st the type the value must have been added as. cp_cstr matches
+	///        any string type, and out is then a std::string.
+	/// @param out address of a variable of the C++ type of st.
+	/// @return 0, ENOENT if path does not resolve to a value,
+	/// or EDOM if the value is an array or was not added as st.
+	virtual int copy_value(std::string_view path, scalar_type st, void *out) = 0;
+
+	/// @brief copy the existing named array into caller storage in a single
+	/// pass, without allocating an intermediate array.
+	/// @param path a simple json path such as /a/b/c which resolves to
+	///        an array added via one of the add_array functions.
+	/// @param st the element type the array must have been added as, as for copy_value.
+	/// @param out array of len elements of the C++ type of st.
+	/// @param len the number of elements out can hold.
+	/// @param count set to the number of elements in the array found.
+	/// @return 0, ENOENT if path does not resolve to a value,
+	/// EDOM if the value is not an array of st, or ERANGE if count > len.
+	/// Nothing is copied if ERANGE is returned; the content of out is
+	/// undefined if EDOM is returned.
+	virtual int copy_array(std::string_view path, scalar_type st, void *out, size_t len, size_t& count) = 0;
+
+	/// @brief get the existing named scalar as type T.
+	/// @return the value, or nothing if path does not resolve to a scalar
+	/// added as type T (see scalar_type_of).
+	///
+	/// Example:
+	///  auto rank = b->get< int32_t >("/app_data/rank");
+	///  if (rank) use(*rank);
+	template< typename T >
+	std::optional< T > get(std::string_view path) {
+		T value{};
+		if (copy_value(path, scalar_type_of< T >(), &value))
+			return std::nullopt;
+		return value;
+	}
+
+	/// @brief copy the existing named array of T into out[0..len).
+	/// @return as copy_array.
+	template< typename T >
+	int get_array(std::string_view path, T *out, size_t len, size_t& count) {
+		return copy_array(path, scalar_type_of< T >(), out, len, count);
+	}
+
+	/// @brief copy the existing named array of T into out, resized to fit.
+	/// Storage already allocated in out is reused.
+	/// @return as copy_array, except that ERANGE does not occur.
+	template< typename T >
+	int get_array(std::string_view path, std::vector< T >& out) {
+		size_t count = 0;
+		if (out.size() < out.capacity())
+			out.resize(out.capacity());
+		int err = copy_array(path, scalar_type_of< T >(), out.data(), out.size(), count);
+		if (err == ERANGE) {
+			out.resize(count);
+			err = copy_array(path, scalar_type_of< T >(), out.data(), out.size(), count);
+		}
+		out.resize(err ? 0 : count);
+		return err;
+	}
+
+#if defined(__cpp_lib_span) && __cpp_lib_span >= 202002L
+	/// @brief copy the existing named array of T into out.
+	/// @return as copy_array, with count the number of elements copied.
+	template< typename T >
+	int get_array(std::string_view path, std::span< T > out, size_t& count) {
+		return copy_array(path, scalar_type_of< T >(), out.data(), out.size(), count);
+	}
+#endif
+
 	/// @brief get the names of non-section fields in the section
 	/// @return vector of names, or an empty vector.
 	virtual std::vector< std::string > get_field_names() = 0;
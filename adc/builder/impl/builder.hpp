@@ -9,7 +9,6 @@
 #include <sstream>
 #include <map>
 #include <memory>
-#include <boost/dll/import.hpp>
 #include <boost/algorithm/string.hpp>
 #include "boost/json.hpp"
 #include "adc/types.hpp"
@@ -37,6 +36,14 @@ class BOOST_SYMBOL_VISIBLE builder : public builder_api, public std::enable_shar
 public:
 	builder(void *mpi_communicator_p=NULL);
 
+	/// \brief take ownership of o, a record as serialized.
+	/// Unless lazy, objects in o which are not typed values become sections.
+	builder(boost::json::object&& o, bool lazy);
+
+	/// \return a builder for json text, or an empty pointer if it
+	/// is not a json object. See factory::parse_builder.
+	static std::shared_ptr< builder > parse(std::string_view json, adc_parse_flags flags);
+
 	// copy populated generic section into the builder under specified name.
 	void add_section(std::string_view name, std::shared_ptr< builder_api > section);
 
@@ -89,6 +96,8 @@ public:
 	const char *get_value_string(std::string_view path);
 	int64_t get_value_int64(std::string_view path);
 	uint64_t get_value_uint64(std::string_view path);
+	int copy_value(std::string_view path, scalar_type st, void *out);
+	int copy_array(std::string_view path, scalar_type st, void *out, size_t len, size_t& count);
 
 
 	void add(std::string_view name, bool value);
@@ -201,7 +210,13 @@ private:
 	// get the type from the strind named section or element of d.
 	key_type kind(std::string_view name);
 
+	// copy the scalar or array at path to out as copy_value/copy_array do.
+	int copy_typed(std::string_view path, scalar_type st, void *out, size_t len, size_t& count, bool array);
+
 	std::map< std::string, std::shared_ptr< builder > > sections;
+	bool lazy; ///< objects in d may still become sections; see parse
+	// move objects of d which are not typed values to sections.
+	void make_sections(bool lazy_children);
 	// merge sections recursively into a pure json object
 	boost::json::object flatten();
 	void *mpi_comm_p;
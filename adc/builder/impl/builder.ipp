@@ -15,6 +15,8 @@
 #include <string>
 #include <cstdio>
 #include <cstdint>
+#include <cerrno>
+#include <charconv>
 #include <boost/algorithm/string.hpp>
 #include <uuid/uuid.h>
 #include <version>
@@ -420,13 +422,73 @@ void update_meminfo(bool debug)
 	}
 }
 
-builder::builder(void *mpi_communicator_p) : debug(false), mpi_comm_p(mpi_communicator_p) {
+builder::builder(void *mpi_communicator_p) : debug(false), lazy(false), mpi_comm_p(mpi_communicator_p) {
 	const char *env = getenv("ADC_BUILDER_DEBUG");
 	if (env) {
 		debug = true;
 	}
 }
 
+builder::builder(boost::json::object&& o, bool lazy) : d(std::move(o)), debug(false), lazy(lazy), mpi_comm_p(NULL) {
+	const char *env = getenv("ADC_BUILDER_DEBUG");
+	if (env) {
+		debug = true;
+	}
+	if (!lazy) {
+		make_sections(false);
+	}
+}
+
+// \return true if v is an object other than a typed value, i.e. a section when parsed.
+static bool is_section_value(const boost::json::value& v)
+{
+	const boost::json::object *o = v.if_object();
+	if (!o)
+		return false;
+	const boost::json::value *type_name = o->if_contains("type");
+	return !(type_name && type_name->is_string() && o->contains("value"));
+}
+
+void builder::make_sections(bool lazy_children)
+{
+	std::vector< std::string > names;
+	for (const auto& element : d) {
+		if (is_section_value(element.value())) {
+			names.emplace_back(element.key());
+		}
+	}
+	for (const auto& name : names) {
+		auto it = d.find(name);
+		sections[name] = std::make_shared< builder >(std::move(it->value().as_object()), lazy_children);
+		d.erase(it);
+	}
+	lazy = false;
+}
+
+std::shared_ptr< builder > builder::parse(std::string_view json, adc_parse_flags flags)
+{
+	// each thread reuses one parser, and so its stack. the record is
+	// stored in a single monotonic resource, released with the builder,
+	// so parsing makes a few large allocations instead of one per value.
+	thread_local boost::json::parser jp;
+	boost::json::error_code ec;
+	jp.reset(boost::json::make_shared_resource< boost::json::monotonic_resource >(json.size()));
+	jp.write(json.data(), json.size(), ec);
+	if (!ec) {
+		jp.finish(ec);
+	}
+	if (ec) {
+		jp.reset();
+		return nullptr;
+	}
+	boost::json::value v = jp.release();
+	jp.reset();
+	if (!v.is_object()) {
+		return nullptr;
+	}
+	return std::make_shared< builder >(std::move(v.as_object()), (flags & ADC_PARSE_LAZY) != 0);
+}
+
 // auto-populate the header section with application name
 void builder::add_header_section(std::string_view application_name)
 {
@@ -697,6 +759,13 @@ void builder::add_section(std::string_view name, std::shared_ptr< builder_api >
 
 std::shared_ptr< builder_api > builder::get_section(std::string_view name)
 {
+	if (lazy) {
+		auto it = d.find(name);
+		if (it != d.end() && is_section_value(it->value())) {
+			sections[std::string(name)] = std::make_shared< builder >(std::move(it->value().as_object()), true);
+			d.erase(it);
+		}
+	}
 	auto nk = kind(name);
 	if (nk == k_section)
 		return sections[std::string(name)];
@@ -711,6 +780,13 @@ std::vector< std::string > builder::get_section_names()
 	for (const auto& element : sections) {
 		result.push_back(element.first);
 	}
+	if (lazy) {
+		for (const auto& element : d) {
+			if (is_section_value(element.value())) {
+				result.push_back(element.key());
+			}
+		}
+	}
 	return result;
 }
 
@@ -720,6 +796,9 @@ std::vector< std::string > builder::get_field_names()
 //	can we return an interator here instead?
 	std::vector< std::string > result;
 	for (auto const& element : d) {
+		if (lazy && is_section_value(element.value())) {
+			continue;
+		}
 		result.push_back(element.key());
 	}
 	return result;
@@ -1176,10 +1255,9 @@ const field builder::get_value(std::string_view path_full)
         	name = std::string_view(path.begin(), pos);
 	}
 	kt = kind(name);
-	const boost::json::value jv = d;
 	const boost::json::value * jit;
 	boost::system::error_code ec;
-	auto child = path.substr(pos);
+	auto child = pos == std::string_view::npos ? std::string_view() : path.substr(pos);
 	switch (kt) {
 	case k_none:
 		return f;
@@ -1210,6 +1288,7 @@ const field builder::get_value(std::string_view path_full)
 		if (v && type_name.size()) {
 			auto c = obj.if_contains("container_type");
 			auto st = scalar_type_from_name(type_name);
+			f.kt = kt;
 			if (!c) {
 				f.st = st;
 				get_scalar(f, st, v);
@@ -1348,6 +1427,207 @@ uint64_t builder::get_value_uint64(std::string_view path) {
 	return i;
 }
 
+/* store number e as out[i].
+ * \return false if e is not a number representable as T.
+ */
+template< typename T >
+static bool decode_number(const boost::json::value& e, void *out, size_t i)
+{
+	if (!e.is_number())
+		return false;
+	boost::system::error_code ec;
+	T x = e.to_number<T>(ec);
+	if (ec.failed())
+		return false;
+	static_cast<T *>(out)[i] = x;
+	return true;
+}
+
+/* store [re, im] pair e as out[i].
+ * \return false if e is not a pair of numbers.
+ */
+template< typename T >
+static bool decode_complex(const boost::json::value& e, void *out, size_t i)
+{
+	const boost::json::array *pair = e.if_array();
+	if (!pair || pair->size() != 2)
+		return false;
+	boost::system::error_code ecr;
+	boost::system::error_code eci;
+	T re = (*pair)[0].to_number<T>(ecr);
+	T im = (*pair)[1].to_number<T>(eci);
+	if (ecr.failed() || eci.failed())
+		return false;
+	static_cast<std::complex<T> *>(out)[i] = { re, im };
+	return true;
+}
+
+/* store element e, which was added as type st, as out[i] of the C++ type of st.
+ * Typed uint64 values are decimal strings; bare ones are numbers.
+ * \return false if e is not of the json kind st is added as.
+ */
+static bool decode_element(const boost::json::value& e, scalar_type st, void *out, size_t i)
+{
+	switch (st) {
+	case cp_bool: {
+		const bool *b = e.if_bool();
+		if (!b)
+			return false;
+		static_cast<bool *>(out)[i] = *b;
+		return true;
+	}
+	case cp_char:
+		return decode_number<char>(e, out, i);
+	case cp_char16:
+		return decode_number<char16_t>(e, out, i);
+	case cp_char32:
+		return decode_number<char32_t>(e, out, i);
+	case cp_uint8:
+		return decode_number<uint8_t>(e, out, i);
+	case cp_uint16:
+		return decode_number<uint16_t>(e, out, i);
+	case cp_uint32:
+		return decode_number<uint32_t>(e, out, i);
+	case cp_uint64: {
+		const boost::json::string *s = e.if_string();
+		if (!s)
+			return decode_number<uint64_t>(e, out, i);
+		uint64_t x;
+		auto r = std::from_chars(s->data(), s->data() + s->size(), x);
+		if (r.ec != std::errc() || r.ptr != s->data() + s->size())
+			return false;
+		static_cast<uint64_t *>(out)[i] = x;
+		return true;
+	}
+	case cp_int8:
+		return decode_number<int8_t>(e, out, i);
+	case cp_int16:
+		return decode_number<int16_t>(e, out, i);
+	case cp_int32:
+		return decode_number<int32_t>(e, out, i);
+	case cp_int64:
+		return decode_number<int64_t>(e, out, i);
+	case cp_f32:
+		return decode_number<float>(e, out, i);
+	case cp_f64:
+		return decode_number<double>(e, out, i);
+	case cp_c_f32:
+		return decode_complex<float>(e, out, i);
+	case cp_c_f64:
+		return decode_complex<double>(e, out, i);
+	case cp_cstr: {
+		const boost::json::string *s = e.if_string();
+		if (!s)
+			return false;
+		static_cast<std::string *>(out)[i].assign(s->data(), s->size());
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static bool is_string_type(scalar_type st)
+{
+	switch (st) {
+	case cp_cstr:
+	case cp_json_str:
+	case cp_yaml_str:
+	case cp_xml_str:
+	case cp_json:
+	case cp_path:
+	case cp_number_str:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int builder::copy_typed(std::string_view path_full, scalar_type st, void *out, size_t len, size_t& count, bool array)
+{
+	count = 0;
+	auto path = strip(path_full, '/');
+	auto pos = path.find("/");
+	std::string_view name = path.substr(0, pos);
+	std::string_view child = pos == std::string_view::npos ? "" : path.substr(pos);
+	switch (kind(name)) {
+	case k_section:
+		return sections[std::string(name)]->copy_typed(child, st, out, len, count, array);
+	case k_value:
+		break;
+	default:
+		return ENOENT;
+	}
+	boost::system::error_code ec;
+	const boost::json::value *jit = d[name].find_pointer(child, ec);
+	if (!jit)
+		return ENOENT;
+
+	// find the type added as and the value, without copying either.
+	scalar_type have = cp_none;
+	const boost::json::value *v = jit;
+	bool is_array = false;
+	if (const boost::json::object *obj = jit->if_object()) {
+		const boost::json::value *type_name = obj->if_contains("type");
+		v = obj->if_contains("value");
+		if (!v || !type_name || !type_name->is_string())
+			return EDOM;
+		have = scalar_type_from_name(std::string(type_name->get_string()));
+		is_array = obj->contains("container_type");
+	} else {
+		switch (jit->kind()) {
+		case boost::json::kind::bool_:
+			have = cp_bool;
+			break;
+		case boost::json::kind::int64:
+			have = cp_int64;
+			break;
+		case boost::json::kind::uint64:
+			have = cp_uint64;
+			break;
+		case boost::json::kind::double_:
+			have = cp_f64;
+			break;
+		case boost::json::kind::string:
+			have = cp_cstr;
+			break;
+		default:
+			// untyped arrays are as meaningless here as in get_value.
+			return EDOM;
+		}
+	}
+	if (st == cp_cstr && is_string_type(have))
+		have = cp_cstr;
+	if (have != st || is_array != array)
+		return EDOM;
+
+	if (!array) {
+		count = 1;
+		return decode_element(*v, st, out, 0) ? 0 : EDOM;
+	}
+	const boost::json::array *a = v->if_array();
+	if (!a)
+		return EDOM;
+	count = a->size();
+	if (count > len)
+		return ERANGE;
+	for (size_t i = 0; i < count; i++)
+		if (!decode_element((*a)[i], st, out, i))
+			return EDOM;
+	return 0;
+}
+
+int builder::copy_value(std::string_view path, scalar_type st, void *out)
+{
+	size_t count;
+	return copy_typed(path, st, out, 1, count, false);
+}
+
+int builder::copy_array(std::string_view path, scalar_type st, void *out, size_t len, size_t& count)
+{
+	return copy_typed(path, st, out, len, count, true);
+}
+
 void builder::add_mpi_section(std::string_view name, void *mpi_comm_p, adc_mpi_field_flags bitflags)
 {
 	if (!mpi_comm_p || bitflags == ADC_MPI_NONE)
@@ -2442,7 +2722,9 @@ void builder::add_array_json_string(std::string_view name, const std::string val
  */
 boost::json::object builder::flatten()
 {
-	boost::json::object tot(d); // copy
+	// copy to default storage; a parsed d has storage which frees
+	// nothing until the builder is released.
+	boost::json::object tot(d, boost::json::storage_ptr());
 	for (auto it = sections.begin(); it != sections.end(); it++) {
 		tot[it->first] = it->second->flatten();
 	}
@@ -15,6 +15,7 @@
 #include "adc/builder/builder.hpp"
 #include "adc/publisher/publisher.hpp"
 #include "adc/publisher/multi_publisher.hpp"
+#include "adc/reader/reader.hpp"
 
 namespace adc {
 
@@ -53,7 +54,8 @@ public:
 
 	@return The names of publishers available.
 	The "none", "stdout", "file", "multifile", "syslog", and "script" publishers are always available
-	in Linux environments.
+	in Linux environments. Publisher modules (see ADC_PUBLISHER_MODULE) found in
+	env("ADC_PLUGIN_PATH") or the installed plugin directory are listed without being loaded.
 	 */
 	const std::set<std::string>& get_publisher_names();
 
@@ -108,6 +110,26 @@ public:
 	*/
 	std::shared_ptr<builder_api> get_builder();
 
+	/** @brief Get a builder holding a record serialized by builder_api::serialize().
+
+	@param json the text of one record, such as a log_record::json.
+	@param flags the OR (|) of the desired ADC_PARSE_*. see @ref builder_parse_options.
+	@return a builder, or an empty pointer if json is not a json object.
+
+	Each json object in the record which is not a typed value is a section
+	of the result, so get_section and get_value see the same paths as on
+	the builder which was serialized. The record is stored as parsed, in
+	memory released with the builder, and may be extended with add*.
+	This call is thread-safe; each thread reuses its own parser.
+	*/
+	std::shared_ptr<builder_api> parse_builder(std::string_view json, adc_parse_flags flags = ADC_PARSE_DEFAULT);
+
+	/** @brief Get a reader of <adct-json> framed log files.
+
+	@return an empty reader; add files and optionally a filter to it.
+	*/
+	std::shared_ptr<log_reader_api> get_log_reader();
+
 private:
 	std::set<std::string> names; //!< the list of publisher names
 	int debug;
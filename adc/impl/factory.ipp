@@ -6,6 +6,9 @@
 #define adc_factory_ipp
 #include <string>
 #include <map>
+#include <mutex>
+#include <dirent.h>
+#include <dlfcn.h>
 #include "boost/json/src.hpp"
 #include "adc/factory.hpp"
 
@@ -27,6 +30,17 @@
 #define ADC_PUBLISHER_MULTIFILE_NAME "multifile"
 #include <adc/publisher/impl/multifile.ipp>
 
+#define ADC_PUBLISHER_MMAPFILE_NAME "mmapfile"
+#include <adc/publisher/impl/mmapfile.ipp>
+
+#define ADC_PUBLISHER_URINGFILE_NAME "uringfile"
+#include <adc/publisher/impl/uringfile.ipp>
+
+#ifdef ADC_HAVE_MPI
+#define ADC_PUBLISHER_MPIFILE_NAME "mpifile"
+#include <adc/publisher/impl/mpifile.ipp>
+#endif
+
 #define ADC_PUBLISHER_CURL_NAME "curl"
 #include <adc/publisher/impl/curl.ipp>
 
@@ -39,14 +53,17 @@
 #define ADC_PUBLISHER_SCRIPT_NAME "script"
 #include <adc/publisher/impl/script.ipp>
 
-#ifdef ADC_HAVE_LDMS
+#define ADC_PUBLISHER_UDS_NAME "uds"
+#include <adc/publisher/impl/uds.ipp>
 
-#ifdef ENABLE_ADC_PUBLISHER_LIBLDMS_MSG
-#define ADC_PUBLISHER_LIBLDMS_MSG_NAME "libldms_msg"
-#include <adc/publisher/impl/libldms_msg.ipp>
-#endif
+#define ADC_PUBLISHER_SHMRING_NAME "shmring"
+#include <adc/publisher/impl/shmring.ipp>
 
-#endif
+#define ADC_PUBLISHER_RATELIMIT_NAME "ratelimit"
+#include <adc/publisher/impl/ratelimit.ipp>
+
+#define ADC_PUBLISHER_SPOOL_NAME "spool"
+#include <adc/publisher/impl/spool.ipp>
 
 #ifdef ENABLE_ADC_PUBLISHER_LIBCURL
 #define ADC_PUBLISHER_LIBCURL_NAME "libcurl"
@@ -69,39 +86,182 @@
 
 #include <adc/builder/impl/builder.ipp>
 
+#include <adc/reader/impl/mmap_reader.ipp>
+
 namespace adc {
 
-void factory::init()
+// the decorators (ratelimit, spool) create their publisher and
+// ratelimit its summaries through a factory of their own.
+static std::shared_ptr<publisher_api> decorated_publisher_maker(const std::string& name)
 {
-	if (names.size() == 0 ) {
-		// init list of uninstantiated plugin 
-		names.insert( ADC_PUBLISHER_NONE_NAME );
-		names.insert( ADC_PUBLISHER_FILE_NAME );
-		names.insert( ADC_PUBLISHER_MULTIFILE_NAME );
-		names.insert( ADC_PUBLISHER_STDOUT_NAME );
-		names.insert( ADC_PUBLISHER_SYSLOG_NAME );
-		names.insert( ADC_PUBLISHER_CURL_NAME );
-		names.insert( ADC_PUBLISHER_LDMS_SUBPROCESS_NAME );
-		names.insert( ADC_PUBLISHER_LDMS_SUBPROCESS_MESSAGE_NAME );
-		names.insert( ADC_PUBLISHER_SCRIPT_NAME );
+	factory f;
+	return f.get_publisher(name);
+}
 
-#ifdef ENABLE_ADC_PUBLISHER_LIBCURL
-		names.insert( ADC_PUBLISHER_LIBCURL_NAME );
-#endif
+static std::shared_ptr<builder_api> ratelimit_builder_maker()
+{
+	factory f;
+	return f.get_builder();
+}
 
-#ifdef ENABLE_ADC_PUBLISHER_LIBLDMS_MSG
-#define ADC_PUBLISHER_LIBLDMS_MSG_NAME "libldms_msg"
-		names.insert( ADC_PUBLISHER_LIBLDMS_MSG_NAME );
-#endif
+typedef std::shared_ptr<publisher_api> (*publisher_maker)();
+
+template <class plugin>
+static std::shared_ptr<publisher_api> make_publisher()
+{
+	std::shared_ptr<publisher_api> p(new plugin);
+	return p;
+}
+
+static std::shared_ptr<publisher_api> make_ratelimit_publisher()
+{
+	std::shared_ptr<publisher_api> p(new ratelimit_plugin(
+		decorated_publisher_maker, ratelimit_builder_maker));
+	return p;
+}
+
+static std::shared_ptr<publisher_api> make_spool_publisher()
+{
+	std::shared_ptr<publisher_api> p(new spool_plugin(decorated_publisher_maker));
+	return p;
+}
 
+// the publishers compiled into the library.
+static const std::map< std::string, publisher_maker >& builtin_publishers()
+{
+	static const std::map< std::string, publisher_maker > builtins = {
+		{ ADC_PUBLISHER_NONE_NAME, make_publisher<none_plugin> },
+		{ ADC_PUBLISHER_STDOUT_NAME, make_publisher<stdout_plugin> },
+		{ ADC_PUBLISHER_SYSLOG_NAME, make_publisher<syslog_plugin> },
+		{ ADC_PUBLISHER_FILE_NAME, make_publisher<file_plugin> },
+		{ ADC_PUBLISHER_MULTIFILE_NAME, make_publisher<multifile_plugin> },
+		{ ADC_PUBLISHER_MMAPFILE_NAME, make_publisher<mmapfile_plugin> },
+		{ ADC_PUBLISHER_URINGFILE_NAME, make_publisher<uringfile_plugin> },
+#ifdef ADC_PUBLISHER_MPIFILE_NAME
+		{ ADC_PUBLISHER_MPIFILE_NAME, make_publisher<mpifile_plugin> },
+#endif
+		{ ADC_PUBLISHER_CURL_NAME, make_publisher<curl_plugin> },
+		{ ADC_PUBLISHER_LDMS_SUBPROCESS_NAME, make_publisher<ldmsd_stream_publish_plugin> },
+		{ ADC_PUBLISHER_LDMS_SUBPROCESS_MESSAGE_NAME, make_publisher<ldms_message_publish_plugin> },
+		{ ADC_PUBLISHER_SCRIPT_NAME, make_publisher<script_plugin> },
+		{ ADC_PUBLISHER_UDS_NAME, make_publisher<uds_plugin> },
+		{ ADC_PUBLISHER_SHMRING_NAME, make_publisher<shmring_plugin> },
+		{ ADC_PUBLISHER_RATELIMIT_NAME, make_ratelimit_publisher },
+		{ ADC_PUBLISHER_SPOOL_NAME, make_spool_publisher },
 #ifdef ENABLE_ADC_PUBLISHER_LIBADIAK
-		names.insert( ADC_PUBLISHER_LIBADIAK_NAME );
+		{ ADC_PUBLISHER_LIBADIAK_NAME, make_publisher<libadiak_many_plugin> },
 #endif
+	};
+	return builtins;
+}
 
-#ifdef ADC_PUBLISHER_LIBADIAK_JSON_NAME
-		names.insert( ADC_PUBLISHER_LIBADIAK_JSON_NAME );
-#endif
+/*! Publisher modules are adc_publisher_$name.so files in the directories
+ * of env("ADC_PLUGIN_PATH") (colon-separated), or else ADC_PLUGIN_DIR.
+ * The directories are scanned once per process without loading anything;
+ * a module is dlopened when its publisher is first requested and stays
+ * loaded, as its code may be running in publishers the caller holds.
+ * The first directory with a given name wins, and built-in publishers
+ * shadow modules.
+ */
+class publisher_modules {
+	struct module {
+		std::string path;
+		void *handle;
+		publisher_api *(*create)();
+		void (*destroy)(publisher_api *);
+	};
+	std::mutex lock;
+	std::map< std::string, module > modules;
+
+	void scan(const std::string& dir) {
+		static const std::string prefix = "adc_publisher_";
+		static const std::string suffix = ".so";
+		DIR *d = opendir(dir.c_str());
+		if (!d)
+			return;
+		struct dirent *de;
+		while ((de = readdir(d)) != nullptr) {
+			std::string f = de->d_name;
+			if (f.size() <= prefix.size() + suffix.size() ||
+				f.compare(0, prefix.size(), prefix) != 0 ||
+				f.compare(f.size() - suffix.size(), suffix.size(), suffix) != 0)
+				continue;
+			std::string name = f.substr(prefix.size(),
+				f.size() - prefix.size() - suffix.size());
+			if (builtin_publishers().count(name) || modules.count(name))
+				continue;
+			modules[name] = { dir + "/" + f, nullptr, nullptr, nullptr };
+		}
+		closedir(d);
+	}
+
+	publisher_modules() {
+		const char *env = getenv("ADC_PLUGIN_PATH");
+		std::string path = env ? env : ADC_PLUGIN_DIR;
+		for (const auto& dir : split_string(path, ':'))
+			if (dir.size())
+				scan(dir);
+	}
+
+public:
+	static publisher_modules& get() {
+		static publisher_modules pm;
+		return pm;
+	}
+
+	void add_names(std::set<std::string>& names) {
+		std::lock_guard<std::mutex> guard(lock);
+		for (const auto& m : modules)
+			names.insert(m.first);
+	}
+
+	// \return a new publisher from module name, or an empty pointer.
+	std::shared_ptr<publisher_api> create(const std::string& name, int debug) {
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = modules.find(name);
+		if (it == modules.end())
+			return std::shared_ptr<publisher_api>();
+		module& m = it->second;
+		if (!m.handle) {
+			void *h = dlopen(m.path.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (!h) {
+				if (debug) {
+					std::cout << "factory: unable to load " << m.path
+						<< ": " << dlerror() << std::endl;
+				}
+				return std::shared_ptr<publisher_api>();
+			}
+			auto api = reinterpret_cast<int (*)()>(dlsym(h, "adc_publisher_module_api"));
+			auto create = reinterpret_cast<publisher_api *(*)()>(
+				dlsym(h, "adc_publisher_module_create"));
+			auto destroy = reinterpret_cast<void (*)(publisher_api *)>(
+				dlsym(h, "adc_publisher_module_destroy"));
+			if (!api || !create || !destroy || api() != ADC_PUBLISHER_MODULE_API) {
+				if (debug) {
+					std::cout << "factory: " << m.path
+						<< " is not an adc publisher module" << std::endl;
+				}
+				dlclose(h);
+				return std::shared_ptr<publisher_api>();
+			}
+			m.handle = h;
+			m.create = create;
+			m.destroy = destroy;
+		}
+		publisher_api *p = m.create();
+		if (!p)
+			return std::shared_ptr<publisher_api>();
+		return std::shared_ptr<publisher_api>(p, m.destroy);
+	}
+};
 
+void factory::init()
+{
+	if (names.size() == 0 ) {
+		// init list of uninstantiated plugin 
+		for (const auto& b : builtin_publishers())
+			names.insert(b.first);
+		publisher_modules::get().add_names(names);
 	}
 	const char *env = getenv("ADC_MULTI_PUBLISHER_DEBUG");
 	if (env && !strcmp(env,"1") ) {
@@ -211,115 +371,21 @@ std::shared_ptr<multi_publisher_api> factory::get_multi_publisher_from_env(std::
 std::shared_ptr<publisher_api> factory::get_publisher( const std::string& name)
 {
 	init();
-	auto it = names.find(name);
-	if (it != names.end()) {
-		if (name == ADC_PUBLISHER_NONE_NAME ) {
-			std::shared_ptr<publisher_api> p(new none_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_STDOUT_NAME ) {
-			std::shared_ptr<publisher_api> p(new stdout_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_SYSLOG_NAME ) {
-			std::shared_ptr<publisher_api> p(new syslog_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_FILE_NAME ) {
-			std::shared_ptr<publisher_api> p(new file_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_MULTIFILE_NAME ) {
-			std::shared_ptr<publisher_api> p(new multifile_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_CURL_NAME ) {
-			std::shared_ptr<publisher_api> p(new curl_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_LDMS_SUBPROCESS_NAME) {
-			std::shared_ptr<publisher_api> p(new ldmsd_stream_publish_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_LDMS_SUBPROCESS_MESSAGE_NAME) {
-			std::shared_ptr<publisher_api> p(new ldms_message_publish_plugin);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_SCRIPT_NAME) {
-			std::shared_ptr<publisher_api> p(new script_plugin);
-			return p;
-		}
-#ifdef ENABLE_ADC_PUBLISHER_LDMS_STREAM
-		// todo
-#endif
-#ifdef ENABLE_ADC_PUBLISHER_LIBCURL
-		// todo
-#endif
-#ifdef ENABLE_ADC_PUBLISHER_LIBADIAK
-		if (name == ADC_PUBLISHER_LIBADIAK_NAME ) {
-			std::shared_ptr<publisher_api> p(new libadiak_plugin);
-			return p;
-		}
-#endif
-	}
+	auto& builtins = builtin_publishers();
+	auto it = builtins.find(name);
+	if (it != builtins.end())
+		return it->second();
+	if (names.count(name))
+		return publisher_modules::get().create(name, debug);
 	return std::shared_ptr<publisher_api>();
 }
 
 std::shared_ptr<publisher_api> factory::get_publisher(const std::string& name, const std::map<std::string, std::string>& opts)
 {
-	init();
-	auto it = names.find(name);
-	if (it != names.end()) {
-		if (name == ADC_PUBLISHER_NONE_NAME ) {
-			std::shared_ptr<publisher_api> p(new none_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_STDOUT_NAME ) {
-			std::shared_ptr<publisher_api> p(new stdout_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_SYSLOG_NAME ) {
-			std::shared_ptr<publisher_api> p(new syslog_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_FILE_NAME ) {
-			std::shared_ptr<publisher_api> p(new file_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_MULTIFILE_NAME ) {
-			std::shared_ptr<publisher_api> p(new multifile_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_CURL_NAME ) {
-			std::shared_ptr<publisher_api> p(new curl_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_LDMS_SUBPROCESS_NAME) {
-			std::shared_ptr<publisher_api> p(new ldmsd_stream_publish_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_LDMS_SUBPROCESS_MESSAGE_NAME) {
-			std::shared_ptr<publisher_api> p(new ldms_message_publish_plugin());
-			p->config(opts);
-			return p;
-		}
-		if (name == ADC_PUBLISHER_SCRIPT_NAME) {
-			std::shared_ptr<publisher_api> p(new script_plugin());
-			p->config(opts);
-			return p;
-		}
-		// TODO: ldmsd lib publisher
-		// TODO: ldms lib publisher
-		// TODO: curl lib publisher
-	}
-	return std::shared_ptr<publisher_api>();
+	std::shared_ptr<publisher_api> p = get_publisher(name);
+	if (p)
+		p->config(opts);
+	return p;
 }
 
 // return the names of publishers available
@@ -336,6 +402,17 @@ std::shared_ptr<builder_api> factory::get_builder()
 	return b;
 }
 
+std::shared_ptr<builder_api> factory::parse_builder(std::string_view json, adc_parse_flags flags)
+{
+	return builder::parse(json, flags);
+}
+
+std::shared_ptr<log_reader_api> factory::get_log_reader()
+{
+	std::shared_ptr<log_reader_api> r(new mmap_log_reader);
+	return r;
+}
+
 
 } // end adc
 #endif // adc_factory_ipp
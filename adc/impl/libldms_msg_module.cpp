@@ -0,0 +1,10 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+// The libldms_msg publisher, as a module so that libldms is loaded only
+// by applications that publish to it.
+#include "adc/factory.hpp"
+#include <adc/publisher/impl/libldms_msg.ipp>
+
+ADC_PUBLISHER_MODULE(adc::libldms_msg_publish_plugin)
@@ -32,6 +32,13 @@ ADC_VISIBLE std::vector<std::string> consolidate_multifile_logs(
 	return adc::multifile_plugin::consolidate_multifile_logs(match, old_paths, debug);
 }
 
+ADC_VISIBLE std::vector<std::string> consolidate_multifile_logs(
+		const std::string& match, std::vector< std::string>& old_paths, bool debug,
+		unsigned threads)
+{
+	return adc::multifile_plugin::consolidate_multifile_logs(match, old_paths, debug, threads);
+}
+
 /*! Utility to get output directory from the multifile_publisher.
  */
 ADC_VISIBLE std::string get_multifile_log_path(string_view dir, string_view wfid)
@@ -44,5 +51,39 @@ ADC_VISIBLE std::vector<size_t> validate_multifile_log(string_view filename, boo
 	return adc::multifile_plugin::validate_multifile_log(filename, check_json, record_count);
 }
 
+ADC_VISIBLE std::vector<size_t> validate_multifile_log(string_view filename, bool check_json, size_t & record_count, unsigned threads)
+{
+	return adc::multifile_plugin::validate_multifile_log(filename, check_json, record_count, threads);
+}
+
+ADC_VISIBLE int index_multifile_log(const std::string& log_path, unsigned threads)
+{
+	return adc::record_index::build(log_path, threads);
+}
+
+ADC_VISIBLE int find_indexed_records_by_uuid(const std::string& log_path, string_view uuid, std::vector< std::string >& records)
+{
+	adc::index_reader r;
+	int err = r.open(log_path);
+	if (err)
+		return err;
+	std::vector<string_view> found;
+	r.find_uuid(uuid, found);
+	records.assign(found.begin(), found.end());
+	return 0;
+}
+
+ADC_VISIBLE int find_indexed_records_by_time(const std::string& log_path, uint64_t begin_ns, uint64_t end_ns, std::vector< std::string >& records)
+{
+	adc::index_reader r;
+	int err = r.open(log_path);
+	if (err)
+		return err;
+	std::vector<string_view> found;
+	r.find_time(begin_ns, end_ns, found);
+	records.assign(found.begin(), found.end());
+	return 0;
+}
+
 } // namespace adc
 #endif // adc_utility_ipp
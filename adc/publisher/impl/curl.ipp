@@ -4,6 +4,7 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/subprocess.ipp>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -18,11 +19,24 @@ typedef std::string string;
 typedef std::string_view string_view;
 
 /*! \brief Curl utility publisher_api implementation.
-  This plugin generates a scratch file (in-memory) and asynchronously
+  This plugin copies each message to memory and asynchronously
   sends it to the configured web service by invoking the 'curl' utility.
   Multiple independent instances of this plugin may be used simultaneously.
+  The utility is started with posix_spawn on the AFFINITY cpus and is
+  reaped asynchronously. With PAYLOAD "file" (the default) the message is
+  a scratch file in DIRECTORY removed when the utility exits. With "memfd"
+  it is an anonymous in-memory file given as the utility's stdin, so
+  nothing can be left in DIRECTORY if the utility is killed; a PROG that
+  replaces the utility must then read its file argument, /proc/self/fd/0,
+  without removing it. Where memfd_create is unavailable, "file" is used.
+  At most MAX_INFLIGHT (default 16) utilities run at once; up to QUEUE
+  (default 1024) more messages wait in memory for one to exit, beyond
+  which publish returns EAGAIN. The exit codes and the HTTP status codes curl reports are counted
+  in get_stats().
+  Deliveries through payload_sender::send run curl with --fail, so that
+  HTTP errors are reported as failures.
  */
-class curl_plugin : public publisher_api {
+class curl_plugin : public publisher_api, public counted_publisher, public payload_sender {
 	enum state {
 		ok,
 		err
@@ -63,6 +77,25 @@ public:
 	/// Overridden with env("ADC_CURL_PLUGIN_DEBUG").
 	inline static const char *adc_curl_plugin_debug_default = "0";
 
+	/// \brief affinity for spawned processes; defaults to all
+	/// If not all, it should be a range list of cpu numbers, e,g. "0-1,56-57".
+	/// Overridden with env("ADC_CURL_PLUGIN_AFFINITY").
+	inline static const char *adc_curl_plugin_affinity_default = "all";
+
+	/// \brief how messages are handed to the utility; "file" (default) or "memfd".
+	/// file writes a scratch file in DIRECTORY, as also used where memfd is unavailable;
+	/// memfd passes an in-memory file as the utility's stdin, named /proc/self/fd/0.
+	/// Overridden with env("ADC_CURL_PLUGIN_PAYLOAD").
+	inline static const char *adc_curl_plugin_payload_default = "file";
+
+	/// \brief most utilities running at once.
+	/// Overridden with env("ADC_CURL_PLUGIN_MAX_INFLIGHT").
+	inline static const char *adc_curl_plugin_max_inflight_default = "16";
+
+	/// \brief most messages waiting for a running utility to exit.
+	/// Overridden with env("ADC_CURL_PLUGIN_QUEUE").
+	inline static const char *adc_curl_plugin_queue_default = "1024";
+
 private:
 	inline static const char *plugin_prefix = "ADC_CURL_PLUGIN_";
 	inline static const std::map< const string, const string > plugin_config_defaults =
@@ -70,7 +103,11 @@ private:
 		{"PROG", adc_curl_plugin_prog_default},
 		{"URL", adc_curl_plugin_url_default},
 		{"PORT", adc_curl_plugin_port_default},
-		{"DEBUG", adc_curl_plugin_debug_default}
+		{"DEBUG", adc_curl_plugin_debug_default},
+		{"AFFINITY", adc_curl_plugin_affinity_default},
+		{"PAYLOAD", adc_curl_plugin_payload_default},
+		{"MAX_INFLIGHT", adc_curl_plugin_max_inflight_default},
+		{"QUEUE", adc_curl_plugin_queue_default}
 	};
 
 	const string vers;
@@ -79,6 +116,10 @@ private:
 	string prog;
 	string port;
 	string url;
+	cpu_set_t affinity;
+	bool use_affinity;
+	bool use_memfd;
+	launch_limiter limiter;
 	int debug;
 	enum state state;
 	bool paused;
@@ -139,39 +180,55 @@ private:
 		return "";
 	}
 
-	// invoke curl with json in f, then delete f.
-	// wrap this in a thread to make it non-blocking eventually.
-	int curl_send(string& f)
+	// start curl with json in f; f is deleted when it exits
+	// unless it names payload_fd, which becomes stdin.
+	int curl_send(const string& f, int payload_fd, std::function<void(int)> done)
 	{
-		if (debug == 2) {
-			// do not suppress stderr/stdout from system call
-			string cmd = "(" + prog + 
-				" -X POST -s -w \"\n%{http_code}\n\" -H \"Content-Type: application/json\" -d @"
-				+ f + " " + url + " || /bin/rm -f " + f + ") &";
-			std::cout << "trying cmd:" << cmd << std::endl;
-			int err1 = std::system(cmd.c_str());
-			std::cout << "cmd:" << cmd << std::endl;
-			std::cout << err1 << std::endl;
-			std::cout << f << std::endl;
-		} else {
-			// suppress stderr/stdout from system call
-			string qcmd = "(" + prog + 
-				" -X POST -s -w \"\n%{http_code}\n\" -H \"Content-Type: application/json\" -d @"
-				+ f + " " + url + 
-				" > /dev/null 2>&1 ; /bin/rm -f " + f + ") &";
-			if (debug) {
-				std::cout << "trying cmd:" << qcmd << std::endl;
-			}
-			int err2 = std::system(qcmd.c_str());
-			if (debug) {
-				std::cout << err2 << std::endl;
-			}
+		// PROG may carry its own arguments, such as "curl -k".
+		std::vector<string> argv = subprocess::split_words(prog);
+		argv.insert(argv.end(), { "-X", "POST", "-s", "-w", "\n%{http_code}\n",
+			"-H", "Content-Type: application/json", "-d", "@" + f, url });
+		if (done) {
+			// the caller wants the outcome, so HTTP errors must fail too.
+			argv.insert(argv.end() - 1, "--fail");
 		}
-		return 0;
+		subprocess::options o;
+		o.affinity = use_affinity ? &affinity : nullptr;
+		o.stdin_fd = payload_fd;
+		// debug 2 does not suppress curl stderr/stdout.
+		o.quiet = (debug != 2);
+		if (o.quiet) {
+			// drop the response body so stdout holds only the status code.
+			argv.insert(argv.end() - 1, { "-o", "/dev/null" });
+		}
+		if (debug) {
+			std::cout << "trying cmd:";
+			for (const auto& a : argv)
+				std::cout << " " << a;
+			std::cout << std::endl;
+		}
+		int err = limiter.launch(argv, o, payload_fd < 0 ? f : "", o.quiet, done);
+		if (debug) {
+			std::cout << err << std::endl;
+		}
+		return err;
+	}
+
+	// send msg by memfd or scratch file, calling done as subprocess::launch does.
+	// \return 0, EAGAIN if too many sends are waiting, or 1.
+	int deliver(string msg, std::function<void(int)> done)
+	{
+		msg += '\n';
+		return subprocess::deliver(msg, use_memfd,
+			[this]() { return get_temp_file_name(); },
+			[this, &done](const string& path, int fd) { return curl_send(path, fd, done); },
+			"curl");
 	}
 
 public:
-	curl_plugin() : vers("1.0.0") , debug(false), state(ok), paused(false), mode(pi_config) { }
+	curl_plugin() : vers("1.0.0") , use_affinity(false), use_memfd(false), debug(false), state(ok), paused(false), mode(pi_config) {
+		limiter.attach(&self_stats);
+	}
 
 	/*!
 	 */
@@ -184,32 +241,16 @@ public:
 			return 1;
 		if (mode != pi_pub_or_final)
 			return 2;
-		// write to tmpfile, curl, and then delete
-		// this could be made fancy with a work queue in a later reimplementation.
-		// try for /dev/shm/adc for performance and fall back to tmpdir
-		string fname = get_temp_file_name();
-		if (debug) {
-			std::cout << "name: " << fname <<std::endl;
-		}
-		// open dump file
-		std::ofstream out(fname);
-		if (out.good()) {
-			out << b->serialize() << std::endl;
-			if (out.good()) {
-				if (debug) {
-					std::cout << "'curl' wrote" << std::endl;
-				}
-				out.close();
-				curl_send(fname); // send also removes file
-				return 0;
-			} else {
-				std::cout << "failed write to " << fname << std::endl;
-				return 1;
-			}
-		}
-		std::filesystem::remove(fname);
-		std::cout << "failed open " << fname << std::endl;
-		return 1;
+		return deliver(counted_serialize(b), nullptr);
+	}
+
+	/// \brief deliver a serialized message; see payload_sender.
+	int send(const std::string& msg, std::function<void(int)> done) {
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		return deliver(msg, done);
 	}
 
 	/*!
@@ -226,6 +267,21 @@ public:
 		string port = get(m, "PORT", env_prefix);
 		string prog = get(m, "PROG", env_prefix);
 		string sdebug = get(m, "DEBUG", env_prefix);
+		if (subprocess::parse_affinity(get(m, "AFFINITY", env_prefix), affinity, use_affinity)) {
+			return EINVAL;
+		}
+		if (subprocess::parse_payload(get(m, "PAYLOAD", env_prefix), use_memfd)) {
+			return EINVAL;
+		}
+		size_t max_inflight = 0;
+		size_t queue = 0;
+		std::stringstream is(get(m, "MAX_INFLIGHT", env_prefix));
+		std::stringstream qs(get(m, "QUEUE", env_prefix));
+		is >> max_inflight;
+		qs >> queue;
+		if (is.fail() || qs.fail() || limiter.configure(max_inflight, queue)) {
+			return EINVAL;
+		}
 		return config(d, url, port, prog, sdebug);
 	}
         
@@ -4,6 +4,8 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/record_writer.ipp>
+#include <adc/publisher/impl/record_index.ipp>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -27,11 +29,23 @@ using std::string_view;
   Debugging output is enabled if 
   env("ADC_FILE_PLUGIN_DEBUG") is a number greater than 0.
 
+  Output is buffered per the record_writer options:
+  - BUFFER_SIZE: bytes buffered before a write is forced (default 65536).
+  - FLUSH: "record" (default; each message is written as published),
+    "count", "interval", or "finalize".
+  - FLUSH_COUNT: messages per write with FLUSH=count (default 64).
+  - FLUSH_MS: milliseconds between writes with FLUSH=interval (default 1000).
+  - SYNC: writes per fdatasync call; 0 (default) never syncs.
+  Each is overridden with env("ADC_FILE_PLUGIN_$OPTION").
+
+  If env("ADC_FILE_PLUGIN_INDEX") is "true", a record_index sidecar
+  $FILE.idx is written with the same buffering and sealed at finalize.
+
   Multiple independent file publishers may be created; if the same file name 
   and directory are used for distinct instances, output file content
   is undefined.
  */
-class file_plugin : public publisher_api {
+class file_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -48,7 +62,13 @@ private:
 		{{ "DIRECTORY", "."},
 		 { "FILE", "adc.file_plugin.log" },
 		 { "DEBUG", "0" },
-		 { "APPEND", "false" }
+		 { "APPEND", "false" },
+		 { "BUFFER_SIZE", record_writer::buffer_size_default },
+		 { "FLUSH", record_writer::flush_default },
+		 { "FLUSH_COUNT", record_writer::flush_count_default },
+		 { "FLUSH_MS", record_writer::flush_ms_default },
+		 { "SYNC", record_writer::sync_default },
+		 { "INDEX", "false" }
 		};
 	inline static const char *plugin_file_prefix = "ADC_FILE_PLUGIN_";
 	const string vers;
@@ -56,15 +76,31 @@ private:
 	string fname;
 	string fdir;
 	bool fappend;
-	std::ofstream out;
+	bool findex;
+	record_writer out;
+	index_writer idx;
 	int debug;
 	enum state state;
 	bool paused;
 	enum mode mode;
 
-	int config(const string dir, const string file, bool append, const string& sdebug) {
+	int config(const string dir, const string file, bool append, const string& sdebug,
+			const std::map< string, string >& m, string_view env_prefix) {
 		if (mode != pi_config)
 			return 2;
+		int werr = out.configure(get(m, "BUFFER_SIZE", env_prefix),
+			get(m, "FLUSH", env_prefix), get(m, "FLUSH_COUNT", env_prefix),
+			get(m, "FLUSH_MS", env_prefix), get(m, "SYNC", env_prefix));
+		if (!werr) {
+			werr = idx.configure(get(m, "BUFFER_SIZE", env_prefix),
+				get(m, "FLUSH", env_prefix), get(m, "FLUSH_COUNT", env_prefix),
+				get(m, "FLUSH_MS", env_prefix), get(m, "SYNC", env_prefix));
+		}
+		findex = ( get(m, "INDEX", env_prefix) == "true");
+		if (werr) {
+			std::cout << "file plugin: bad buffer or flush option" << std::endl;
+			return werr;
+		}
 		fname = file;
 		fappend = append;
 		fdir = dir;
@@ -99,7 +135,7 @@ private:
 
 
 public:
-	file_plugin() : vers("1.0.0") , tags({"none"}), fappend(false), debug(0),
+	file_plugin() : vers("1.0.0") , tags({"none"}), fappend(false), findex(false), debug(0),
 		state(ok), paused(false), mode(pi_config) { }
 
 	int publish(std::shared_ptr<builder_api> b) {
@@ -113,11 +149,18 @@ public:
 			return 2;
 		// write to stream
 		if (out.good()) {
-			out << "<adct-json>"  << b->serialize() << "</adct-json>" << std::endl;
-			if (debug) {
-				std::cout << "'file' wrote" << std::endl;
+			string payload = counted_serialize(b);
+			uint64_t offset = out.tell();
+			int werr = out.write_record("<adct-json>", payload, "</adct-json>\n");
+			if (!werr) {
+				if (findex && idx.add(offset, payload) && debug) {
+					std::cout << "'file' index write failed" << std::endl;
+				}
+				if (debug) {
+					std::cout << "'file' wrote" << std::endl;
+				}
+				return 0;
 			}
-			return 0;
 		}
 		if (debug) {
 			std::cout << "plugin 'file' failed out.good" << std::endl;
@@ -134,7 +177,7 @@ public:
 		string d = get(m, "DIRECTORY", env_prefix);
 		string f = get(m, "FILE", env_prefix);
 		string sdebug = get(m, "DEBUG", env_prefix);
-		return config(d, std::move(f), app, sdebug);
+		return config(d, std::move(f), app, sdebug, m, env_prefix);
 	}
 
 	const std::map< const std::string, const std::string> & get_option_defaults() {
@@ -163,14 +206,19 @@ public:
 		}
 		string fpath = fdir + "/" + fname;
 		// open dump file; messages are <adct-json> tag separated, not endl separated, as content may include \n.
-		out.open(fpath, std::ofstream::out |
-       			(fappend ? std::ofstream::app : std::ofstream::trunc));
-		if (out.good()) {
+		int oerr = out.open(fpath, fappend);
+		if (!oerr && findex) {
+			oerr = idx.open(fpath);
+			if (oerr) {
+				out.close();
+			}
+		}
+		if (!oerr) {
 			mode = pi_pub_or_final;
 			return 0;
 		}
 		state = err;
-		return EBADF;
+		return oerr;
 	}
 
 	void finalize() {
@@ -178,7 +226,16 @@ public:
 			state = ok;
 			paused = false;
 			mode = pi_config;
-			out.close();
+			int cerr = out.close();
+			if (cerr && debug) {
+				std::cout << "file plugin close failed: " << std::strerror(cerr) << std::endl;
+			}
+			if (findex) {
+				cerr = idx.close();
+				if (cerr && debug) {
+					std::cout << "file plugin index close failed: " << std::strerror(cerr) << std::endl;
+				}
+			}
 		} else {
 			if (debug) {
 				std::cout << "file plugin finalize on non-running plugin" << std::endl;
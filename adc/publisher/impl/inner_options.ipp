@@ -0,0 +1,42 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_inner_options_ipp
+#define adc_inner_options_ipp
+#include <adc/publisher/publisher.hpp>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace adc {
+
+/*! \brief the options for the publisher inner decorated by another.
+ * Option $X of inner is taken from PUBLISHER_$X in m, else from
+ * env($env_prefix PUBLISHER_$X), as the decorator's own options are;
+ * options found in neither are left to inner's own env and defaults.
+ * PUBLISHER_$X entries of m that inner does not list are passed too.
+ */
+inline std::map< std::string, std::string > inner_options(
+	const std::map< std::string, std::string >& m, std::string_view env_prefix,
+	publisher_api& inner)
+{
+	static const std::string opt_prefix = "PUBLISHER_";
+	std::map< std::string, std::string > opts;
+	for (const auto& kv : m)
+		if (kv.first.compare(0, opt_prefix.size(), opt_prefix) == 0)
+			opts[kv.first.substr(opt_prefix.size())] = kv.second;
+	for (const auto& d : inner.get_option_defaults()) {
+		if (opts.count(d.first))
+			continue;
+		std::string en = std::string(env_prefix) + opt_prefix + d.first;
+		const char *ec = getenv(en.c_str());
+		if (ec)
+			opts[d.first] = ec;
+	}
+	return opts;
+}
+
+} // adc
+#endif // adc_inner_options_ipp
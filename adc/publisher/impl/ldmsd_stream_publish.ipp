@@ -4,6 +4,7 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/subprocess.ipp>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -19,16 +20,25 @@ typedef std::string_view string_view;
 
 
 /*! \brief ldmsd_stream_publish utility publisher_api implementation.
-  This plugin generates a scratch file (in-memory) and asynchronously
+  This plugin copies each message to memory and asynchronously
   sends it to ldmsd by invoking the 'ldmsd_stream_publish' utility
   available in ldms versions up to 4.4. Use the ldms_message_publish_plugin
   for ldms versions 4.5 and above.
 
   Multiple independent instances of this plugin may be used simultaneously.
-  The asynchronous tranmission spawns a separate shell process to
-  handle tranmission and file cleanup.
+  The utility is started with posix_spawn on the AFFINITY cpus and is
+  reaped asynchronously. With PAYLOAD "file" (the default) the message is
+  a scratch file in DIRECTORY removed when the utility exits. With "memfd"
+  it is an anonymous in-memory file given as the utility's stdin, so
+  nothing can be left in DIRECTORY if the utility is killed; a PROG that
+  replaces the utility must then read its file argument, /proc/self/fd/0,
+  without removing it. Where memfd_create is unavailable, "file" is used.
+  At most MAX_INFLIGHT (default 16) utilities run at once; up to QUEUE
+  (default 1024) more messages wait in memory for one to exit, beyond
+  which publish returns EAGAIN. The exit codes are counted
+  in get_stats().
  */
-class ldmsd_stream_publish_plugin : public publisher_api {
+class ldmsd_stream_publish_plugin : public publisher_api, public counted_publisher, public payload_sender {
 	enum state {
 		ok,
 		err
@@ -73,6 +83,20 @@ public:
 	/// Overridden with env("ADC_LDMSD_STREAM_PUBLISH_PLUGIN_AFFINITY").
 	inline static const char* adc_ldmsd_stream_publish_plugin_affinity_default = "all";
 
+	/// \brief how messages are handed to the utility; "file" (default) or "memfd".
+	/// file writes a scratch file in DIRECTORY, as also used where memfd is unavailable;
+	/// memfd passes an in-memory file as the utility's stdin, named /proc/self/fd/0.
+	/// Overridden with env("ADC_LDMSD_STREAM_PUBLISH_PLUGIN_PAYLOAD").
+	inline static const char *adc_ldmsd_stream_publish_plugin_payload_default = "file";
+
+	/// \brief most utilities running at once.
+	/// Overridden with env("ADC_LDMSD_STREAM_PUBLISH_PLUGIN_MAX_INFLIGHT").
+	inline static const char *adc_ldmsd_stream_publish_plugin_max_inflight_default = "16";
+
+	/// \brief most messages waiting for a running utility to exit.
+	/// Overridden with env("ADC_LDMSD_STREAM_PUBLISH_PLUGIN_QUEUE").
+	inline static const char *adc_ldmsd_stream_publish_plugin_queue_default = "1024";
+
 	/// \brief ADC ldmsd-stream plugin enable debug messages; (default "0": none)
 	/// Overridden with env("ADC_LDMSD_STREAM_PUBLISH_PLUGIN_DEBUG").
 	inline static const char *adc_ldmsd_stream_publish_plugin_debug_default = "0";
@@ -87,7 +111,10 @@ private:
 		{"HOST", adc_ldmsd_stream_publish_plugin_host_default},
 		{"PORT", adc_ldmsd_stream_publish_plugin_port_default},
 		{"DEBUG", adc_ldmsd_stream_publish_plugin_debug_default},
-		{"AFFINITY", adc_ldmsd_stream_publish_plugin_affinity_default}
+		{"AFFINITY", adc_ldmsd_stream_publish_plugin_affinity_default},
+		{"PAYLOAD", adc_ldmsd_stream_publish_plugin_payload_default},
+		{"MAX_INFLIGHT", adc_ldmsd_stream_publish_plugin_max_inflight_default},
+		{"QUEUE", adc_ldmsd_stream_publish_plugin_queue_default}
 	};
 
 	inline static const char *plugin_prefix = "ADC_LDMSD_STREAM_PUBLISH_PLUGIN_";
@@ -100,6 +127,10 @@ private:
 	string stream;
 	string port;
 	string host;
+	cpu_set_t affinity;
+	bool use_affinity;
+	bool use_memfd;
+	launch_limiter limiter;
 	int debug;
 	enum state state;
 	bool paused;
@@ -161,30 +192,41 @@ private:
 		return "";
 	}
 
-	// invoke ldms_stream_publish with json in f, then delete f.
-	// wrap this in a thread to make it non-blocking eventually.
-	int ldmsd_stream_publish_send(string& f)
+	// start ldmsd_stream_publish with json in f; f is deleted when it exits
+	// unless it names payload_fd, which becomes stdin.
+	int ldmsd_stream_publish_send(const string& f, int payload_fd, std::function<void(int)> done)
 	{
-		string qcmd = "(" + prog + 
-			" -t json "
-			" -x sock "
-			" -h " + host +
-			" -p " + port +
-			" -a " + auth +
-			" -s " + stream +
-			" -f " + f +
-			"> /dev/null 2>&1 ; /bin/rm -f " + f + ") &";
-		int err2 = std::system(qcmd.c_str());
+		// PROG may carry its own arguments.
+		std::vector<string> argv = subprocess::split_words(prog);
+		argv.insert(argv.end(), { "-t", "json", "-x", "sock",
+			"-h", host, "-p", port, "-a", auth, "-s", stream, "-f", f });
+		subprocess::options o;
+		o.affinity = use_affinity ? &affinity : nullptr;
+		o.stdin_fd = payload_fd;
+		int err2 = limiter.launch(argv, o, payload_fd < 0 ? f : "", false, done);
 		if (debug) {
 			std::cout << f << std::endl;
 			std::cout << err2 << std::endl;
 		}
-		return 0;
+		return err2;
+	}
+
+	// send msg by memfd or scratch file, calling done as subprocess::launch does.
+	// \return 0, EAGAIN if too many sends are waiting, or 1.
+	int deliver(string msg, std::function<void(int)> done)
+	{
+		msg += '\n';
+		return subprocess::deliver(msg, use_memfd,
+			[this]() { return get_temp_file_name(); },
+			[this, &done](const string& path, int fd) { return ldmsd_stream_publish_send(path, fd, done); },
+			"ldmsd_stream_publish");
 	}
 
 public:
-	ldmsd_stream_publish_plugin() : vers("1.0.0") , tags({"none"}), debug(0),
-		state(ok), paused(false), mode(pi_config) {}
+	ldmsd_stream_publish_plugin() : vers("1.0.0") , tags({"none"}), use_affinity(false), use_memfd(false), debug(0),
+		state(ok), paused(false), mode(pi_config) {
+		limiter.attach(&self_stats);
+	}
 
         int publish(std::shared_ptr<builder_api> b) {
 		if (!b)
@@ -195,32 +237,16 @@ public:
 			return 1;
 		if (mode != pi_pub_or_final)
 			return 2;
-		// write to tmpfile, ldms_stream_publish, and then delete
-		// this could be made fancy with a work queue in a later reimplementation.
-		// try for /dev/shm/adc for performance and fall back to tmpdir
-		string fname = get_temp_file_name();
-		if (debug) {
-			std::cout << "name: " << fname <<std::endl;
-		}
-		// open dump file
-		std::ofstream out(fname);
-		if (out.good()) {
-			out << b->serialize() << std::endl;
-			if (out.good()) {
-				if (debug) {
-					std::cout << "'ldmsd_stream_publish' wrote" << std::endl;
-				}
-				out.close();
-				ldmsd_stream_publish_send(fname); // send also removes file
-				return 0;
-			} else {
-				std::cout << "failed write" << std::endl;
-				return 1;
-			}
-		}
-		std::filesystem::remove(fname);
-		std::cout << "failed open " <<fname<< std::endl;
-		return 1;
+		return deliver(counted_serialize(b), nullptr);
+	}
+
+	/// \brief deliver a serialized message; see payload_sender.
+	int send(const std::string& msg, std::function<void(int)> done) {
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		return deliver(msg, done);
 	}
 
         int config(const std::map< std::string, std::string >& m) {
@@ -235,6 +261,21 @@ public:
 		string auth = get(m, "AUTH", env_prefix);
 		string stream = get(m, "STREAM", env_prefix);
 		string sdebug = get(m, "DEBUG", env_prefix);
+		if (subprocess::parse_affinity(get(m, "AFFINITY", env_prefix), affinity, use_affinity)) {
+			return EINVAL;
+		}
+		if (subprocess::parse_payload(get(m, "PAYLOAD", env_prefix), use_memfd)) {
+			return EINVAL;
+		}
+		size_t max_inflight = 0;
+		size_t queue = 0;
+		std::stringstream is(get(m, "MAX_INFLIGHT", env_prefix));
+		std::stringstream qs(get(m, "QUEUE", env_prefix));
+		is >> max_inflight;
+		qs >> queue;
+		if (is.fail() || qs.fail() || limiter.configure(max_inflight, queue)) {
+			return EINVAL;
+		}
 		return config(d, host, port, prog, auth, stream, sdebug);
 	}
         
@@ -16,7 +16,7 @@ std::map< const std::string, const std::string> libadiak_json_defaults;
   Multiple independent instances of this plugin may be used simultaneously,
   but message integrity depends on the behavior of libadiak.
  */
-class libadiak_json_plugin : public publisher_api {
+class libadiak_json_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -40,7 +40,7 @@ public:
 			return 0;
 		if (state != ok)
 			return 1;
-		auto jstr = b->serialize();
+		auto jstr = counted_serialize(b);
 		adiak::value("adc_event", adiak::jsonstring(jstr));
 		return 0;
 	}
@@ -30,7 +30,7 @@ const string plugin_libcurl_prefix("ADC_LIBCURL_PLUGIN_");
 
 /*! \brief NOT yet implemented publisher plugin that will eventually use libcurl.
  */
-class libcurl_plugin : public publisher_api {
+class libcurl_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -119,7 +119,7 @@ public:
 			return 1;
 		if (mode != pi_pub_or_final)
 			return 2;
-		string json = b->serialize();
+		string json = counted_serialize(b);
 		libcurl_send(json);
 		return 0;
 	}
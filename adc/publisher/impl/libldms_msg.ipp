@@ -4,10 +4,16 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
-#include <fstream>
-#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <unistd.h>
 #include <ldms.h>
 
@@ -20,13 +26,27 @@ typedef std::string_view string_view;
 
 
 /*! \brief libldms_msg_publish publisher_api implementation.
-  This plugin calls the ldms libraries for sending messages.
+  This plugin calls the ldms library (ldms_msg, ldms versions from 4.5)
+  to send messages to an ldmsd, so a message costs a network send rather
+  than a process spawn as with the ldms_message_publish plugin.
+
+  The transport (XPRT, default "sock") is connected to HOST:PORT once, at
+  initialize, and reused. initialize waits up to TIMEOUT_MS (default 5000)
+  for the connection; if ldmsd is not yet reachable, messages are queued
+  while the connection is retried in the background, first after RETRY_MS
+  (default 1000) and then with the delay doubling up to RETRY_MAX_MS
+  (default 30000). A connection that is lost is retried the same way.
+
+  Sends are asynchronous: publish queues the message and returns, and one
+  thread per plugin instance sends queued messages in order. The queue is
+  bounded at QUEUE_SIZE bytes (default 4 MiB); messages that do not fit are
+  dropped and publish returns EAGAIN. At finalize, the queue is drained for
+  up to TIMEOUT_MS, and the connection is closed.
 
   Multiple independent instances of this plugin may be used simultaneously.
-  The asynchronous tranmission spawns (or recycles) a separate thread to
-  handle tranmission.
+  Options are overridden with env("ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_$OPTION").
  */
-class libldms_msg_publish_plugin : public publisher_api {
+class libldms_msg_publish_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -37,6 +57,28 @@ class libldms_msg_publish_plugin : public publisher_api {
 		pi_init,
 		pi_pub_or_final
 	};
+	enum conn {
+		c_down,
+		c_connecting,
+		c_up
+	};
+
+	/* State shared with the ldms event callback, which may run after the
+	 * plugin is destroyed; each connection attempt holds a reference until
+	 * its final event. */
+	struct link {
+		std::mutex lock;
+		std::condition_variable cv;
+		ldms_t x = nullptr;
+		enum conn conn = c_down;
+		uint64_t failures = 0;
+		std::deque<string> pending;
+		size_t pending_bytes = 0;
+		bool stopping = false;
+		uint64_t sent = 0;
+		uint64_t dropped = 0;
+	};
+
 public:
 	/// \brief name of the tag ADC messages go into
 	/// LDMS aggregators must be subscribed to this name.
@@ -55,13 +97,27 @@ public:
 	/// Overridden with env("ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_HOST").
 	inline static const char* adc_libldms_msg_publish_plugin_host_default = "localhost";
 
+	/// \brief transport for tag connections; ldmsd listeners must match.
+	/// Overridden with env("ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_XPRT").
+	inline static const char* adc_libldms_msg_publish_plugin_xprt_default = "sock";
+
+	/// \brief ADC libldms_msg plugin enable debug messages; (default "0": none)
+	/// Overridden with env("ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_DEBUG").
+	inline static const char *adc_libldms_msg_publish_plugin_debug_default = "0";
+
 private:
 	const std::map< const string, const string > plugin_libldms_msg_publish_config_defaults =
 	{
 		{"TAG", adc_libldms_msg_publish_plugin_tag_default},
 		{"AUTH", adc_libldms_msg_publish_plugin_auth_default},
 		{"HOST", adc_libldms_msg_publish_plugin_host_default},
-		{"PORT", adc_libldms_msg_publish_plugin_port_default}
+		{"PORT", adc_libldms_msg_publish_plugin_port_default},
+		{"XPRT", adc_libldms_msg_publish_plugin_xprt_default},
+		{"DEBUG", adc_libldms_msg_publish_plugin_debug_default},
+		{"QUEUE_SIZE", "4194304"},
+		{"RETRY_MS", "1000"},
+		{"RETRY_MAX_MS", "30000"},
+		{"TIMEOUT_MS", "5000"}
 	};
 
 	inline static const char *plugin_prefix = "ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_";
@@ -72,33 +128,51 @@ private:
 	string tag;
 	string port;
 	string host;
+	string xprt;
+	size_t queue_max;
+	long retry_ms;
+	long retry_max_ms;
+	long timeout_ms;
+	std::shared_ptr<link> ln;
+	std::thread worker;
+	std::chrono::steady_clock::time_point deadline;
+	int debug;
 	enum state state;
 	bool paused;
 	enum mode mode;
 	bool configured;
 
-	int config(const string& dir, string_view shost, string_view sport, string_view sauth, string_view stag) {
+	int config(string_view shost, string_view sport, string_view sauth, string_view stag,
+		string_view sxprt, const string& sdebug) {
 		if (mode != pi_config)
 			return 2;
-		uid_t ui = geteuid();
 		port = sport;
 		host = shost;
 		auth = sauth;
 		tag = stag;
+		xprt = sxprt;
 		mode = pi_init;
 		configured = true;
+		std::stringstream ss(sdebug);
+		ss >> debug;
+		if (debug < 0) {
+			debug = 0;
+		}
+		if (debug > 0) {
+			std::cout<< "libldms_msg_publish plugin configured" <<std::endl;
+		}
 		return 0;
 	}
 
 	// find field in m, then with prefix in env, then the default.
 	const string get(const std::map< string, string >& m,
-			string field, const string& env_prefix) {
+			string field, string_view env_prefix) {
 		// fields not defined in config_defaults raise an exception.
 		auto it = m.find(field);
 		if (it != m.end()) {
 			return it->second;
 		}
-		string en = env_prefix + field;
+		string en = string(env_prefix) += field;
 		char *ec = getenv(en.c_str());
 		if (!ec) {
 			return plugin_libldms_msg_publish_config_defaults.at(field);
@@ -106,34 +180,201 @@ private:
 			return string(ec);
 		}
 	}
-	
-	// invoke ldms_stream_publish with json in f, then delete f.
-	// wrap this in a thread to make it non-blocking eventually.
-	int libldms_msg_publish_send(string& f)
-	{
-// fixme libldms_msg_publish_plugin::libldms_msg_publish_send
-#if 0
-		string qcmd = "(" + prog + 
-			" -t json "
-			" -x sock "
-			" -h " + host +
-			" -p " + port +
-			" -a " + auth +
-			" -s " + stream +
-			" -f " + f +
-			"> /dev/null 2>&1 ; /bin/rm " + f + ") &";
-		int err2 = std::system(qcmd.c_str());
-		std::cout << f << std::endl;
-		std::cout << err2 << std::endl;
-#endif
-		return 0;
+
+	// ldms transport events; arg is a heap shared_ptr<link> owned by one connection.
+	static void event_cb(ldms_t x, ldms_xprt_event_t e, void *arg) {
+		auto ref = static_cast<std::shared_ptr<link> *>(arg);
+		link& l = **ref;
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> g(l.lock);
+			switch (e->type) {
+			case LDMS_XPRT_EVENT_CONNECTED:
+				if (l.x == x)
+					l.conn = c_up;
+				break;
+			case LDMS_XPRT_EVENT_REJECTED:
+			case LDMS_XPRT_EVENT_ERROR:
+			case LDMS_XPRT_EVENT_DISCONNECTED:
+				if (l.x == x) {
+					if (l.conn != c_up)
+						l.failures++;
+					l.x = nullptr;
+					l.conn = c_down;
+				}
+				last = true;
+				break;
+			default:
+				break;
+			}
+			l.cv.notify_all();
+		}
+		if (last)
+			delete ref;
 	}
 
-public:
-	libldms_msg_publish_plugin() : vers("0.0.0") , tags({"unimplemented"}), state(ok), paused(false), mode(pi_config), configured(false) {
-		std::cout << "Constructing libldms_msg_publish_plugin" << std::endl;
+	// start connecting a new transport. \return 0 or errno.
+	int connect() {
+		errno = 0;
+		ldms_t x = ldms_xprt_new_with_auth(xprt.c_str(), auth.c_str(), NULL);
+		if (!x) {
+			int e = errno ? errno : ENOMEM;
+			std::lock_guard<std::mutex> g(ln->lock);
+			ln->failures++;
+			return e;
+		}
+		auto ref = new std::shared_ptr<link>(ln);
+		{
+			std::lock_guard<std::mutex> g(ln->lock);
+			ln->x = x;
+			ln->conn = c_connecting;
+		}
+		int rc = ldms_xprt_connect_by_name(x, host.c_str(), port.c_str(), event_cb, ref);
+		if (rc) {
+			{
+				std::lock_guard<std::mutex> g(ln->lock);
+				ln->x = nullptr;
+				ln->conn = c_down;
+				ln->failures++;
+				ln->cv.notify_all();
+			}
+			delete ref;
+			ldms_xprt_close(x);
+		}
+		return rc;
+	}
+
+	// close x, which must already be detached from ln; called without the lock.
+	void disconnect(ldms_t x) {
+		if (x)
+			ldms_xprt_close(x);
+	}
+
+	// the sending thread: connect with backoff, then send queued messages in order.
+	void run() {
+		using clock = std::chrono::steady_clock;
+		auto backoff = std::chrono::milliseconds(retry_ms);
+		auto next_try = clock::now();
+		auto connect_limit = next_try;
+		std::unique_lock<std::mutex> g(ln->lock);
+		for (;;) {
+			auto now = clock::now();
+			if (ln->stopping && (ln->pending.empty() || now >= deadline))
+				break;
+			if (ln->conn == c_down) {
+				if (now < next_try) {
+					ln->cv.wait_until(g, ln->stopping ? std::min(next_try, deadline) : next_try);
+					continue;
+				}
+				g.unlock();
+				int rc = connect();
+				if (rc && debug) {
+					std::cout << "libldms_msg_publish plugin connect to " << host << ":" << port
+						<< " failed: " << std::strerror(rc) << std::endl;
+				}
+				g.lock();
+				next_try = now + backoff;
+				connect_limit = now + std::chrono::milliseconds(timeout_ms);
+				backoff = std::min(backoff * 2, std::chrono::milliseconds(retry_max_ms));
+				continue;
+			}
+			if (ln->conn == c_connecting) {
+				if (now >= connect_limit) {
+					// the attempt hung; abandon it and retry later.
+					ldms_t x = ln->x;
+					ln->x = nullptr;
+					ln->conn = c_down;
+					ln->failures++;
+					g.unlock();
+					disconnect(x);
+					g.lock();
+					continue;
+				}
+				ln->cv.wait_until(g, ln->stopping ? std::min(connect_limit, deadline) : connect_limit);
+				continue;
+			}
+			backoff = std::chrono::milliseconds(retry_ms);
+			if (ln->pending.empty()) {
+				if (ln->stopping)
+					break;
+				ln->cv.wait(g);
+				continue;
+			}
+			string m = std::move(ln->pending.front());
+			ln->pending.pop_front();
+			ln->pending_bytes -= m.size();
+			ldms_t x = ln->x;
+			g.unlock();
+			// the length includes the terminating nul, as ldmsd expects for json.
+			int rc = ldms_msg_publish(x, tag.c_str(), LDMS_MSG_JSON, NULL, 0444,
+				m.c_str(), m.size() + 1);
+			g.lock();
+			if (!rc) {
+				ln->sent++;
+				continue;
+			}
+			if (rc == EINVAL || rc == E2BIG) {
+				// not sendable on any connection.
+				ln->dropped++;
+				if (debug) {
+					std::cout << "libldms_msg_publish plugin dropped message: "
+						<< std::strerror(rc) << std::endl;
+				}
+				continue;
+			}
+			ln->pending_bytes += m.size();
+			ln->pending.push_front(std::move(m));
+			if (rc == EBUSY || rc == EAGAIN) {
+				// out of send quota; wait for a deposit.
+				ln->cv.wait_for(g, std::chrono::milliseconds(10));
+				continue;
+			}
+			if (debug) {
+				std::cout << "libldms_msg_publish plugin send failed: "
+					<< std::strerror(rc) << std::endl;
+			}
+			if (ln->x == x) {
+				ln->x = nullptr;
+				ln->conn = c_down;
+				g.unlock();
+				disconnect(x);
+				g.lock();
+			}
+			next_try = clock::now() + backoff;
+		}
+		ldms_t x = ln->x;
+		ln->x = nullptr;
+		ln->conn = c_down;
+		ln->dropped += ln->pending.size();
+		ln->pending.clear();
+		ln->pending_bytes = 0;
+		g.unlock();
+		disconnect(x);
+	}
+
+	void stop() {
+		if (!worker.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> g(ln->lock);
+			ln->stopping = true;
+			deadline = std::chrono::steady_clock::now() +
+				std::chrono::milliseconds(timeout_ms);
+			ln->cv.notify_all();
+		}
+		worker.join();
+		if (debug) {
+			std::cout << "libldms_msg_publish plugin sent " << ln->sent
+				<< " dropped " << ln->dropped << std::endl;
+		}
+		ln.reset();
 	}
 
+public:
+	libldms_msg_publish_plugin() : vers("1.0.0") , tags({"none"}), queue_max(4194304),
+		retry_ms(1000), retry_max_ms(30000), timeout_ms(5000), debug(0), state(ok),
+		paused(false), mode(pi_config), configured(false) { }
+
         int publish(std::shared_ptr<builder_api> b) {
 		if (!b)
 			return EINVAL;
@@ -143,22 +384,50 @@ public:
 			return 1;
 		if (mode != pi_pub_or_final)
 			return 2;
-// fixme // send to ldms_msg api; libldms_msg_publish_plugin::publish
-		return 1;
+		string m = counted_serialize(b);
+		std::lock_guard<std::mutex> g(ln->lock);
+		if (ln->pending_bytes + m.size() > queue_max) {
+			ln->dropped++;
+			if (debug > 1) {
+				std::cout << "libldms_msg_publish plugin queue full; dropped "
+					<< ln->dropped << std::endl;
+			}
+			return EAGAIN;
+		}
+		ln->pending_bytes += m.size();
+		ln->pending.push_back(std::move(m));
+		ln->cv.notify_one();
+		return 0;
 	}
 
         int config(const std::map< std::string, std::string >& m) {
 		return config(m, plugin_prefix);
 	}
 
-        int config(const std::map< std::string, std::string >& m, const std::string& env_prefix) {
+        int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
 		string host = get(m, "HOST", env_prefix);
 		string port = get(m, "PORT", env_prefix);
 		string auth = get(m, "AUTH", env_prefix);
 		string tag = get(m, "TAG", env_prefix);
-		return config(d, host, port, auth, tag);
+		string xprt = get(m, "XPRT", env_prefix);
+		string sdebug = get(m, "DEBUG", env_prefix);
+		std::stringstream qs(get(m, "QUEUE_SIZE", env_prefix));
+		std::stringstream rs(get(m, "RETRY_MS", env_prefix));
+		std::stringstream xs(get(m, "RETRY_MAX_MS", env_prefix));
+		std::stringstream ts(get(m, "TIMEOUT_MS", env_prefix));
+		qs >> queue_max;
+		rs >> retry_ms;
+		xs >> retry_max_ms;
+		ts >> timeout_ms;
+		if (qs.fail() || rs.fail() || xs.fail() || ts.fail() ||
+			retry_ms <= 0 || retry_max_ms < retry_ms || timeout_ms < 0) {
+			return EINVAL;
+		}
+		return config(host, port, auth, tag, xprt, sdebug);
 	}
-        
+
 	const std::map< const std::string, const std::string> & get_option_defaults() {
 		return plugin_libldms_msg_publish_config_defaults;
 	}
@@ -174,20 +443,36 @@ public:
 			std::cout << "libldms_msg_publish plugin initialize found pre-existing error" << std::endl;
 			return 3;
 		}
-		// fixme: try connect to ldmsd; libldms_msg_publish_plugin::initialize
-		std::error_code ec;
-		// attach msg tag
+		ln = std::make_shared<link>();
+		worker = std::thread(&libldms_msg_publish_plugin::run, this);
+		{
+			// wait for the first connection attempt to finish.
+			std::unique_lock<std::mutex> g(ln->lock);
+			ln->cv.wait_for(g, std::chrono::milliseconds(timeout_ms),
+				[this]() { return ln->conn == c_up || ln->failures > 0; });
+			if (ln->conn != c_up) {
+				std::cout << "libldms_msg_publish plugin: no connection yet to "
+					<< xprt << ":" << host << ":" << port
+					<< "; messages will be queued" << std::endl;
+			} else if (debug) {
+				std::cout << "libldms_msg_publish plugin connected to "
+					<< host << ":" << port << std::endl;
+			}
+		}
 		mode = pi_pub_or_final;
 		return 0;
 	}
 
         void finalize() {
 		if (mode == pi_pub_or_final) {
+			stop();
 			state = ok;
 			paused = false;
 			mode = pi_config;
 		} else {
-			std::cout << "libldms_msg_publish plugin finalize on non-running plugin" << std::endl;
+			if (debug) {
+				std::cout << "libldms_msg_publish plugin finalize on non-running plugin" << std::endl;
+			}
 		}
 	}
 
@@ -208,7 +493,10 @@ public:
 	}
 
 	~libldms_msg_publish_plugin() {
-		std::cout << "Destructing libldms_msg_publish_plugin" << std::endl;
+		stop();
+		if (debug) {
+			std::cout << "Destructing libldms_msg_publish_plugin" << std::endl;
+		}
 	}
 };
 
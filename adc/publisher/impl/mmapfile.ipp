@@ -0,0 +1,434 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace adc {
+
+using std::string;
+using std::string_view;
+
+/*! \brief Segment control block stored in the last page of each mmapfile segment.
+ * This holds the committed length in a trailer rather than a file header,
+ * because consolidation concatenates segment files byte for byte: a
+ * header would have to be cut from the front of every file, while a
+ * trailer goes with the truncation to the committed length that closing
+ * a segment (or recovering one, see mmapfile_plugin) does anyway. So a
+ * closed segment contains only framed records.
+ */
+struct mmapfile_trailer {
+	char magic[8];                   //!< "ADCTMMAP"
+	uint64_t version;                //!< 1
+	uint64_t capacity;               //!< bytes available for records
+	std::atomic<uint64_t> committed; //!< bytes of records completely copied
+};
+
+/*! \brief Preallocated memory-mapped log publisher_api implementation.
+  This plugin writes each message with \<adct-json>\</adct-json> delimiters
+  into a preallocated, memory-mapped segment file. Publishing costs a
+  serialization, an atomic offset claim, and a memcpy; no system call is
+  made except when a segment fills and the next segment is created.
+
+  Unlike most publishers, publish() on this plugin is thread-safe, so threads
+  of one process may publish concurrently through one instance.
+
+  The output directory is "." by default, but may be overriden with
+  a full path defined in env("ADC_MMAPFILE_PLUGIN_DIRECTORY").
+  Segment files are named $FILE.NNNNNN, where FILE defaults to
+  adc.mmapfile_plugin.log and is overridden with env("ADC_MMAPFILE_PLUGIN_FILE").
+  Each initialize numbers its segments after those already in DIRECTORY
+  for the same FILE, which are kept. Of these, segments left by a process
+  that died still hold the trailer and preallocated space; initialize
+  truncates them to their committed length. A publish in flight at the
+  crash may leave a partial or empty record there, which
+  adc::validate_multifile_log reports. FILE must not be shared by live
+  processes.
+  Each segment holds env("ADC_MMAPFILE_PLUGIN_SEGMENT_SIZE") bytes (default 64 MiB),
+  or more if a single message is larger.
+  Debugging output is enabled if
+  env("ADC_MMAPFILE_PLUGIN_DEBUG") is a number greater than 0.
+
+  Closed segments use the same framing as the file plugin output, so
+  they may be merged with adc::consolidate_multifile_logs given a pattern
+  such as "$DIRECTORY/$FILE.*".
+ */
+class mmapfile_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+	/* one mapped file. It is unmapped and truncated to the committed
+	 * length when the last publisher using it releases it.
+	 */
+	struct segment {
+		int fd;
+		char *base;
+		size_t capacity;
+		size_t map_len;
+		mmapfile_trailer *trailer;
+		std::atomic<uint64_t> reserved;
+		int debug;
+
+		segment() : fd(-1), base(nullptr), capacity(0), map_len(0),
+			trailer(nullptr), reserved(0), debug(0) {}
+
+		~segment() {
+			uint64_t len = trailer ? trailer->committed.load(std::memory_order_acquire) : 0;
+			if (base) {
+				munmap(base, map_len);
+			}
+			if (fd >= 0) {
+				if (ftruncate(fd, len) && debug) {
+					std::cout << "mmapfile plugin: truncate failed: "
+						<< std::strerror(errno) << std::endl;
+				}
+				close(fd);
+			}
+		}
+	};
+
+private:
+	inline static const std::map< const string, const string > plugin_mmapfile_config_defaults =
+		{{ "DIRECTORY", "."},
+		 { "FILE", "adc.mmapfile_plugin.log" },
+		 { "SEGMENT_SIZE", "67108864" },
+		 { "DEBUG", "0" }
+		};
+	inline static const char *plugin_mmapfile_prefix = "ADC_MMAPFILE_PLUGIN_";
+	const string vers;
+	const std::vector<string> tags;
+	string fname;
+	string fdir;
+	size_t segment_size;
+	size_t page_size;
+	std::shared_ptr<segment> cur;
+	std::mutex roll_lock;
+	uint64_t next_segment;
+	int debug;
+	std::atomic<enum state> state;
+	std::atomic<bool> paused;
+	enum mode mode;
+
+	/* the number of segment file name n, or -1 if it is not one. */
+	long segment_number(const string& n) const {
+		if (n.size() < fname.size() + 7 || n.compare(0, fname.size(), fname) ||
+			n[fname.size()] != '.')
+			return -1;
+		long k = 0;
+		for (size_t i = fname.size() + 1; i < n.size(); i++) {
+			if (n[i] < '0' || n[i] > '9' || k > (LONG_MAX - 9) / 10)
+				return -1;
+			k = k * 10 + (n[i] - '0');
+		}
+		return k;
+	}
+
+	/* recover the segments of earlier runs and number ours after them. */
+	void scan_segments() {
+		next_segment = 0;
+		std::error_code ec;
+		for (const auto& de : std::filesystem::directory_iterator(fdir, ec)) {
+			long k = segment_number(de.path().filename().string());
+			if (k < 0)
+				continue;
+			int e = recover_segment(de.path().string(), page_size);
+			if (e && debug) {
+				std::cout << "mmapfile plugin: unable to recover " << de.path()
+					<< ": " << std::strerror(e) << std::endl;
+			}
+			if ((uint64_t)k >= next_segment)
+				next_segment = k + 1;
+		}
+	}
+
+	int config(const string dir, const string file, const string& ssize, const string& sdebug) {
+		if (mode != pi_config)
+			return 2;
+		std::stringstream sss(ssize);
+		sss >> segment_size;
+		if (sss.fail() || segment_size == 0) {
+			return EINVAL;
+		}
+		fname = file;
+		fdir = dir;
+		mode = pi_init;
+		std::stringstream ss(sdebug);
+		ss >> debug;
+		if (debug < 0) {
+			debug = 0;
+		}
+		if (debug > 0) {
+			std::cout<< "mmapfile plugin configured" <<std::endl;
+		}
+		return 0;
+	}
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_mmapfile_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	/* create, preallocate and map the next segment with room for at least min_len.
+	 * \return the segment or an empty pointer, with errno set.
+	 */
+	std::shared_ptr<segment> open_segment(size_t min_len) {
+		auto seg = std::make_shared<segment>();
+		seg->debug = debug;
+		size_t cap = std::max(segment_size, min_len);
+		cap = (cap + page_size - 1) / page_size * page_size;
+		seg->capacity = cap;
+		seg->map_len = cap + page_size;
+		std::stringstream ss;
+		ss << fdir << "/" << fname << "." << std::setw(6) << std::setfill('0') << next_segment++;
+		string fpath = ss.str();
+		seg->fd = open(fpath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (seg->fd < 0) {
+			if (debug) {
+				std::cout << "mmapfile plugin: unable to open " << fpath << ": "
+					<< std::strerror(errno) << std::endl;
+			}
+			return std::shared_ptr<segment>();
+		}
+		int ferr = posix_fallocate(seg->fd, 0, seg->map_len);
+		if (ferr == EOPNOTSUPP || ferr == EINVAL) {
+			// file systems without preallocation still get a sparse file.
+			ferr = ftruncate(seg->fd, seg->map_len) ? errno : 0;
+		}
+		if (ferr) {
+			if (debug) {
+				std::cout << "mmapfile plugin: unable to allocate " << fpath << ": "
+					<< std::strerror(ferr) << std::endl;
+			}
+			errno = ferr;
+			return std::shared_ptr<segment>();
+		}
+		void *base = mmap(nullptr, seg->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+		if (base == MAP_FAILED) {
+			if (debug) {
+				std::cout << "mmapfile plugin: unable to map " << fpath << ": "
+					<< std::strerror(errno) << std::endl;
+			}
+			return std::shared_ptr<segment>();
+		}
+		seg->base = static_cast<char *>(base);
+		seg->trailer = new (seg->base + cap) mmapfile_trailer;
+		memcpy(seg->trailer->magic, "ADCTMMAP", 8);
+		seg->trailer->version = 1;
+		seg->trailer->capacity = cap;
+		seg->trailer->committed.store(0, std::memory_order_release);
+		if (debug) {
+			std::cout << "mmapfile plugin: opened " << fpath << std::endl;
+		}
+		return seg;
+	}
+
+	/* replace full segment old, unless another thread already has. */
+	int rollover(const std::shared_ptr<segment>& old, size_t min_len) {
+		std::lock_guard<std::mutex> guard(roll_lock);
+		if (std::atomic_load(&cur) != old) {
+			return 0;
+		}
+		auto seg = open_segment(min_len);
+		if (!seg) {
+			int e = errno ? errno : EIO;
+			state = err;
+			return e;
+		}
+		std::atomic_store(&cur, seg);
+		return 0;
+	}
+
+public:
+	/*! \brief truncate segment file path, if a crashed process left its
+	 * trailer in it, to the committed length. Closed segments are unchanged.
+	 * \return 0 or errno.
+	 */
+	static int recover_segment(const string& path, size_t page_size) {
+		struct {
+			char magic[8];
+			uint64_t version;
+			uint64_t capacity;
+			uint64_t committed;
+		} t;
+		static_assert(sizeof(t) == sizeof(mmapfile_trailer), "trailer layout");
+		int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			return errno;
+		struct stat sb;
+		int e = 0;
+		if (fstat(fd, &sb)) {
+			e = errno;
+		} else if ((size_t)sb.st_size > page_size && sb.st_size % page_size == 0 &&
+			pread(fd, &t, sizeof(t), sb.st_size - page_size) == (ssize_t)sizeof(t) &&
+			!memcmp(t.magic, "ADCTMMAP", 8) && t.version == 1 &&
+			t.capacity == sb.st_size - page_size && t.committed <= t.capacity) {
+			if (ftruncate(fd, t.committed))
+				e = errno;
+		}
+		close(fd);
+		return e;
+	}
+
+	mmapfile_plugin() : vers("1.0.0") , tags({"none"}), segment_size(0),
+		page_size(sysconf(_SC_PAGESIZE)), next_segment(0), debug(0),
+		state(ok), paused(false), mode(pi_config) { }
+
+	int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		static const string_view prefix = "<adct-json>";
+		static const string_view suffix = "</adct-json>\n";
+		string payload = counted_serialize(b);
+		size_t len = prefix.size() + payload.size() + suffix.size();
+		while (true) {
+			auto seg = std::atomic_load(&cur);
+			if (!seg) {
+				return 2;
+			}
+			uint64_t off = seg->reserved.fetch_add(len, std::memory_order_relaxed);
+			if (off + len <= seg->capacity) {
+				char *dst = seg->base + off;
+				memcpy(dst, prefix.data(), prefix.size());
+				dst += prefix.size();
+				memcpy(dst, payload.data(), payload.size());
+				dst += payload.size();
+				memcpy(dst, suffix.data(), suffix.size());
+				seg->trailer->committed.fetch_add(len, std::memory_order_release);
+				if (debug > 1) {
+					std::cout << "'mmapfile' wrote" << std::endl;
+				}
+				return 0;
+			}
+			int e = rollover(seg, len);
+			if (e) {
+				return e;
+			}
+		}
+	}
+
+	int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_mmapfile_prefix);
+	}
+
+	int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		string d = get(m, "DIRECTORY", env_prefix);
+		string f = get(m, "FILE", env_prefix);
+		string s = get(m, "SEGMENT_SIZE", env_prefix);
+		string sdebug = get(m, "DEBUG", env_prefix);
+		return config(d, f, s, sdebug);
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_mmapfile_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		// config if never config'd
+		if (!fname.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		if ( state == err ) {
+			std::cout << "mmapfile plugin initialize found pre-existing error" << std::endl;
+			return 3;
+		}
+		std::error_code ec;
+		std::filesystem::create_directories(fdir, ec);
+		if (ec.value() != 0 && ec.value() != EEXIST ) {
+			state = err;
+			std::cout << "unable to create output directory for plugin 'mmapfile'; "
+			       	<< fdir << " : " << ec.message() << std::endl;
+			return ec.value();
+		}
+		scan_segments();
+		auto seg = open_segment(0);
+		if (!seg) {
+			state = err;
+			return errno ? errno : EBADF;
+		}
+		std::atomic_store(&cur, seg);
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+	void finalize() {
+		if (mode == pi_pub_or_final) {
+			// the segment is truncated and closed when the last
+			// in-flight publish releases it.
+			std::atomic_store(&cur, std::shared_ptr<segment>());
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "mmapfile plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+	void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "mmapfile";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~mmapfile_plugin() {
+		if (debug) {
+			std::cout << "Destructing mmapfile_plugin" << std::endl;
+		}
+	}
+};
+
+} // adc
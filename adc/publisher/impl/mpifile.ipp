@@ -0,0 +1,356 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <cstdlib>
+#include <cstdint>
+#include <climits>
+#include <iostream>
+#include <filesystem>
+#include <mpi.h>
+
+namespace adc {
+
+using std::string;
+using std::string_view;
+
+/*! \brief MPI-IO shared file publisher_api implementation.
+  All ranks of a communicator write \<adct-json>\</adct-json> delimited
+  messages into one shared file, avoiding the file per rank created by the
+  multifile plugin. The file is $DIRECTORY/$FILE, with DIRECTORY "." and
+  FILE adc.mpifile_plugin.log by default, overridden with
+  env("ADC_MPIFILE_PLUGIN_DIRECTORY") and env("ADC_MPIFILE_PLUGIN_FILE").
+  The file is truncated unless env("ADC_MPIFILE_PLUGIN_APPEND") is "true".
+
+  The MODE option (env("ADC_MPIFILE_PLUGIN_MODE")) selects how ranks write:
+  - "collective" (default): publish is collective over the communicator.
+    Record offsets come from MPI_Exscan of the record sizes, and the records
+    are written with MPI_File_write_at_all. Every rank must call publish the
+    same number of times; a paused rank or a null builder contributes an
+    empty record so the collectives still match; so does a record too large
+    for an MPI count, for which publish returns E2BIG. If the write fails
+    on any rank, the plugin stops publishing on all of them.
+  - "shared": each publish is independent and is written with
+    MPI_File_write_shared, so records appear in the order the shared file
+    pointer is claimed.
+
+  The COMM option selects the communicator: "world" (default), "self", or
+  the decimal Fortran handle of any communicator (from MPI_Comm_c2f), since
+  plugin options are strings. The communicator is duplicated, so
+  initialize and finalize are collective over it and MPI must be
+  initialized before initialize and finalized after finalize.
+
+  Debugging output is enabled if env("ADC_MPIFILE_PLUGIN_DEBUG") is a
+  number greater than 0.
+
+  The output has the same framing as the file and multifile plugins, and
+  may be checked with adc::validate_multifile_log.
+ */
+class mpifile_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+private:
+	inline static const std::map< const string, const string > plugin_mpifile_config_defaults =
+		{{ "DIRECTORY", "."},
+		 { "FILE", "adc.mpifile_plugin.log" },
+		 { "MODE", "collective" },
+		 { "COMM", "world" },
+		 { "APPEND", "false" },
+		 { "DEBUG", "0" }
+		};
+	inline static const char *plugin_mpifile_prefix = "ADC_MPIFILE_PLUGIN_";
+	const string vers;
+	const std::vector<string> tags;
+	string fname;
+	string fdir;
+	bool fappend;
+	bool collective;
+	MPI_Comm base_comm;
+	MPI_Comm comm;
+	MPI_File fh;
+	int rank;
+	MPI_Offset base;
+	int debug;
+	enum state state;
+	bool paused;
+	enum mode mode;
+
+	int config(const string dir, const string file, const string& smode,
+		const string& scomm, bool append, const string& sdebug) {
+		if (mode != pi_config)
+			return 2;
+		if (smode == "collective") {
+			collective = true;
+		} else if (smode == "shared") {
+			collective = false;
+		} else {
+			return EINVAL;
+		}
+		if (scomm == "world") {
+			base_comm = MPI_COMM_WORLD;
+		} else if (scomm == "self") {
+			base_comm = MPI_COMM_SELF;
+		} else {
+			std::stringstream sc(scomm);
+			MPI_Fint f;
+			sc >> f;
+			if (sc.fail())
+				return EINVAL;
+			base_comm = MPI_Comm_f2c(f);
+		}
+		fname = file;
+		fdir = dir;
+		fappend = append;
+		mode = pi_init;
+		std::stringstream ss(sdebug);
+		ss >> debug;
+		if (debug < 0) {
+			debug = 0;
+		}
+		if (debug > 0) {
+			std::cout<< "mpifile plugin configured" <<std::endl;
+		}
+		return 0;
+	}
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_mpifile_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	// print the MPI error text if debugging, and return 1 if rc is an error.
+	int check(int rc, const char *what) {
+		if (rc == MPI_SUCCESS)
+			return 0;
+		if (debug) {
+			char msg[MPI_MAX_ERROR_STRING];
+			int len = 0;
+			MPI_Error_string(rc, msg, &len);
+			std::cout << "mpifile plugin: " << what << " failed: "
+				<< string(msg, len) << std::endl;
+		}
+		return 1;
+	}
+
+public:
+	mpifile_plugin() : vers("1.0.0") , tags({"none"}), fappend(false), collective(true),
+		base_comm(MPI_COMM_NULL), comm(MPI_COMM_NULL), fh(MPI_FILE_NULL), rank(0),
+		base(0), debug(0), state(ok), paused(false), mode(pi_config) { }
+
+	int publish(std::shared_ptr<builder_api> b) {
+		if (mode != pi_pub_or_final)
+			return 2;
+		if (state != ok)
+			return 1;
+		if (!collective && (!b || paused))
+			return b ? 0 : EINVAL;
+		string rec;
+		if (b && !paused) {
+			string payload = counted_serialize(b);
+			rec.reserve(payload.size() + 24);
+			rec += "<adct-json>";
+			rec += payload;
+			rec += "</adct-json>\n";
+		}
+		bool too_big = rec.size() > INT_MAX;
+		if (too_big) {
+			// MPI counts are int; other ranks still need our (empty) turn.
+			rec.clear();
+			if (!collective)
+				return E2BIG;
+		}
+		int rc;
+		MPI_Status st;
+		if (collective) {
+			uint64_t len = rec.size(), off = 0, total = 0;
+			rc = MPI_Exscan(&len, &off, 1, MPI_UINT64_T, MPI_SUM, comm);
+			if (check(rc, "MPI_Exscan"))
+				return 1;
+			if (rank == 0)
+				off = 0;
+			rc = MPI_Allreduce(&len, &total, 1, MPI_UINT64_T, MPI_SUM, comm);
+			if (check(rc, "MPI_Allreduce"))
+				return 1;
+			rc = MPI_File_write_at_all(fh, base + off, rec.data(),
+				(int)len, MPI_BYTE, &st);
+			// offsets must stay the same on all ranks: if any write
+			// failed, every rank stops publishing.
+			int failed = (rc != MPI_SUCCESS), any = 0;
+			if (MPI_Allreduce(&failed, &any, 1, MPI_INT, MPI_LOR, comm) != MPI_SUCCESS)
+				any = 1;
+			if (any) {
+				check(rc, "MPI_File_write_at_all");
+				state = err;
+				return 1;
+			}
+			base += total;
+		} else {
+			rc = MPI_File_write_shared(fh, rec.data(), (int)rec.size(), MPI_BYTE, &st);
+		}
+		if (check(rc, "write"))
+			return 1;
+		if (debug > 1) {
+			std::cout << "'mpifile' wrote" << std::endl;
+		}
+		if (!b)
+			return EINVAL;
+		if (too_big)
+			return E2BIG;
+		return 0;
+	}
+
+	int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_mpifile_prefix);
+	}
+
+	int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		string d = get(m, "DIRECTORY", env_prefix);
+		string f = get(m, "FILE", env_prefix);
+		string smode = get(m, "MODE", env_prefix);
+		string scomm = get(m, "COMM", env_prefix);
+		bool app = ( get(m, "APPEND", env_prefix) == "true");
+		string sdebug = get(m, "DEBUG", env_prefix);
+		return config(d, f, smode, scomm, app, sdebug);
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_mpifile_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		// config if never config'd
+		if (!fname.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		if ( state == err ) {
+			std::cout << "mpifile plugin initialize found pre-existing error" << std::endl;
+			return 3;
+		}
+		int flag = 0;
+		MPI_Initialized(&flag);
+		if (!flag) {
+			if (debug) {
+				std::cout << "mpifile plugin: MPI is not initialized" << std::endl;
+			}
+			return ENOTCONN;
+		}
+		if (check(MPI_Comm_dup(base_comm, &comm), "MPI_Comm_dup")) {
+			state = err;
+			return 1;
+		}
+		MPI_Comm_rank(comm, &rank);
+		int derr = 0;
+		if (rank == 0) {
+			std::error_code ec;
+			std::filesystem::create_directories(fdir, ec);
+			if (ec.value() != 0 && ec.value() != EEXIST ) {
+				std::cout << "unable to create output directory for plugin 'mpifile'; "
+					<< fdir << " : " << ec.message() << std::endl;
+				derr = ec.value();
+			}
+		}
+		MPI_Bcast(&derr, 1, MPI_INT, 0, comm);
+		if (derr) {
+			MPI_Comm_free(&comm);
+			state = err;
+			return derr;
+		}
+		std::filesystem::path dpath {fdir};
+		std::filesystem::path fpath = dpath / fname;
+		int rc = MPI_File_open(comm, fpath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+			MPI_INFO_NULL, &fh);
+		if (check(rc, "MPI_File_open")) {
+			MPI_Comm_free(&comm);
+			state = err;
+			return 1;
+		}
+		base = 0;
+		if (fappend) {
+			rc = MPI_File_get_size(fh, &base);
+			if (!rc && !collective)
+				rc = MPI_File_seek_shared(fh, 0, MPI_SEEK_END);
+		} else {
+			rc = MPI_File_set_size(fh, 0);
+		}
+		if (check(rc, "initial file positioning")) {
+			MPI_File_close(&fh);
+			MPI_Comm_free(&comm);
+			state = err;
+			return 1;
+		}
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+	void finalize() {
+		if (mode == pi_pub_or_final) {
+			int flag = 0;
+			MPI_Finalized(&flag);
+			if (flag) {
+				std::cout << "mpifile plugin finalize after MPI_Finalize" << std::endl;
+			} else {
+				check(MPI_File_close(&fh), "MPI_File_close");
+				MPI_Comm_free(&comm);
+			}
+			fh = MPI_FILE_NULL;
+			comm = MPI_COMM_NULL;
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "mpifile plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+	void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "mpifile";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~mpifile_plugin() {
+		if (debug) {
+			std::cout << "Destructing mpifile_plugin" << std::endl;
+		}
+	}
+};
+
+} // adc
@@ -4,6 +4,8 @@
  */
 #ifndef adc_publisher_ipp
 #define adc_publisher_ipp
+#include <adc/builder/impl/builder.hpp>
+#include <set>
 
 namespace adc {
 
@@ -23,15 +25,161 @@ private:
 	enum state state;
 	int debug;
 	publisher_vector pvec;
+	// the counters of pvec[i]: its own if it is a counted_publisher.
+	std::vector< publisher_stats * > pstats;
+	std::vector< std::unique_ptr< publisher_stats > > kept_stats;
+	publisher_stats group_stats;
+
+	// overhead governor; off unless budget > 0.
+	double budget;		// percent of wall time
+	double resume_below;	// percent of wall time
+	uint64_t window_ns;
+	std::set< string > critical;
+	bool app_paused;	// by pause(), not the governor
+	bool governed;		// non-critical publishers paused by the governor
+	bool just_resumed;	// in the first window after a governor resume
+	uint64_t window_start;
+	uint64_t adc_ns;	// in this window
+	unsigned hold;		// windows to stay paused
+	unsigned held;		// windows paused so far
+	uint64_t governed_since;
+	uint64_t suppressed;	// messages published while governed
+
+	static constexpr unsigned max_hold = 64;
+
+	bool is_critical(const std::shared_ptr<publisher_api>& p) {
+		return critical.count(string(p->name())) > 0;
+	}
+
+	// read the governor settings from env; leave it off if they are bad.
+	void config_governor() {
+		const char *env = getenv("ADC_MULTI_PUBLISHER_BUDGET");
+		if (!env || !*env)
+			return;
+		double b = 0, w = 10, r = -1;
+		std::stringstream bs(env);
+		bs >> b;
+		env = getenv("ADC_MULTI_PUBLISHER_BUDGET_WINDOW");
+		std::stringstream ws(env ? env : "10");
+		ws >> w;
+		env = getenv("ADC_MULTI_PUBLISHER_BUDGET_RESUME");
+		if (env && *env) {
+			std::stringstream rs(env);
+			rs >> r;
+			if (rs.fail())
+				r = -2;
+		} else {
+			r = b / 2;
+		}
+		if (bs.fail() || ws.fail() || b < 0 || w <= 0 || r < 0 || r > b) {
+			std::cout << "multi_publisher: ignoring bad ADC_MULTI_PUBLISHER_BUDGET settings"
+				<< std::endl;
+			return;
+		}
+		budget = b;
+		resume_below = r;
+		window_ns = (uint64_t)(w * 1e9);
+		env = getenv("ADC_MULTI_PUBLISHER_CRITICAL");
+		std::stringstream cs(env ? env : "");
+		string name;
+		while (std::getline(cs, name, ':'))
+			if (name.size())
+				critical.insert(name);
+		window_start = publisher_stats::now_ns();
+	}
+
+	// publish the governor transition record to every publisher; it is
+	// called before pausing and after resuming, so none is governed.
+	void governor_record(bool resuming, double percent, uint64_t now) {
+		const char *action = resuming ? "resume" : "pause";
+		std::shared_ptr<builder_api> msg(new builder);
+		msg->add_header_section("adc_governor");
+		std::shared_ptr<builder_api> app_data(new builder);
+		app_data->add("action", action);
+		app_data->add("overhead_percent", percent);
+		app_data->add("budget_percent", budget);
+		app_data->add("resume_percent", resume_below);
+		app_data->add("window_seconds", (double)window_ns * 1e-9);
+		app_data->add("hold_windows", (uint64_t)hold);
+		string names;
+		for (auto& element : pvec) {
+			if (is_critical(element))
+				continue;
+			if (names.size())
+				names += ":";
+			names += string(element->name());
+		}
+		app_data->add("publishers", names);
+		if (resuming) {
+			app_data->add("paused_seconds", (double)(now - governed_since) * 1e-9);
+			app_data->add("messages_suppressed", suppressed);
+		}
+		msg->add_app_data_section(app_data);
+		if (debug) {
+			std::cout << "multi_publisher: governor " << action << " at "
+				<< percent << "% of wall time: " << names << std::endl;
+		}
+		for (auto& element : pvec) {
+			element->publish(msg);
+		}
+	}
+
+	// account for ns spent in ADC and act at the end of a window.
+	void govern(uint64_t ns, uint64_t now) {
+		adc_ns += ns;
+		if (governed)
+			suppressed++;
+		if (now - window_start < window_ns)
+			return;
+		double percent = 100.0 * (double)adc_ns / (double)(now - window_start);
+		window_start = now;
+		adc_ns = 0;
+		if (!governed) {
+			if (percent > budget) {
+				hold = just_resumed ? std::min(2 * hold, max_hold) : 1;
+				held = 0;
+				governor_record(false, percent, now);
+				governed = true;
+				governed_since = now;
+				suppressed = 0;
+				bool counting = publisher_stats::enabled();
+				for (size_t i = 0; i < pvec.size(); i++) {
+					if (is_critical(pvec[i]))
+						continue;
+					pvec[i]->pause();
+					if (counting)
+						pstats[i]->record_pause();
+				}
+			}
+			just_resumed = false;
+			return;
+		}
+		held++;
+		if (percent < resume_below && held >= hold) {
+			governed = false;
+			just_resumed = true;
+			if (!app_paused) {
+				for (auto& element : pvec) {
+					if (!is_critical(element))
+						element->resume();
+				}
+			}
+			governor_record(true, percent, now);
+		}
+	}
 
 public:
-	multi_publisher() : vers("1.0.0") , tags({"none"}), state(ok), debug(0) {
+	multi_publisher() : vers("1.0.0") , tags({"none"}), state(ok), debug(0),
+		budget(0), resume_below(0), window_ns(0), app_paused(false),
+		governed(false), just_resumed(false), window_start(0), adc_ns(0),
+		hold(1), held(0), governed_since(0), suppressed(0) {
 		const char *env = getenv("ADC_MULTI_PUBLISHER_DEBUG");
 		if (env && !strcmp(env,"1") ) {
 			debug = 1;
 		} else {
 			debug = 0;
 		}
+		config_governor();
 	}
 
         string_view version() const {
@@ -48,6 +196,13 @@ public:
 			return;
 		}
 		pvec.push_back(p);
+		auto cp = dynamic_cast< counted_publisher * >(p.get());
+		if (cp) {
+			pstats.push_back(&cp->get_stats());
+		} else {
+			kept_stats.emplace_back(new publisher_stats);
+			pstats.push_back(kept_stats.back().get());
+		}
 		if (debug) {
 			std::cout << "publisher added: "
 			       	<< p->name() << std::endl;
@@ -61,10 +216,27 @@ public:
 		if (state != ok)
 			return EBADFD;
 		int err = 0;
-		for (auto& element : pvec) {
+		int first = 0;
+		bool counting = publisher_stats::enabled();
+		bool timed = publisher_stats::time_next();
+		bool governing = budget > 0;
+		uint64_t t0 = (timed || governing) ? publisher_stats::now_ns() : 0;
+		uint64_t t = t0;
+		for (size_t i = 0; i < pvec.size(); i++) {
+			auto& element = pvec[i];
 			int e = element->publish(b);
+			// calls suppressed by the governor are counted in its resume record.
+			if (counting && !(governed && !is_critical(element)))
+				pstats[i]->record_publish(e);
+			if (timed) {
+				uint64_t t1 = publisher_stats::now_ns();
+				pstats[i]->record_publish_time(t1 - t);
+				t = t1;
+			}
 			if (e) {
 				err += 1;
+				if (!first)
+					first = e;
 				if (debug) {
 					std::cout << "publish failed (" << e << 
 						") for plugin "
@@ -72,6 +244,15 @@ public:
 				}
 			}	
 		}
+		if (counting)
+			group_stats.record_publish(first);
+		if (timed)
+			group_stats.record_publish_time(t - t0);
+		if (governing) {
+			if (!timed)
+				t = publisher_stats::now_ns();
+			govern(t - t0, t);
+		}
 		return err;
 	}
 
@@ -81,22 +262,39 @@ public:
 			element->finalize();
 		}
 		pvec.clear();
+		pstats.clear();
+		kept_stats.clear();
 	}
 
 	void pause()
 	{
-		for (auto& element : pvec) {
-			element->pause();
+		app_paused = true;
+		bool counting = publisher_stats::enabled();
+		if (counting)
+			group_stats.record_pause();
+		for (size_t i = 0; i < pvec.size(); i++) {
+			pvec[i]->pause();
+			if (counting)
+				pstats[i]->record_pause();
 		}
 	}
 
 	void resume()
 	{
+		app_paused = false;
 		for (auto& element : pvec) {
+			if (governed && !is_critical(element))
+				continue;
 			element->resume();
 		}
 	}
 
+	void add_overhead(uint64_t ns)
+	{
+		if (budget > 0)
+			adc_ns += ns;
+	}
+
 	std::vector< std::string > get_names()
 	{
 		std::vector< std::string > v(pvec.size());
@@ -105,6 +303,35 @@ public:
 		}
 		return v;
 	}
+
+	std::vector< std::pair< std::string, publisher_stats::snapshot > > get_stats()
+	{
+		std::vector< std::pair< std::string, publisher_stats::snapshot > > v;
+		v.reserve(pvec.size() + 1);
+		v.emplace_back("multi_publisher", group_stats.get());
+		for (size_t i = 0; i < pvec.size(); i++) {
+			v.emplace_back(string(pvec[i]->name()), pstats[i]->get());
+		}
+		return v;
+	}
+
+	void add_self_section(std::shared_ptr<builder_api> b)
+	{
+		if (!b)
+			return;
+		std::shared_ptr<builder_api> self(new builder);
+		std::map< string, int > seen;
+		for (const auto& s : get_stats()) {
+			string n = s.first;
+			int k = seen[n]++;
+			if (k)
+				n += "." + std::to_string(k);
+			std::shared_ptr<builder_api> counts(new builder);
+			s.second.add_to(counts);
+			self->add_section(n, counts);
+		}
+		b->add_section("adc_self", self);
+	}
 };  // class multi_publisher
 
 } // namespace adc
@@ -4,6 +4,9 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/record_writer.ipp>
+#include <adc/publisher/impl/record_scan.ipp>
+#include <adc/publisher/impl/record_index.ipp>
 #include <cstdlib>
 #include <cstdio>
 #include <cerrno>
@@ -13,9 +16,13 @@
 #include <vector>
 #include <string>
 #include <chrono>
-// for glob_sendfile_join
-#include <sys/sendfile.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <cstring>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <glob.h>
@@ -43,8 +50,16 @@ using std::string_view;
   DIR/$user/[$adc_wfid.]H_$host.P$pid.T$start.$publisherptr/$application.$rank.XXXXXX
 
   Files opened will remain opened until the publisher is finalized.
+
+  Output is buffered per file with the same BUFFER_SIZE, FLUSH, FLUSH_COUNT,
+  FLUSH_MS, and SYNC options as the file plugin, overridden with
+  env("ADC_MULTIFILE_PLUGIN_$OPTION").
+
+  If env("ADC_MULTIFILE_PLUGIN_INDEX") is "true", each file gets a
+  record_index sidecar $file.idx, sealed at finalize. Consolidation merges
+  the sidecars it finds into an index of the consolidated log.
  */
-class multifile_plugin : public publisher_api {
+class multifile_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -61,7 +76,13 @@ private:
 		{
 			{ "DIRECTORY", "."},
 			{ "DEBUG", "0"},
-			{ "RANK", ""}
+			{ "RANK", ""},
+			{ "BUFFER_SIZE", record_writer::buffer_size_default },
+			{ "FLUSH", record_writer::flush_default },
+			{ "FLUSH_COUNT", record_writer::flush_count_default },
+			{ "FLUSH_MS", record_writer::flush_ms_default },
+			{ "SYNC", record_writer::sync_default },
+			{ "INDEX", "false" }
 		};
 	inline static const char *plugin_multifile_prefix = "ADC_MULTIFILE_PLUGIN_";
 	const string vers;
@@ -70,7 +91,9 @@ private:
 	string topdir;
 	string user;
 	string rank;
-	std::map< std::string, std::unique_ptr< std::ofstream > > app_out;
+	std::map< std::string, std::unique_ptr< record_writer > > app_out;
+	std::map< std::string, std::unique_ptr< index_writer > > app_idx;
+	std::map< string, string > writer_options;
 	int debug;
 	enum state state;
 	bool paused;
@@ -79,6 +102,12 @@ private:
 	int config(const string dir, const string user_rank, const string sdebug) {
 		if (mode != pi_config)
 			return 2;
+		record_writer probe;
+		if (probe.configure(writer_options["BUFFER_SIZE"], writer_options["FLUSH"],
+			writer_options["FLUSH_COUNT"], writer_options["FLUSH_MS"],
+			writer_options["SYNC"])) {
+			return EINVAL;
+		}
 		char hname[HOST_NAME_MAX+1];
 		char uname[L_cuserid+1];
 		if (gethostname(hname, HOST_NAME_MAX+1)) {
@@ -243,6 +272,10 @@ private:
 		if (app_out.count(application)) {
 			return;
 		}
+		auto w = std::make_unique< record_writer >();
+		w->configure(writer_options["BUFFER_SIZE"], writer_options["FLUSH"],
+			writer_options["FLUSH_COUNT"], writer_options["FLUSH_MS"],
+			writer_options["SYNC"]);
 		std::stringstream ss;
 		ss << fdir << "/" << application << ".R" << rank << ".XXXXXX";
 		string fpath = ss.str();
@@ -251,7 +284,7 @@ private:
 			if (debug) {
 				std::cerr << __FILE__ << ": out of memory" << std::endl;
 			}
-			app_out[application] = std::make_unique< std::ofstream >();
+			app_out[application] = std::move(w);
 			return;
 		}
 		int fd = mkstemp(ftemplate);
@@ -260,12 +293,22 @@ private:
 				std::cerr << __FILE__ << ": mkstemp failed for " << ftemplate << std::endl;
 			}
 			free(ftemplate);
-			app_out[application] = std::make_unique< std::ofstream >();
+			app_out[application] = std::move(w);
 			return;
 		}
-		close(fd);
-		app_out[application] = std::make_unique< std::ofstream >(ftemplate,
-				(std::ofstream::out | std::ofstream::trunc));
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		w->adopt(fd);
+		app_out[application] = std::move(w);
+		if (writer_options["INDEX"] == "true") {
+			auto x = std::make_unique< index_writer >();
+			x->configure(writer_options["BUFFER_SIZE"], writer_options["FLUSH"],
+				writer_options["FLUSH_COUNT"], writer_options["FLUSH_MS"],
+				writer_options["SYNC"]);
+			if (x->open(ftemplate) && debug) {
+				std::cerr << __FILE__ << ": index open failed for " << ftemplate << std::endl;
+			}
+			app_idx[application] = std::move(x);
+		}
 		std::filesystem::permissions(ftemplate,
 					(
 					std::filesystem::perms::owner_read |
@@ -313,8 +356,16 @@ public:
 		}
 		
 		create_stream(app);
-		if (app_out[app]->is_open() && app_out[app]->good()) {
-			*(app_out[app]) << string("<adct-json>")  << b->serialize() << "</adct-json>" << std::endl;
+		auto& out = app_out[app];
+		string payload = counted_serialize(b);
+		uint64_t offset = out->tell();
+		if (out->good() &&
+			!out->write_record("<adct-json>", payload, "</adct-json>\n")) {
+			auto x = app_idx.find(app);
+			if (x != app_idx.end() && x->second->good() &&
+				x->second->add(offset, payload) && debug) {
+				std::cerr << __FILE__ << ": index write failed" << std::endl;
+			}
 			if (debug) {
 				std::cerr << "'multifile' wrote" << std::endl;
 			}
@@ -334,6 +385,9 @@ public:
 		string d = get(m, "DIRECTORY", env_prefix);
 		string r = get(m, "RANK", env_prefix);
 		string l = get(m, "DEBUG", env_prefix);
+		for (const auto& o : { "BUFFER_SIZE", "FLUSH", "FLUSH_COUNT", "FLUSH_MS", "SYNC", "INDEX" }) {
+			writer_options[o] = get(m, o, env_prefix);
+		}
 		return config(d, r, l);
 	}
         
@@ -393,6 +447,7 @@ public:
 			paused = false;
 			mode = pi_config;
 			app_out.clear();
+			app_idx.clear();
 		} else {
 			if (debug) {
 				std::cerr << "multifile plugin finalize on non-running plugin" << std::endl;
@@ -424,7 +479,7 @@ public:
 
 	inline static std::vector<std::string> consolidate_multifile_logs(
 		const string& pattern, std::vector< std::string>& old_paths,
-		int debug=0)
+		int debug=0, unsigned threads=1)
 	{
 		namespace fs = std::filesystem;
 		std::vector<std::string> new_files;
@@ -458,27 +513,85 @@ public:
 		if (ec) {
 			perm = 0640;
 		}
-		int merge_err = glob_sendfile_join(dest, pattern.c_str(), perm, old_paths, unmerged);
+		int merge_err = glob_parallel_join(dest, pattern.c_str(), perm, threads,
+			old_paths, unmerged, debug);
+		if (debug) {
+			for (auto f : unmerged) {
+				std::cerr << __FILE__ <<
+					": unmergeable file: " <<
+					f << std::endl;
+			}
+		}
 		if (merge_err) {
 			if (debug) {
-				for (auto f : unmerged) {
-					std::cerr << __FILE__ <<
-						": unmergeable file: " <<
-					       	f << std::endl;
-				}
-				for (auto f : old_paths) {
-					std::cerr << __FILE__ << 
-						": ignoring mergable file: "
-					       	<< f << std::endl;
-				}
+				std::cerr << __FILE__ << ": consolidation into " << dest
+					<< " failed: " << std::strerror(merge_err) << std::endl;
 			}
 			old_paths.clear();
 			return new_files;
 		}
-		new_files.push_back(dest);
+		if (old_paths.size()) {
+			new_files.push_back(dest);
+			int ierr = join_indexes(dest, old_paths, threads);
+			if (ierr && debug) {
+				std::cerr << __FILE__ << ": index of " << dest
+					<< " not written: " << std::strerror(ierr) << std::endl;
+			}
+		}
 		return new_files;
 	}
 
+	/*! \brief write dest.idx from the sidecar indexes of the merged inputs.
+	 * Nothing is done unless some input has an index. Inputs without a
+	 * usable index are scanned. Input indexes are appended to merged, so
+	 * they are removed with the inputs.
+	 * \param merged inputs in dest order, as from glob_parallel_join.
+	 * \return 0 or errno.
+	 */
+	inline static int join_indexes(const string& dest, std::vector<std::string>& merged,
+		unsigned threads)
+	{
+		std::vector<std::string> idx_paths;
+		for (const auto& m : merged) {
+			string ip = record_index::index_path(m);
+			if (!access(ip.c_str(), F_OK))
+				idx_paths.push_back(ip);
+		}
+		if (idx_paths.empty())
+			return 0;
+		std::vector<record_index::entry> entries;
+		uint64_t offset = 0;
+		int err = 0;
+		for (const auto& m : merged) {
+			struct stat sb;
+			if (stat(m.c_str(), &sb)) {
+				err = errno;
+				break;
+			}
+			std::vector<record_index::entry> part;
+			if (!record_index::load(record_index::index_path(m), sb.st_size, part)) {
+				for (auto& e : part)
+					e.offset += offset;
+				entries.insert(entries.end(), part.begin(), part.end());
+			} else {
+				err = record_index::scan_file(m, offset, threads, entries);
+				if (err)
+					break;
+			}
+			offset += sb.st_size;
+		}
+		struct stat db;
+		if (!err && (stat(dest.c_str(), &db) || (uint64_t)db.st_size != offset)) {
+			// inputs changed after the join; index the result directly.
+			entries.clear();
+			err = record_index::scan_file(dest, 0, threads, entries);
+		}
+		if (!err)
+			err = record_index::write_sealed(record_index::index_path(dest), entries);
+		merged.insert(merged.end(), idx_paths.begin(), idx_paths.end());
+		return err;
+	}
+
 	/*! Utility to get output directory glob pattern from the multifile_publisher.
 	 */
 	inline static std::string get_multifile_log_path(string_view dir, string_view wfid)
@@ -501,20 +614,128 @@ public:
 		return s;
 	}
 
-	/*! \brief use sendfile to join all files matching pattern in new dest file.
+	/*! \brief an input of glob_parallel_join, in output order. */
+	struct join_source {
+		string path;
+		string app;
+		unsigned long long rank; //!< ULLONG_MAX if the name has no rank.
+		off_t size;
+		off_t offset; //!< destination offset
+		int err;
+	};
+
+	/*! \brief split .../app.Rrank.XXXXXX into app and rank.
+	 * Names not in that form keep the whole file name as app.
+	 */
+	inline static void parse_app_rank(const string& path, string& app, unsigned long long& rank)
+	{
+		string base = std::filesystem::path(path).filename().string();
+		rank = ULLONG_MAX;
+		app = base;
+		auto dot = base.rfind('.');
+		if (dot == string::npos)
+			return;
+		string stem = base.substr(0, dot);
+		auto rpos = stem.rfind(".R");
+		if (rpos == string::npos)
+			return;
+		app = stem.substr(0, rpos);
+		string r = stem.substr(rpos + 2);
+		if (r.size() && r.find_first_not_of("0123456789") == string::npos) {
+			rank = std::strtoull(r.c_str(), nullptr, 10);
+		}
+	}
+
+	/*! \brief copy len bytes from sfd at soff to dfd at doff.
+	 * copy_file_range is tried first (allowing server-side copy); pread/pwrite
+	 * is used if it is refused or allow_cfr is false.
+	 * \return 0 or errno; ENODATA if the source is shorter than expected.
+	 */
+	inline static int copy_region(int sfd, off_t soff, int dfd, off_t doff,
+		size_t len, bool allow_cfr)
+	{
+		std::unique_ptr<char[]> buf;
+		const size_t bsize = 1 << 20;
+		while (len > 0) {
+			if (allow_cfr) {
+				loff_t in = soff, out = doff;
+				ssize_t n = copy_file_range(sfd, &in, dfd, &out, len, 0);
+				if (n > 0) {
+					soff += n;
+					doff += n;
+					len -= n;
+					continue;
+				}
+				if (n == 0)
+					return ENODATA;
+				if (errno == EINTR)
+					continue;
+				if (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+					errno == EOPNOTSUPP) {
+					allow_cfr = false;
+					continue;
+				}
+				return errno;
+			}
+			if (!buf)
+				buf = std::make_unique<char[]>(bsize);
+			ssize_t r = pread(sfd, buf.get(), std::min(len, bsize), soff);
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			if (r == 0)
+				return ENODATA;
+			ssize_t done = 0;
+			while (done < r) {
+				ssize_t w = pwrite(dfd, buf.get() + done, r - done, doff + done);
+				if (w < 0) {
+					if (errno == EINTR)
+						continue;
+					return errno;
+				}
+				done += w;
+			}
+			soff += r;
+			doff += r;
+			len -= r;
+		}
+		return 0;
+	}
+
+	/*! \brief copy one source into its destination region. */
+	inline static int copy_source(const join_source& js, int dfd, bool allow_cfr)
+	{
+		int sfd = open(js.path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (sfd == -1)
+			return errno;
+		int err = copy_region(sfd, 0, dfd, js.offset, js.size, allow_cfr);
+		close(sfd);
+		return err;
+	}
+
+	/*! \brief join all regular files matching pattern into dest, in parallel.
+	 * Inputs are ordered by rank, then application, then path, using the
+	 * app.Rrank.XXXXXX multifile naming. Destination offsets are computed
+	 * from the input sizes, the destination is sized once, and up to
+	 * threads workers copy inputs into their disjoint regions.
+	 * Inputs that fail are retried once with pread/pwrite; inputs that still
+	 * fail are listed in unmerged and the following content is moved down
+	 * over their regions, so dest holds exactly the merged inputs in order.
 	 * No checking of input format correctness is performed.
-	 * Ignores directory names.
 	 * \param dest file to write merge result.
 	 * \param pattern glob pattern to match possible input files.
 	 * \param perm permissions on dest file, subject to umask.
-	 * \param merged list of files added
-	 * \param unmerged list of files found but not added due to some error. 
-	 *        If this list is not empty, the output file should be abandoned,
-	 *        as it may contain a partially copied file.
-	 * \return 0 and updated merged list or errno and file and merged vector content undefined.
+	 * \param threads number of copy threads; 0 uses the hardware concurrency.
+	 * \param merged list of files added, in output order.
+	 * \param unmerged list of files found but not added due to some error.
+	 * \param debug if nonzero, report progress to std::cerr.
+	 * \return 0 or errno if dest could not be written consistently.
 	 */
-	inline static int glob_sendfile_join(const char *dest, const char *pattern, 
-			int perm, std::vector<std::string>& merged, std::vector<std::string>& unmerged)
+	inline static int glob_parallel_join(const char *dest, const char *pattern,
+			int perm, unsigned threads, std::vector<std::string>& merged,
+			std::vector<std::string>& unmerged, int debug)
 	{
 		glob_t files;
 		merged.clear();
@@ -532,88 +753,186 @@ public:
 			globfree(&files);
 			return 0;
 		}
-
-		int dest_fd = open(dest, O_WRONLY | O_CREAT |O_CLOEXEC | O_TRUNC , perm);
+		std::vector<join_source> src;
+		src.reserve(files.gl_pathc);
+		for (size_t i = 0; i < files.gl_pathc; i++) {
+			struct stat stat_buf;
+			if (stat(files.gl_pathv[i], &stat_buf) || !S_ISREG(stat_buf.st_mode))
+				continue;
+			join_source js;
+			js.path = files.gl_pathv[i];
+			if (record_index::is_index_path(js.path))
+				continue;
+			parse_app_rank(js.path, js.app, js.rank);
+			js.size = stat_buf.st_size;
+			js.offset = 0;
+			js.err = 0;
+			src.push_back(js);
+		}
+		globfree(&files);
+		std::sort(src.begin(), src.end(), [](const join_source& a, const join_source& b) {
+			if (a.rank != b.rank)
+				return a.rank < b.rank;
+			if (a.app != b.app)
+				return a.app < b.app;
+			return a.path < b.path;
+		});
+		off_t total = 0;
+		for (auto& js : src) {
+			js.offset = total;
+			total += js.size;
+		}
+
+		int dest_fd = open(dest, O_RDWR | O_CREAT | O_CLOEXEC | O_TRUNC, perm);
 		if (dest_fd == -1) {
-			globfree(&files);
 			return errno;
 		}
+		if (ftruncate(dest_fd, total)) {
+			err = errno;
+			close(dest_fd);
+			return err;
+		}
 
-		for (size_t i = 0; i < files.gl_pathc; i++) {
-			int src_fd = open(files.gl_pathv[i], O_RDONLY);
-			if (src_fd == -1) continue;
-
-			err = 0;
-			struct stat stat_buf;
-			if (fstat(src_fd, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode)) {
-				off_t offset = 0;
-				size_t remaining = stat_buf.st_size;
-
-				// Loop until the entire file is transferred
-				while (remaining > 0) {
-					ssize_t sent = sendfile(dest_fd, src_fd, &offset, remaining);
-
-					if (sent <= 0) {
-						// Handle errors or unexpected EOF
-						if (sent == -1 && errno == EINTR) continue; // Interrupted by signal, retry
-						err = errno;
-						break;
-					}
-					remaining -= sent;
-				}
-				if (!err) {
-					merged.push_back(files.gl_pathv[i]);
-				} else {
-					unmerged.push_back(files.gl_pathv[i]);
-				}
+		if (!threads)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min<size_t>(threads, std::max<size_t>(1, src.size()));
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			size_t i;
+			while ((i = next.fetch_add(1)) < src.size()) {
+				src[i].err = copy_source(src[i], dest_fd, true);
 			}
-			close(src_fd);
+		};
+		if (threads > 1) {
+			std::vector<std::thread> pool;
+			for (unsigned t = 0; t < threads; t++)
+				pool.emplace_back(worker);
+			for (auto& t : pool)
+				t.join();
+		} else {
+			worker();
 		}
 
-		close(dest_fd);
-		globfree(&files);
-		if (unmerged.size() != 0) {
-			return EINVAL;
+		// retry failures, then close the gaps left by inputs that still fail.
+		bool gaps = false;
+		for (auto& js : src) {
+			if (js.err) {
+				if (debug) {
+					std::cerr << __FILE__ << ": retrying " << js.path << ": "
+						<< std::strerror(js.err) << std::endl;
+				}
+				js.err = copy_source(js, dest_fd, false);
+				if (js.err)
+					gaps = true;
+			}
 		}
-
-		return 0;
+		off_t out = 0;
+		err = 0;
+		for (auto& js : src) {
+			if (js.err) {
+				unmerged.push_back(js.path);
+				continue;
+			}
+			if (gaps && out != js.offset) {
+				err = copy_region(dest_fd, js.offset, dest_fd, out, js.size, false);
+				if (err)
+					break;
+			}
+			merged.push_back(js.path);
+			out += js.size;
+		}
+		if (!err && gaps && ftruncate(dest_fd, out))
+			err = errno;
+		if (close(dest_fd) && !err)
+			err = errno;
+		if (err)
+			merged.clear();
+		return err;
 	}
 
-	inline static std::vector<size_t> validate_multifile_log(string_view /*filename*/, bool /*check_json*/, size_t & record_count)
+	/*! \brief check framing and optionally json of every record in filename.
+	 * The file is mapped and searched for tags in parallel chunks; with
+	 * check_json the record texts are parsed in parallel.
+	 * \param threads 0 uses the hardware concurrency.
+	 * \return start positions of invalid records, in increasing order, or
+	 * the single position std::string::npos if the file cannot be read.
+	 */
+	inline static std::vector<size_t> validate_multifile_log(string_view filename,
+		bool check_json, size_t & record_count, unsigned threads = 0)
 	{
 		std::vector<size_t> v;
 		record_count = 0;
-		//fixme validate_multifile_log
-		// open file
-		// state=closed
-		// curpos = 0
-		// begin = 0
-		// while( next = find_next_regex <[/]adct-json>, curpos ) != end
-			// if next[1] == 'a': # found start tag
-			// 	if state == closed
-			// 		state = opened
-			// 		begin = curpos
-			// 		curpos = after(next)
-			// 	else # broken missing tail
-			// 		state = closed
-			// 		v.push_back(begin)
-			// 		curpos = next
-			// else # found end tag
-			//      if state == opened
-			//      	state = closed
-			//      	record_count++
-			//      	if check_json
-			//      		parse check (after(begin), curpos-1)
-			//      	curpos=after(next)
-			//     	else # broken missing head
-			//     		v.push_back(begin)
-			//      	curpos=after(next)
-		// if state != closed
-		// 	extra at end of file.
-		// 	v.push_back(begin)
-		// else
-		//	 if !eof
-		//	 	trailing junk error
+		int fd = open(string(filename).c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1) {
+			v.push_back(string::npos);
+			return v;
+		}
+		struct stat sb;
+		if (fstat(fd, &sb)) {
+			close(fd);
+			v.push_back(string::npos);
+			return v;
+		}
+		size_t len = sb.st_size;
+		if (!len) {
+			close(fd);
+			return v;
+		}
+		void *m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (m == MAP_FAILED) {
+			v.push_back(string::npos);
+			return v;
+		}
+		madvise(m, len, MADV_SEQUENTIAL);
+		const char *base = static_cast<const char *>(m);
+		if (!threads)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		std::vector<record_scan::tag> tags;
+		std::vector<record_scan::span> records;
+		record_scan::find_tags(base, len, threads, tags);
+		record_scan::pair_tags(base, len, tags, records, v);
+		record_count = records.size();
+
+		if (check_json && records.size()) {
+			const size_t batch = 256;
+			std::atomic<size_t> next(0);
+			std::vector< std::vector<size_t> > bad(threads);
+			auto worker = [&](unsigned t) {
+				boost::json::parser jp;
+				size_t i;
+				while ((i = next.fetch_add(batch)) < records.size()) {
+					size_t e = std::min(records.size(), i + batch);
+					for (; i < e; i++) {
+						const auto& r = records[i];
+						boost::json::error_code ec;
+						jp.reset();
+						jp.write(base + r.payload(), r.payload_len(), ec);
+						if (!ec)
+							jp.finish(ec);
+						if (ec)
+							bad[t].push_back(r.begin);
+					}
+				}
+			};
+			unsigned nt = std::min<size_t>(threads, (records.size() + batch - 1) / batch);
+			if (nt > 1) {
+				std::vector<std::thread> pool;
+				for (unsigned t = 0; t < nt; t++)
+					pool.emplace_back(worker, t);
+				for (auto& t : pool)
+					t.join();
+			} else {
+				worker(0);
+			}
+			for (auto& b : bad) {
+				record_count -= b.size();
+				v.insert(v.end(), b.begin(), b.end());
+			}
+			std::sort(v.begin(), v.end());
+		}
+		munmap(m, len);
 		return v;
 	}
 };
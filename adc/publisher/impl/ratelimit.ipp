@@ -0,0 +1,360 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/inner_options.ipp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace adc {
+
+using std::cout;
+
+typedef std::string string;
+typedef std::string_view string_view;
+
+
+/*! \brief Rate-limiting and sampling publisher_api decorator.
+  This plugin passes messages on to the publisher named by PUBLISHER
+  (default "file") and suppresses those over budget, so that publish()
+  called in an inner loop has a bounded cost downstream. Each application
+  (the /header/application value) is limited separately:
+  - 1 in SAMPLE_EVERY (default 1: all) messages are kept, deterministically;
+  - of those, each is kept with probability SAMPLE_PROBABILITY (default 1);
+  - of those, a token bucket of BURST (default 100) tokens refilled at
+    RATE (default 10; 0 disables the limit) per second passes a message
+    per token.
+  A message with a top-level section named in the colon-separated ALLOW
+  (default "exit_data") always passes.
+
+  Every SUMMARY_SECONDS (default 60; 0 disables), if anything was
+  suppressed, a summary message (application "adc_ratelimit") is
+  published with the counts per application since the previous summary.
+  A final summary is published at finalize.
+
+  Options PUBLISHER_$X (or env("ADC_RATELIMIT_PLUGIN_PUBLISHER_$X")) are
+  passed to the decorated publisher as option $X; the decorated publisher
+  otherwise uses its own env settings.
+  A rate-limited message yields EAGAIN from publish; a sampled-out
+  message yields 0.
+  Options are overridden with env("ADC_RATELIMIT_PLUGIN_$OPTION").
+ */
+class ratelimit_plugin : public publisher_api {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+public:
+	/// \brief creates the decorated publisher by name, or returns an empty pointer.
+	typedef std::function< std::shared_ptr< publisher_api >(const string&) > publisher_maker;
+	/// \brief creates the builder for summary messages.
+	typedef std::function< std::shared_ptr< builder_api >() > builder_maker;
+
+	/// \brief default decorated publisher.
+	/// Overridden with env("ADC_RATELIMIT_PLUGIN_PUBLISHER").
+	inline static const char *adc_ratelimit_plugin_publisher_default = "file";
+
+	/// \brief ADC ratelimit plugin enable debug messages; (default "0": none)
+	/// Overridden with env("ADC_RATELIMIT_PLUGIN_DEBUG").
+	inline static const char *adc_ratelimit_plugin_debug_default = "0";
+
+private:
+	inline static const char *plugin_prefix = "ADC_RATELIMIT_PLUGIN_";
+	inline static const std::map< const string, const string > plugin_config_defaults =
+	{	{"PUBLISHER", adc_ratelimit_plugin_publisher_default},
+		{"RATE", "10"},
+		{"BURST", "100"},
+		{"SAMPLE_EVERY", "1"},
+		{"SAMPLE_PROBABILITY", "1"},
+		{"ALLOW", "exit_data"},
+		{"SUMMARY_SECONDS", "60"},
+		{"DEBUG", adc_ratelimit_plugin_debug_default}
+	};
+
+	typedef std::chrono::steady_clock clock;
+
+	struct app_state {
+		double tokens;
+		clock::time_point last;
+		uint64_t seen;		// messages subject to sampling
+		uint64_t passed;	// since the last summary
+		uint64_t sampled_out;
+		uint64_t limited;
+	};
+
+	const string vers;
+	const std::vector<string> tags;
+	publisher_maker make_publisher;
+	builder_maker make_builder;
+	std::shared_ptr< publisher_api > inner;
+	string inner_name;
+	double rate;
+	double burst;
+	uint64_t sample_every;
+	double sample_probability;
+	std::set< string > allow;
+	long summary_seconds;
+	std::unordered_map< string, app_state > apps;
+	clock::time_point last_summary;
+	uint64_t suppressed;	// since the last summary
+	std::mt19937_64 rng;
+	std::uniform_real_distribution<double> uniform;
+	int debug;
+	enum state state;
+	bool paused;
+	enum mode mode;
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	// true if b has a top-level section or field named in allow.
+	bool allowed(std::shared_ptr<builder_api>& b) {
+		if (allow.empty())
+			return false;
+		for (const auto& n : b->get_field_names())
+			if (allow.count(n))
+				return true;
+		for (const auto& n : b->get_section_names())
+			if (allow.count(n))
+				return true;
+		return false;
+	}
+
+	// true if the next message of application a is within budget.
+	bool admit(app_state& a, clock::time_point now, bool& limited) {
+		limited = false;
+		a.seen++;
+		if (sample_every > 1 && (a.seen - 1) % sample_every) {
+			a.sampled_out++;
+			return false;
+		}
+		if (sample_probability < 1 && uniform(rng) >= sample_probability) {
+			a.sampled_out++;
+			return false;
+		}
+		if (rate > 0) {
+			double dt = std::chrono::duration<double>(now - a.last).count();
+			a.last = now;
+			a.tokens = std::min(burst, a.tokens + dt * rate);
+			if (a.tokens < 1) {
+				a.limited++;
+				limited = true;
+				return false;
+			}
+			a.tokens -= 1;
+		}
+		return true;
+	}
+
+	// publish the counts since the last summary, if anything was suppressed.
+	void summarize(clock::time_point now) {
+		double interval = std::chrono::duration<double>(now - last_summary).count();
+		last_summary = now;
+		if (!suppressed) {
+			for (auto& a : apps)
+				a.second.passed = 0;
+			return;
+		}
+		auto msg = make_builder();
+		msg->add_header_section("adc_ratelimit");
+		auto app_data = make_builder();
+		app_data->add("publisher", inner_name);
+		app_data->add("interval_seconds", interval);
+		app_data->add("suppressed", suppressed);
+		auto per_app = make_builder();
+		for (auto& a : apps) {
+			app_state& s = a.second;
+			if (!(s.passed || s.sampled_out || s.limited))
+				continue;
+			auto counts = make_builder();
+			counts->add("passed", s.passed);
+			counts->add("sampled_out", s.sampled_out);
+			counts->add("rate_limited", s.limited);
+			per_app->add_section(a.first, counts);
+			s.passed = s.sampled_out = s.limited = 0;
+		}
+		app_data->add_section("applications", per_app);
+		msg->add_app_data_section(app_data);
+		suppressed = 0;
+		int e = inner->publish(msg);
+		if (e && debug) {
+			std::cout << "ratelimit plugin: summary publish failed: " << e << std::endl;
+		}
+	}
+
+public:
+	ratelimit_plugin(publisher_maker make_publisher, builder_maker make_builder) :
+		vers("1.0.0") , tags({"none"}), make_publisher(make_publisher),
+		make_builder(make_builder), rate(10), burst(100), sample_every(1),
+		sample_probability(1), summary_seconds(60), suppressed(0),
+		rng(std::random_device{}()), uniform(0.0, 1.0), debug(0),
+		state(ok), paused(false), mode(pi_config) { }
+
+        int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		auto now = clock::now();
+		const char *app = b->get_value_string("/header/application");
+		auto it = apps.find(app ? app : "");
+		if (it == apps.end()) {
+			app_state fresh = { burst, now, 0, 0, 0, 0 };
+			it = apps.emplace(app ? app : "", fresh).first;
+		}
+		int err = 0;
+		bool limited = false;
+		if (allowed(b) || admit(it->second, now, limited)) {
+			it->second.passed++;
+			err = inner->publish(b);
+		} else {
+			suppressed++;
+			if (limited)
+				err = EAGAIN;
+		}
+		if (summary_seconds > 0 && now - last_summary >= std::chrono::seconds(summary_seconds))
+			summarize(now);
+		return err;
+	}
+
+        int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_prefix);
+	}
+
+        int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
+		inner_name = get(m, "PUBLISHER", env_prefix);
+		std::stringstream rs(get(m, "RATE", env_prefix));
+		std::stringstream bs(get(m, "BURST", env_prefix));
+		std::stringstream es(get(m, "SAMPLE_EVERY", env_prefix));
+		std::stringstream ps(get(m, "SAMPLE_PROBABILITY", env_prefix));
+		std::stringstream ss(get(m, "SUMMARY_SECONDS", env_prefix));
+		std::stringstream ds(get(m, "DEBUG", env_prefix));
+		rs >> rate;
+		bs >> burst;
+		es >> sample_every;
+		ps >> sample_probability;
+		ss >> summary_seconds;
+		ds >> debug;
+		if (rs.fail() || bs.fail() || es.fail() || ps.fail() || ss.fail() ||
+			rate < 0 || burst < 1 || sample_every < 1 ||
+			sample_probability <= 0 || sample_probability > 1)
+			return EINVAL;
+		if (debug < 0)
+			debug = 0;
+		allow.clear();
+		std::stringstream as(get(m, "ALLOW", env_prefix));
+		string section;
+		while (std::getline(as, section, ':'))
+			if (section.size())
+				allow.insert(section);
+		if (inner_name == name())
+			return EINVAL;
+		inner = make_publisher(inner_name);
+		if (!inner) {
+			std::cout << "ratelimit plugin: no publisher named " << inner_name << std::endl;
+			return EINVAL;
+		}
+		int e = inner->config(inner_options(m, env_prefix, *inner));
+		if (e) {
+			inner.reset();
+			return e;
+		}
+		mode = pi_init;
+		return 0;
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		if (!inner_name.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		int e = inner->initialize();
+		if (e) {
+			state = err;
+			return e;
+		}
+		last_summary = clock::now();
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+        void finalize() {
+		if (mode == pi_pub_or_final) {
+			if (state == ok)
+				summarize(clock::now());
+			inner->finalize();
+			apps.clear();
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "ratelimit plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+        void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "ratelimit";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~ratelimit_plugin() { }
+};
+
+} // adc
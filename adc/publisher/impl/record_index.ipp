@@ -0,0 +1,543 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_record_index_ipp
+#define adc_record_index_ipp
+#include <adc/publisher/impl/record_writer.ipp>
+#include <adc/publisher/impl/record_scan.ipp>
+#include <adc/reader/impl/field_scan.ipp>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace adc {
+
+/*! \brief Sidecar index of the records in an \<adct-json> framed log.
+  The index of LOG is the file LOG.idx:
+  - a 32 byte header (magic "ADCTIDX", version, flags, entry count,
+    uuid table offset),
+  - 40 byte entries: record offset and length in LOG (both tags included),
+    header timestamp in ns, 64-bit FNV-1a hash of the header uuid,
+    32-bit FNV-1a hash of the header application name, and flags,
+  - when sealed, a table of (uuid hash, entry number) pairs sorted by hash.
+
+  Writers append entries in publication order while running and seal the
+  index when closed: entries are then sorted by timestamp and the uuid table
+  is added, so time range and uuid lookups are binary searches. An unsealed
+  index (left by a crash) is still usable with linear searches of the
+  entries, and any log may be (re)indexed with build().
+
+  All integers are in host byte order.
+ */
+class record_index {
+public:
+	enum header_flags : uint32_t {
+		sealed = 1  //!< entries sorted by time; uuid table present.
+	};
+
+	enum entry_flags : uint32_t {
+		no_header = 1  //!< header timestamp/uuid/application not found.
+	};
+
+	struct file_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		uint64_t count;
+		uint64_t uuid_off;
+	};
+
+	struct entry {
+		uint64_t offset;
+		uint64_t length;
+		uint64_t timestamp_ns;
+		uint64_t uuid_hash;
+		uint32_t app_id;
+		uint32_t flags;
+	};
+
+	struct uuid_slot {
+		uint64_t hash;
+		uint64_t entry;
+	};
+
+	static_assert(sizeof(file_header) == 32, "index header layout");
+	static_assert(sizeof(entry) == 40, "index entry layout");
+	static_assert(sizeof(uuid_slot) == 16, "index uuid slot layout");
+
+	inline static const char magic[8] = { 'A', 'D', 'C', 'T', 'I', 'D', 'X', '\0' };
+
+	/// \return the index path for log_path.
+	static std::string index_path(const std::string& log_path) {
+		return log_path + ".idx";
+	}
+
+	/// \return true if p names an index or an index being written.
+	static bool is_index_path(std::string_view p) {
+		auto ends = [p](std::string_view x) {
+			return p.size() >= x.size() && p.substr(p.size() - x.size()) == x;
+		};
+		return ends(".idx") || ends(".idx.tmp");
+	}
+
+	static uint64_t fnv1a64(std::string_view s) {
+		uint64_t h = 14695981039346656037ULL;
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	static uint32_t fnv1a32(std::string_view s) {
+		uint32_t h = 2166136261U;
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	/*! \brief find the header timestamp, uuid and application in a record's json.
+	 * Only direct members of the top-level "header" object are examined.
+	 * \return true if all three were found.
+	 */
+	static bool header_fields(std::string_view j, uint64_t& timestamp_ns,
+		std::string_view& uuid, std::string_view& application) {
+		field_scan::field f[3];
+		field_scan::request(f[0], "header", "timestamp");
+		field_scan::request(f[1], "header", "uuid");
+		field_scan::request(f[2], "header", "application");
+		field_scan::scan(j, f, 3);
+		if (!f[0].found || !f[1].found || !f[2].found)
+			return false;
+		timestamp_ns = field_scan::seconds_to_ns(f[0].value);
+		uuid = f[1].value;
+		application = f[2].value;
+		return true;
+	}
+
+	/// \return the entry for a record at offset of length bytes with the given json.
+	static entry make_entry(uint64_t offset, uint64_t length, std::string_view json) {
+		entry e = { offset, length, 0, 0, 0, 0 };
+		std::string_view uuid, app;
+		if (header_fields(json, e.timestamp_ns, uuid, app)) {
+			e.uuid_hash = fnv1a64(uuid);
+			e.app_id = fnv1a32(app);
+		} else {
+			e.flags |= no_header;
+		}
+		return e;
+	}
+
+	/*! \brief write a sealed index of entries to idx_path.
+	 * The file is written beside idx_path and renamed into place.
+	 * entries are sorted by timestamp as a side effect.
+	 * \return 0 or errno.
+	 */
+	static int write_sealed(const std::string& idx_path, std::vector<entry>& entries) {
+		std::stable_sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+			return a.timestamp_ns < b.timestamp_ns;
+		});
+		std::vector<uuid_slot> slots(entries.size());
+		for (size_t i = 0; i < entries.size(); i++)
+			slots[i] = { entries[i].uuid_hash, i };
+		std::sort(slots.begin(), slots.end(), [](const uuid_slot& a, const uuid_slot& b) {
+			return a.hash < b.hash || (a.hash == b.hash && a.entry < b.entry);
+		});
+		file_header h;
+		memcpy(h.magic, magic, sizeof(magic));
+		h.version = 1;
+		h.flags = sealed;
+		h.count = entries.size();
+		h.uuid_off = sizeof(h) + entries.size() * sizeof(entry);
+
+		std::string tmp = idx_path + ".tmp";
+		record_writer w;
+		w.configure(record_writer::buffer_size_default, "finalize",
+			record_writer::flush_count_default, record_writer::flush_ms_default, "0");
+		int err = w.open(tmp, false);
+		if (err)
+			return err;
+		err = w.write_record(std::string_view(reinterpret_cast<char *>(&h), sizeof(h)),
+			std::string_view(reinterpret_cast<char *>(entries.data()),
+				entries.size() * sizeof(entry)),
+			std::string_view(reinterpret_cast<char *>(slots.data()),
+				slots.size() * sizeof(uuid_slot)));
+		int cerr = w.close();
+		if (!err)
+			err = cerr;
+		if (!err && rename(tmp.c_str(), idx_path.c_str()))
+			err = errno;
+		if (err)
+			unlink(tmp.c_str());
+		return err;
+	}
+
+	/*! \brief read the entries of an index, sealed or not.
+	 * Entries that do not lie within log_size bytes are rejected.
+	 * \return 0, errno, or EINVAL if the index is malformed or does not fit the log.
+	 */
+	static int load(const std::string& idx_path, uint64_t log_size, std::vector<entry>& entries) {
+		entries.clear();
+		int fd = open(idx_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return errno;
+		struct stat sb;
+		file_header h;
+		int err = 0;
+		if (fstat(fd, &sb)) {
+			err = errno;
+		} else if ((size_t)sb.st_size < sizeof(h) ||
+			pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+			memcmp(h.magic, magic, sizeof(magic)) || h.version != 1) {
+			err = EINVAL;
+		} else {
+			// divide rather than multiply so a corrupt count cannot overflow.
+			uint64_t n = (h.flags & sealed) ? h.count :
+				(sb.st_size - sizeof(h)) / sizeof(entry);
+			if (n > (sb.st_size - sizeof(h)) / sizeof(entry)) {
+				err = EINVAL;
+			} else {
+				entries.resize(n);
+				size_t want = n * sizeof(entry);
+				size_t got = 0;
+				while (got < want) {
+					ssize_t r = pread(fd, reinterpret_cast<char *>(entries.data()) + got,
+						want - got, sizeof(h) + got);
+					if (r <= 0) {
+						err = r < 0 ? errno : EINVAL;
+						break;
+					}
+					got += r;
+				}
+			}
+		}
+		close(fd);
+		for (const auto& e : entries) {
+			if (err || e.offset > log_size || e.length > log_size - e.offset) {
+				entries.clear();
+				return err ? err : EINVAL;
+			}
+		}
+		return err;
+	}
+
+	/*! \brief scan log content and append an entry per well-formed record.
+	 * \param base log image.
+	 * \param len log size.
+	 * \param shift added to each entry offset.
+	 */
+	static void scan(const char *base, size_t len, uint64_t shift, unsigned threads,
+		std::vector<entry>& entries) {
+		std::vector<record_scan::tag> tags;
+		std::vector<record_scan::span> records;
+		std::vector<size_t> invalid;
+		record_scan::find_tags(base, len, threads, tags);
+		record_scan::pair_tags(base, len, tags, records, invalid);
+		entries.reserve(entries.size() + records.size());
+		for (const auto& r : records) {
+			std::string_view json(base + r.payload(), r.payload_len());
+			entries.push_back(make_entry(shift + r.begin, r.end - r.begin, json));
+		}
+	}
+
+	/*! \brief scan a log file, appending entries as scan() does.
+	 * \return 0 or errno.
+	 */
+	static int scan_file(const std::string& log_path, uint64_t shift, unsigned threads,
+		std::vector<entry>& entries) {
+		int fd = open(log_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return errno;
+		struct stat sb;
+		if (fstat(fd, &sb)) {
+			int err = errno;
+			close(fd);
+			return err;
+		}
+		if (!sb.st_size) {
+			close(fd);
+			return 0;
+		}
+		void *m = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (m == MAP_FAILED)
+			return errno;
+		madvise(m, sb.st_size, MADV_SEQUENTIAL);
+		scan(static_cast<const char *>(m), sb.st_size, shift, threads, entries);
+		munmap(m, sb.st_size);
+		return 0;
+	}
+
+	/// \brief (re)build the sealed index of log_path. \return 0 or errno.
+	static int build(const std::string& log_path, unsigned threads) {
+		std::vector<entry> entries;
+		int err = scan_file(log_path, 0, threads, entries);
+		if (err)
+			return err;
+		return write_sealed(index_path(log_path), entries);
+	}
+};
+
+/*! \brief Append-only index writer used beside a record_writer.
+  Entries are written through a record_writer with the log's buffering
+  options; close() seals the index.
+ */
+class index_writer {
+	std::string path;
+	record_writer out;
+
+public:
+	index_writer() { }
+
+	index_writer(const index_writer&) = delete;
+	index_writer& operator=(const index_writer&) = delete;
+
+	~index_writer() {
+		close();
+	}
+
+	/// \brief set buffering as record_writer::configure.
+	int configure(const std::string& sbuffer, const std::string& sflush,
+			const std::string& scount, const std::string& sms, const std::string& ssync) {
+		return out.configure(sbuffer, sflush, scount, sms, ssync);
+	}
+
+	/*! \brief start the index of log_path.
+	 * If the log already has content (append mode), entries for it are
+	 * taken from its existing index or, failing that, from a scan of the log.
+	 * \return 0 or errno.
+	 */
+	int open(const std::string& log_path) {
+		close();
+		path = record_index::index_path(log_path);
+		std::vector<record_index::entry> entries;
+		struct stat sb;
+		if (!stat(log_path.c_str(), &sb) && sb.st_size > 0) {
+			if (record_index::load(path, sb.st_size, entries)) {
+				entries.clear();
+				int err = record_index::scan_file(log_path, 0, 0, entries);
+				if (err)
+					return err;
+			}
+		}
+		int err = out.open(path, false);
+		if (err)
+			return err;
+		record_index::file_header h;
+		memcpy(h.magic, record_index::magic, sizeof(h.magic));
+		h.version = 1;
+		h.flags = 0;
+		h.count = 0;
+		h.uuid_off = 0;
+		return out.write_record(std::string_view(reinterpret_cast<char *>(&h), sizeof(h)),
+			std::string_view(reinterpret_cast<char *>(entries.data()),
+				entries.size() * sizeof(record_index::entry)), "");
+	}
+
+	/// \return true if open and no write error has occurred.
+	bool good() const {
+		return out.good();
+	}
+
+	/// \brief append the entry of the record framing json just written at offset in the log.
+	int add(uint64_t offset, std::string_view json) {
+		uint64_t length = record_scan::open_tag.size() + json.size() + record_scan::close_tag.size();
+		record_index::entry e = record_index::make_entry(offset, length, json);
+		return out.write_record(std::string_view(reinterpret_cast<char *>(&e), sizeof(e)), "", "");
+	}
+
+	/// \brief flush and seal the index. \return 0 or errno.
+	int close() {
+		if (!path.size())
+			return 0;
+		int err = out.close();
+		if (!err) {
+			std::vector<record_index::entry> entries;
+			err = record_index::load(path, UINT64_MAX, entries);
+			if (!err)
+				err = record_index::write_sealed(path, entries);
+		}
+		path.clear();
+		return err;
+	}
+};
+
+/*! \brief Lookups in a log through its sidecar index.
+  The log and index are mapped read-only while the reader is open.
+ */
+class index_reader {
+	const char *log;
+	size_t log_len;
+	const char *idx;
+	size_t idx_len;
+	const record_index::file_header *hdr;
+	const record_index::entry *entries;
+	uint64_t count;
+	const record_index::uuid_slot *slots;
+
+	void unmap() {
+		if (log)
+			munmap(const_cast<char *>(log), log_len);
+		if (idx)
+			munmap(const_cast<char *>(idx), idx_len);
+		log = idx = nullptr;
+		log_len = idx_len = 0;
+		entries = nullptr;
+		slots = nullptr;
+		count = 0;
+	}
+
+	// map all of p read-only. \return the image, or nullptr with errno set.
+	static const char *map_file(const std::string& p, size_t& len) {
+		int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return nullptr;
+		struct stat sb;
+		const char *r = nullptr;
+		if (!fstat(fd, &sb)) {
+			if (sb.st_size > 0) {
+				void *m = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (m != MAP_FAILED) {
+					len = sb.st_size;
+					r = static_cast<const char *>(m);
+				}
+			} else {
+				errno = EINVAL;
+			}
+		}
+		int e = errno;
+		::close(fd);
+		errno = e;
+		return r;
+	}
+
+	// \return the json text of e.
+	std::string_view json(const record_index::entry& e) const {
+		return std::string_view(log + e.offset + record_scan::open_tag.size(),
+			e.length - record_scan::open_tag.size() - record_scan::close_tag.size());
+	}
+
+	bool uuid_matches(const record_index::entry& e, std::string_view uuid) const {
+		uint64_t ts;
+		std::string_view u, a;
+		return record_index::header_fields(json(e), ts, u, a) && u == uuid;
+	}
+
+public:
+	index_reader() : log(nullptr), log_len(0), idx(nullptr), idx_len(0),
+		hdr(nullptr), entries(nullptr), count(0), slots(nullptr) { }
+
+	~index_reader() {
+		unmap();
+	}
+
+	index_reader(const index_reader&) = delete;
+	index_reader& operator=(const index_reader&) = delete;
+
+	/// \brief map log_path and its index. \return 0, errno, or EINVAL if the index is malformed.
+	int open(const std::string& log_path) {
+		unmap();
+		idx = map_file(record_index::index_path(log_path), idx_len);
+		if (!idx)
+			return errno ? errno : EINVAL;
+		log = map_file(log_path, log_len);
+		if (!log) {
+			int e = errno ? errno : EINVAL;
+			unmap();
+			return e;
+		}
+		hdr = reinterpret_cast<const record_index::file_header *>(idx);
+		if (idx_len < sizeof(*hdr) || memcmp(hdr->magic, record_index::magic,
+			sizeof(record_index::magic)) || hdr->version != 1) {
+			unmap();
+			return EINVAL;
+		}
+		entries = reinterpret_cast<const record_index::entry *>(idx + sizeof(*hdr));
+		if (hdr->flags & record_index::sealed) {
+			// divide rather than multiply so a corrupt count cannot overflow.
+			count = hdr->count;
+			if (hdr->uuid_off < sizeof(*hdr) || hdr->uuid_off > idx_len ||
+				hdr->uuid_off % alignof(record_index::uuid_slot) ||
+				count > (idx_len - hdr->uuid_off) / sizeof(record_index::uuid_slot) ||
+				count > (idx_len - sizeof(*hdr)) / sizeof(record_index::entry)) {
+				unmap();
+				return EINVAL;
+			}
+			slots = reinterpret_cast<const record_index::uuid_slot *>(idx + hdr->uuid_off);
+		} else {
+			count = (idx_len - sizeof(*hdr)) / sizeof(record_index::entry);
+		}
+		for (uint64_t i = 0; i < count; i++) {
+			if (entries[i].length > log_len ||
+				entries[i].offset > log_len - entries[i].length ||
+				entries[i].length < record_scan::open_tag.size() + record_scan::close_tag.size() ||
+				(slots && slots[i].entry >= count)) {
+				unmap();
+				return EINVAL;
+			}
+		}
+		return 0;
+	}
+
+	/// \return number of indexed records.
+	uint64_t size() const {
+		return count;
+	}
+
+	/// \brief append the json of records with the given header uuid to out.
+	void find_uuid(std::string_view uuid, std::vector<std::string_view>& out) const {
+		uint64_t h = record_index::fnv1a64(uuid);
+		if (slots) {
+			auto lo = std::lower_bound(slots, slots + count, h,
+				[](const record_index::uuid_slot& s, uint64_t v) { return s.hash < v; });
+			for (; lo != slots + count && lo->hash == h; ++lo) {
+				if (uuid_matches(entries[lo->entry], uuid))
+					out.push_back(json(entries[lo->entry]));
+			}
+			return;
+		}
+		for (uint64_t i = 0; i < count; i++) {
+			if (entries[i].uuid_hash == h && uuid_matches(entries[i], uuid))
+				out.push_back(json(entries[i]));
+		}
+	}
+
+	/// \brief append the json of records with begin_ns <= timestamp < end_ns to out, in time order.
+	void find_time(uint64_t begin_ns, uint64_t end_ns, std::vector<std::string_view>& out) const {
+		if (slots) {
+			auto lo = std::lower_bound(entries, entries + count, begin_ns,
+				[](const record_index::entry& e, uint64_t v) { return e.timestamp_ns < v; });
+			for (; lo != entries + count && lo->timestamp_ns < end_ns; ++lo) {
+				if (!(lo->flags & record_index::no_header))
+					out.push_back(json(*lo));
+			}
+			return;
+		}
+		std::vector<const record_index::entry *> hits;
+		for (uint64_t i = 0; i < count; i++) {
+			const auto& e = entries[i];
+			if (!(e.flags & record_index::no_header) &&
+				e.timestamp_ns >= begin_ns && e.timestamp_ns < end_ns)
+				hits.push_back(&e);
+		}
+		std::stable_sort(hits.begin(), hits.end(), [](auto a, auto b) {
+			return a->timestamp_ns < b->timestamp_ns;
+		});
+		for (auto e : hits)
+			out.push_back(json(*e));
+	}
+};
+
+} // adc
+#endif // adc_record_index_ipp
@@ -0,0 +1,228 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_record_scan_ipp
+#define adc_record_scan_ipp
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ADC_RECORD_SCAN_X86 1
+#endif
+
+namespace adc {
+
+/*! \brief Locate \<adct-json>\</adct-json> framed records in a memory image.
+  Tag candidates are found by a vectorized search for '<' (AVX2 when the
+  cpu supports it, otherwise SSE2 on x86, otherwise scalar) and confirmed
+  with memcmp; record content is not examined. Large images are split into
+  chunks searched by separate threads, and the tags are then paired in one
+  sequential pass.
+ */
+class record_scan {
+public:
+	inline static constexpr std::string_view open_tag = "<adct-json>";
+	inline static constexpr std::string_view close_tag = "</adct-json>";
+
+	/// \brief a tag found at pos.
+	struct tag {
+		size_t pos;
+		bool open;
+	};
+
+	/// \brief a well-formed record: [begin, end) includes both tags.
+	struct span {
+		size_t begin;
+		size_t end;
+		/// \return offset of the json text.
+		size_t payload() const { return begin + open_tag.size(); }
+		/// \return length of the json text.
+		size_t payload_len() const { return end - close_tag.size() - payload(); }
+	};
+
+private:
+	static const char *find_lt_scalar(const char *p, const char *e) {
+		const void *q = memchr(p, '<', e - p);
+		return q ? static_cast<const char *>(q) : e;
+	}
+
+#ifdef ADC_RECORD_SCAN_X86
+	__attribute__((target("sse2")))
+	static const char *find_lt_sse2(const char *p, const char *e) {
+		const __m128i lt = _mm_set1_epi8('<');
+		while (e - p >= 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+			unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lt));
+			if (m)
+				return p + __builtin_ctz(m);
+			p += 16;
+		}
+		return find_lt_scalar(p, e);
+	}
+
+	__attribute__((target("avx2")))
+	static const char *find_lt_avx2(const char *p, const char *e) {
+		const __m256i lt = _mm256_set1_epi8('<');
+		while (e - p >= 64) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+			__m256i ma = _mm256_cmpeq_epi8(a, lt);
+			__m256i mb = _mm256_cmpeq_epi8(b, lt);
+			if (!_mm256_testz_si256(_mm256_or_si256(ma, mb), _mm256_or_si256(ma, mb))) {
+				unsigned m = _mm256_movemask_epi8(ma);
+				if (m)
+					return p + __builtin_ctz(m);
+				return p + 32 + __builtin_ctz((unsigned)_mm256_movemask_epi8(mb));
+			}
+			p += 64;
+		}
+		return find_lt_sse2(p, e);
+	}
+
+	static bool have_avx2() {
+		static const bool h = __builtin_cpu_supports("avx2");
+		return h;
+	}
+#endif
+
+public:
+	/// \return the first '<' in [p, e), or e.
+	static const char *find_lt(const char *p, const char *e) {
+#ifdef ADC_RECORD_SCAN_X86
+		if (have_avx2())
+			return find_lt_avx2(p, e);
+		return find_lt_sse2(p, e);
+#else
+		return find_lt_scalar(p, e);
+#endif
+	}
+
+	/*! \brief find the first tag starting in [from, to) of base[0,len).
+	 * A tag may extend past to, but not past len.
+	 * \return the tag position, or to if there is none.
+	 */
+	static size_t next_tag(const char *base, size_t len, size_t from, size_t to, bool& open) {
+		const char *p = base + from;
+		const char *e = base + to;
+		while (p < e) {
+			const char *q = find_lt(p, e);
+			if (q == e)
+				break;
+			size_t pos = q - base;
+			size_t left = len - pos;
+			if (left >= open_tag.size() && !memcmp(q, open_tag.data(), open_tag.size())) {
+				open = true;
+				return pos;
+			}
+			if (left >= close_tag.size() && !memcmp(q, close_tag.data(), close_tag.size())) {
+				open = false;
+				return pos;
+			}
+			p = q + 1;
+		}
+		return to;
+	}
+
+	/*! \brief append tags starting in [from, to) of base[0,len) to out, in order.
+	 * A tag may extend past to, but not past len.
+	 */
+	static void scan_tags(const char *base, size_t len, size_t from, size_t to,
+		std::vector<tag>& out) {
+		bool open = false;
+		size_t pos;
+		while ((pos = next_tag(base, len, from, to, open)) < to) {
+			out.push_back({pos, open});
+			from = pos + (open ? open_tag.size() : close_tag.size());
+		}
+	}
+
+	/*! \brief find all tags in base[0,len) using up to threads threads.
+	 * \param threads 0 uses the hardware concurrency.
+	 */
+	static void find_tags(const char *base, size_t len, unsigned threads,
+		std::vector<tag>& out) {
+		const size_t min_chunk = 4 << 20;
+		if (!threads)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		size_t nchunk = std::min<size_t>(threads, (len + min_chunk - 1) / min_chunk);
+		out.clear();
+		if (nchunk <= 1) {
+			scan_tags(base, len, 0, len, out);
+			return;
+		}
+		size_t csize = (len + nchunk - 1) / nchunk;
+		std::vector< std::vector<tag> > parts(nchunk);
+		std::vector<std::thread> pool;
+		for (size_t c = 0; c < nchunk; c++) {
+			pool.emplace_back([&, c]() {
+				size_t from = c * csize;
+				size_t to = std::min(len, from + csize);
+				parts[c].reserve(csize / 512);
+				scan_tags(base, len, from, to, parts[c]);
+			});
+		}
+		for (auto& t : pool)
+			t.join();
+		// tags contain '<' only at their start, so chunk results cannot overlap.
+		size_t total = 0;
+		for (auto& part : parts)
+			total += part.size();
+		out.reserve(total);
+		for (auto& part : parts)
+			out.insert(out.end(), part.begin(), part.end());
+	}
+
+	/*! \brief pair tags into records and note where invalid content starts.
+	 * Tags cannot be nested; an open tag seen while a record is open ends the
+	 * open record as invalid (missing close). A close tag with no open tag,
+	 * non-whitespace between records, and an unclosed record at the end are
+	 * also invalid. Positions in invalid are increasing.
+	 */
+	static void pair_tags(const char *base, size_t len, const std::vector<tag>& tags,
+		std::vector<span>& records, std::vector<size_t>& invalid) {
+		bool opened = false;
+		size_t begin = 0;
+		size_t cur = 0;
+		auto junk = [base](size_t from, size_t to) {
+			for (size_t i = from; i < to; i++) {
+				char c = base[i];
+				if (c != '\n' && c != ' ' && c != '\r' && c != '\t')
+					return true;
+			}
+			return false;
+		};
+		for (const auto& t : tags) {
+			if (t.open) {
+				if (opened) {
+					invalid.push_back(begin);
+				} else if (junk(cur, t.pos)) {
+					invalid.push_back(cur);
+				}
+				opened = true;
+				begin = t.pos;
+			} else {
+				size_t end = t.pos + close_tag.size();
+				if (opened) {
+					records.push_back({begin, end});
+					opened = false;
+				} else {
+					invalid.push_back(cur);
+				}
+				cur = end;
+			}
+		}
+		if (opened) {
+			invalid.push_back(begin);
+		} else if (junk(cur, len)) {
+			invalid.push_back(cur);
+		}
+	}
+};
+
+} // adc
+#endif // adc_record_scan_ipp
@@ -0,0 +1,298 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_record_writer_ipp
+#define adc_record_writer_ipp
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <memory>
+#include <chrono>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace adc {
+
+/*! \brief Buffered, policy-flushed writer of framed records to a file descriptor.
+  This is shared by the file-oriented publishers in place of std::ofstream,
+  which (with std::endl) costs a flush syscall per message.
+
+  Records are given as (prefix, payload, suffix) pieces. Small records are
+  copied into a private buffer; a record that does not fit in the buffer
+  space remaining (or any record under the "record" flush policy) is
+  written with a single writev of the pending buffer and the three pieces,
+  so large payloads are never copied.
+
+  Flush policies:
+  - "record": every record reaches the kernel before write_record returns.
+  - "count": pending records are written every FLUSH_COUNT records.
+  - "interval": pending records are written when FLUSH_MS milliseconds have
+    passed since the last flush. The check is made only in write_record;
+    there is no timer thread.
+  - "finalize": pending records are written only when the buffer fills or
+    the writer is closed.
+
+  If the sync cadence is N > 0, fdatasync is called after every N flushes
+  and at close.
+
+  A record_writer is not thread-safe.
+ */
+class record_writer {
+public:
+	enum flush_policy {
+		fp_record,
+		fp_count,
+		fp_interval,
+		fp_finalize
+	};
+
+	/// \brief default buffer size in bytes.
+	inline static const char *buffer_size_default = "65536";
+	/// \brief default flush policy name.
+	inline static const char *flush_default = "record";
+	/// \brief default records per flush for the "count" policy.
+	inline static const char *flush_count_default = "64";
+	/// \brief default milliseconds per flush for the "interval" policy.
+	inline static const char *flush_ms_default = "1000";
+	/// \brief default flushes per fdatasync; 0 disables fdatasync.
+	inline static const char *sync_default = "0";
+
+private:
+	int fd;
+	std::unique_ptr<char[]> buf;
+	size_t cap;
+	size_t used;
+	enum flush_policy policy;
+	size_t flush_count;
+	std::chrono::steady_clock::duration flush_interval;
+	size_t sync_every;
+	size_t pending;
+	size_t flushes_since_sync;
+	std::chrono::steady_clock::time_point last_flush;
+	uint64_t offset;
+	int err;
+
+	// write all iov content, resuming after partial writes and EINTR.
+	static int writev_all(int fd, struct iovec *iov, int iovcnt)
+	{
+		while (iovcnt > 0) {
+			ssize_t n = ::writev(fd, iov, iovcnt);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			size_t done = static_cast<size_t>(n);
+			while (iovcnt > 0 && done >= iov->iov_len) {
+				done -= iov->iov_len;
+				iov++;
+				iovcnt--;
+			}
+			if (iovcnt > 0) {
+				iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+				iov->iov_len -= done;
+			}
+		}
+		return 0;
+	}
+
+	int note_flush()
+	{
+		pending = 0;
+		if (policy == fp_interval)
+			last_flush = std::chrono::steady_clock::now();
+		if (sync_every) {
+			flushes_since_sync++;
+			if (flushes_since_sync >= sync_every) {
+				flushes_since_sync = 0;
+				if (fdatasync(fd) && errno != EINVAL) {
+					err = errno;
+					return err;
+				}
+			}
+		}
+		return 0;
+	}
+
+public:
+	record_writer() : fd(-1), cap(0), used(0), policy(fp_record), flush_count(64),
+		flush_interval(std::chrono::milliseconds(1000)), sync_every(0),
+		pending(0), flushes_since_sync(0), offset(0), err(0) { }
+
+	~record_writer() {
+		close();
+	}
+
+	record_writer(const record_writer&) = delete;
+	record_writer& operator=(const record_writer&) = delete;
+
+	/// \brief Set buffering and flush behavior from option strings.
+	/// Must be called before open or adopt to change the buffer size.
+	/// \return 0 or EINVAL if any value is unparseable.
+	int configure(const std::string& sbuffer, const std::string& sflush,
+			const std::string& scount, const std::string& sms, const std::string& ssync)
+	{
+		size_t bsize, count, ms, sync;
+		std::stringstream ssb(sbuffer), ssc(scount), ssm(sms), sss(ssync);
+		ssb >> bsize;
+		ssc >> count;
+		ssm >> ms;
+		sss >> sync;
+		if (ssb.fail() || ssc.fail() || ssm.fail() || sss.fail())
+			return EINVAL;
+		if (sflush == "record") {
+			policy = fp_record;
+		} else if (sflush == "count") {
+			policy = fp_count;
+		} else if (sflush == "interval") {
+			policy = fp_interval;
+		} else if (sflush == "finalize") {
+			policy = fp_finalize;
+		} else {
+			return EINVAL;
+		}
+		cap = bsize;
+		flush_count = count ? count : 1;
+		flush_interval = std::chrono::milliseconds(ms);
+		sync_every = sync;
+		return 0;
+	}
+
+	/// \brief Open (creating if needed) path for writing.
+	/// \return 0 or errno.
+	int open(const std::string& path, bool append, mode_t perm = 0644)
+	{
+		int ofd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC |
+			(append ? O_APPEND : O_TRUNC), perm);
+		if (ofd < 0)
+			return errno;
+		return adopt(ofd);
+	}
+
+	/// \brief Take ownership of an already open, writable descriptor.
+	int adopt(int ofd)
+	{
+		close();
+		fd = ofd;
+		err = 0;
+		used = 0;
+		pending = 0;
+		flushes_since_sync = 0;
+		last_flush = std::chrono::steady_clock::now();
+		off_t end = lseek(fd, 0, SEEK_END);
+		offset = end > 0 ? end : 0;
+		if (cap && policy != fp_record)
+			buf = std::make_unique<char[]>(cap);
+		else
+			buf.reset();
+		return 0;
+	}
+
+	/// \return true if open and no write error has occurred.
+	bool good() const {
+		return fd >= 0 && !err;
+	}
+
+	/// \return the file offset at which the next record will start.
+	uint64_t tell() const {
+		return offset;
+	}
+
+	/// \return the descriptor in use, or -1.
+	int get_fd() const {
+		return fd;
+	}
+
+	/// \brief Append one framed record, flushing as the policy requires.
+	/// \return 0 or the errno of a failed write or sync.
+	int write_record(std::string_view prefix, std::string_view payload, std::string_view suffix)
+	{
+		if (!good())
+			return err ? err : EBADF;
+		size_t rlen = prefix.size() + payload.size() + suffix.size();
+		if (buf && used + rlen <= cap) {
+			memcpy(buf.get() + used, prefix.data(), prefix.size());
+			used += prefix.size();
+			memcpy(buf.get() + used, payload.data(), payload.size());
+			used += payload.size();
+			memcpy(buf.get() + used, suffix.data(), suffix.size());
+			used += suffix.size();
+			offset += rlen;
+			pending++;
+			switch (policy) {
+			case fp_count:
+				if (pending >= flush_count)
+					return flush();
+				break;
+			case fp_interval:
+				if (std::chrono::steady_clock::now() - last_flush >= flush_interval)
+					return flush();
+				break;
+			default:
+				break;
+			}
+			return 0;
+		}
+		struct iovec iov[4];
+		int n = 0;
+		if (used) {
+			iov[n].iov_base = buf.get();
+			iov[n++].iov_len = used;
+		}
+		iov[n].iov_base = const_cast<char *>(prefix.data());
+		iov[n++].iov_len = prefix.size();
+		iov[n].iov_base = const_cast<char *>(payload.data());
+		iov[n++].iov_len = payload.size();
+		iov[n].iov_base = const_cast<char *>(suffix.data());
+		iov[n++].iov_len = suffix.size();
+		err = writev_all(fd, iov, n);
+		used = 0;
+		if (err)
+			return err;
+		offset += rlen;
+		return note_flush();
+	}
+
+	/// \brief Write any buffered records to the kernel.
+	int flush()
+	{
+		if (fd < 0)
+			return EBADF;
+		if (!used)
+			return err;
+		struct iovec iov = { buf.get(), used };
+		int e = writev_all(fd, &iov, 1);
+		used = 0;
+		if (e) {
+			err = e;
+			return err;
+		}
+		return note_flush();
+	}
+
+	/// \brief Flush, sync if a sync cadence is set, and close.
+	/// \return 0 or the first error seen.
+	int close()
+	{
+		if (fd < 0)
+			return 0;
+		int e = flush();
+		if (!e && sync_every && fdatasync(fd) && errno != EINVAL)
+			e = errno;
+		if (::close(fd) && !e)
+			e = errno;
+		fd = -1;
+		buf.reset();
+		used = 0;
+		return e;
+	}
+};
+
+} // adc
+#endif // adc_record_writer_ipp
@@ -4,11 +4,20 @@
  */
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/subprocess.ipp>
 #include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <deque>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 namespace adc {
 
@@ -20,10 +29,41 @@ typedef std::string_view string_view;
 
 /*! \brief User script publisher plugin. The program specified
   by environment variable is used to asynchronously deliver
-  published messages. It is invoked in a shell as:
-     ($prog $messagefile > /dev/null 2>&1 || /bin/rm $messagefile) &
+  published messages.
+
+  With MODE "spawn" (the default), it is started per message, without a
+  shell, as
+     $prog $messagefile > /dev/null 2>&1
+  where $prog is split into words at whitespace. With PAYLOAD "file" (the
+  default), or if memfd_create is unavailable, $messagefile is a scratch
+  file in DIRECTORY; the program should remove it, and it is removed for
+  the program if the program fails. With PAYLOAD "memfd", the message is
+  an anonymous in-memory file given as the program's stdin and
+  $messagefile is /proc/self/fd/0, which must not be removed.
+
+  With MODE "pipe", it is started once at initialize as
+     /bin/sh -c "exec $prog" > /dev/null 2>&1
+  and reads messages from its stdin until end of file. Stdin is one end of
+  a unix stream socket pair, so a child that exits cannot raise SIGPIPE in
+  the application. FORMAT selects the message framing:
+  - "ndjson" (default): each message is one line of json.
+  - "length": each message is its decimal byte length and a newline,
+    followed by the json bytes (e.g. read n; head -c $n in a shell).
+
+  Writes never block publish: messages the child is not ready to read are
+  queued, up to QUEUE_SIZE bytes (default 4 MiB); messages that do not fit
+  are dropped and publish returns EAGAIN. If the child exits, a message it
+  had partially read is dropped and the child is restarted, no sooner than
+  RESTART_MS (default 1000) after it was last started. At finalize the queue
+  is drained for up to TIMEOUT_MS (default 5000), stdin is closed, and the
+  child is waited for up to TIMEOUT_MS. A child still running then, or one
+  that stops reading, is sent SIGTERM and, if it has not exited a second
+  later, SIGKILL; it is reaped in the background either way.
+  In either mode the program runs on the AFFINITY cpus (default "all", or a
+  range list such as "0-1,56-57"), and is reaped asynchronously.
+  Options are overridden with env("ADC_SCRIPT_PLUGIN_$OPTION").
  */
-class script_plugin : public publisher_api {
+class script_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -44,7 +84,7 @@ public:
 	/// \brief The default path to a user script or program.
 	/// This program should be user accessible.
 	/// Overridden with env("ADC_SCRIPT_PLUGIN_PROG").
-	/// The default : is a non-operation.
+	/// The default : is a non-operation; messages are discarded.
 	static const inline char *adc_script_plugin_prog_default = ":";
 
 	/// \brief ADC script plugin enable debug messages; (default "0": none)
@@ -53,17 +93,45 @@ public:
 	/// Overridden with env("ADC_SCRIPT_PLUGIN_DEBUG").
 	inline static const char *adc_script_plugin_debug_default = "0";
 
+	/// \brief affinity for spawned processes; defaults to all
+	/// Overridden with env("ADC_SCRIPT_PLUGIN_AFFINITY").
+	inline static const char *adc_script_plugin_affinity_default = "all";
+
 private:
 	const std::map< const string, const string > plugin_script_config_defaults =
 	{	{"DIRECTORY", adc_script_plugin_dir_default},
 		{"DEBUG", adc_script_plugin_debug_default},
-		{"PROG", adc_script_plugin_prog_default}
+		{"PROG", adc_script_plugin_prog_default},
+		{"AFFINITY", adc_script_plugin_affinity_default},
+		{"PAYLOAD", "file"},
+		{"MODE", "spawn"},
+		{"FORMAT", "ndjson"},
+		{"QUEUE_SIZE", "4194304"},
+		{"RESTART_MS", "1000"},
+		{"TIMEOUT_MS", "5000"}
 	};
 	inline static const char *plugin_prefix = "ADC_SCRIPT_PLUGIN_";
+	// time a terminated child gets to exit before SIGKILL.
+	inline static const int kill_grace_ms = 1000;
 	const string vers;
 	const std::vector<string> tags;
 	string fdir;
 	string prog;
+	cpu_set_t affinity;
+	bool use_affinity;
+	bool use_memfd;
+	bool persistent;
+	bool length_format;
+	size_t queue_max;
+	long restart_ms;
+	long timeout_ms;
+	pid_t child;
+	int sock;
+	std::deque<string> pending;
+	size_t pending_bytes;
+	size_t front_sent;
+	uint64_t dropped;
+	std::chrono::steady_clock::time_point last_start;
 	int debug;
 	enum state state;
 	bool paused;
@@ -121,22 +189,183 @@ private:
 		return "";
 	}
 
-	// invoke script with json in f as arg 1, then delete f.
-	// wrap this in a thread to make it non-blocking eventually.
-	int script_send(string& f)
+	// start script with json in f as its last argument; f is deleted if it fails
+	// unless it names payload_fd, which becomes stdin.
+	int script_send(const string& f, int payload_fd)
 	{
-		string qcmd = "(" + prog + " " + f +
-			"> /dev/null 2>&1 || /bin/rm " + f + ") &";
-		int err2 = std::system(qcmd.c_str());
+		std::vector<string> argv = subprocess::split_words(prog);
+		argv.push_back(f);
+		subprocess::options o;
+		o.affinity = use_affinity ? &affinity : nullptr;
+		o.stdin_fd = payload_fd;
+		int err2 = subprocess::launch(argv, o, payload_fd < 0 ? f : "", false);
 		if (debug > 1) {
 			std::cout << "script plugin file: " << f << std::endl;
 			std::cout << "script plugin err: " << err2 << std::endl;
 		}
+		return err2;
+	}
+
+	// start prog with stdin on a new socket pair. \return 0 or errno.
+	int start_child() {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+			return errno;
+		subprocess::options o;
+		o.stdin_fd = sv[1];
+		o.affinity = use_affinity ? &affinity : nullptr;
+		pid_t pid;
+		int err = subprocess::spawn({ "/bin/sh", "-c", "exec " + prog }, o, pid);
+		close(sv[1]);
+		last_start = std::chrono::steady_clock::now();
+		if (err) {
+			close(sv[0]);
+			return err;
+		}
+		// the child only reads.
+		shutdown(sv[0], SHUT_RD);
+		sock = sv[0];
+		child = pid;
+		front_sent = 0;
+		if (debug) {
+			std::cout << "script plugin started pid " << pid << std::endl;
+		}
+		return 0;
+	}
+
+	// forget a child that stopped reading; its partial message is dropped.
+	void child_lost() {
+		close(sock);
+		sock = -1;
+		if (child > 0) {
+			int status;
+			if (waitpid(child, &status, WNOHANG) == 0)
+				child_reaper::instance().terminate(child, kill_grace_ms);
+			if (debug) {
+				std::cout << "script plugin child " << child << " lost" << std::endl;
+			}
+		}
+		child = -1;
+		if (front_sent) {
+			pending_bytes -= pending.front().size();
+			pending.pop_front();
+			dropped++;
+			front_sent = 0;
+		}
+	}
+
+	// send queued messages until the socket is full. \return 0, or EPIPE if the child was lost.
+	int drain() {
+		while (pending.size()) {
+			const string& f = pending.front();
+			ssize_t n = send(sock, f.data() + front_sent, f.size() - front_sent,
+				MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return 0;
+				child_lost();
+				return EPIPE;
+			}
+			front_sent += n;
+			if (front_sent == f.size()) {
+				pending_bytes -= f.size();
+				pending.pop_front();
+				front_sent = 0;
+			}
+		}
+		return 0;
+	}
+
+	// restart a lost child if RESTART_MS has passed since the last start.
+	void maybe_restart() {
+		auto since = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - last_start).count();
+		if (since < restart_ms)
+			return;
+		int err = start_child();
+		if (err && debug) {
+			std::cout << "script plugin restart failed: " << std::strerror(err) << std::endl;
+		}
+	}
+
+	int pipe_publish(const string& json) {
+		string msg;
+		if (length_format) {
+			msg = std::to_string(json.size());
+			msg += '\n';
+			msg += json;
+		} else {
+			msg.reserve(json.size() + 1);
+			msg = json;
+			msg += '\n';
+		}
+		if (child < 0)
+			maybe_restart();
+		if (child > 0 && drain() && child < 0)
+			maybe_restart();
+		if (pending_bytes + msg.size() > queue_max) {
+			dropped++;
+			if (debug > 1) {
+				std::cout << "script plugin queue full; dropped " << dropped << std::endl;
+			}
+			return EAGAIN;
+		}
+		pending_bytes += msg.size();
+		pending.push_back(std::move(msg));
+		if (child > 0)
+			drain();
 		return 0;
 	}
 
+	// drain, close stdin, and reap the child, each within timeout_ms.
+	void stop_child() {
+		auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(timeout_ms);
+		auto left = [&deadline]() {
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+			return ms > 0 ? (int)ms : 0;
+		};
+		while (child > 0 && pending.size()) {
+			if (drain())
+				break;
+			if (!pending.size())
+				break;
+			struct pollfd pfd = { sock, POLLOUT, 0 };
+			int ms = left();
+			if (!ms || poll(&pfd, 1, ms) == 0)
+				break;
+		}
+		if (pending.size()) {
+			dropped += pending.size();
+			pending.clear();
+			pending_bytes = 0;
+			front_sent = 0;
+		}
+		if (child > 0) {
+			close(sock);
+			sock = -1;
+			int status;
+			pid_t r;
+			while ((r = waitpid(child, &status, WNOHANG)) == 0 && left()) {
+				usleep(1000);
+			}
+			if (r == 0)
+				child_reaper::instance().terminate(child, kill_grace_ms);
+			child = -1;
+		}
+		if (dropped && debug) {
+			std::cout << "script plugin dropped " << dropped << " messages" << std::endl;
+		}
+	}
+
 public:
-	script_plugin() : vers("1.0.0") , tags({"none"}), debug(0), state(ok), paused(false), mode(pi_config) { }
+	script_plugin() : vers("1.0.0") , tags({"none"}), use_affinity(false), use_memfd(false), persistent(false), length_format(false),
+		queue_max(4194304), restart_ms(1000), timeout_ms(5000), child(-1), sock(-1),
+		pending_bytes(0), front_sent(0), dropped(0), debug(0), state(ok), paused(false),
+		mode(pi_config) { }
 
         int publish(std::shared_ptr<builder_api> b) {
 		if (!b)
@@ -147,32 +376,18 @@ public:
 			return 1;
 		if (mode != pi_pub_or_final)
 			return 2;
-		// write to tmpfile, run script and then delete tmpfile
-		// this could be made fancy with a work queue in a later reimplementation.
-		// try for /dev/shm/adc for performance and fall back to tmpdir
-		string fname = get_temp_file_name();
-		if (debug) {
-			std::cout << "script plugin temp name: " << fname <<std::endl;
-		}
-		// open dump file
-		std::ofstream out(fname);
-		if (out.good()) {
-			out << b->serialize() << std::endl;
-			if (out.good()) {
-				if (debug) {
-					std::cout << "plugin 'script' wrote" << std::endl;
-				}
-				out.close();
-				script_send(fname); // send also removes file
-				return 0;
-			} else {
-				std::cout << "script plugin failed write" << std::endl;
-				return 1;
-			}
+		if (prog == adc_script_plugin_prog_default)
+			return 0;
+		if (persistent) {
+			return pipe_publish(counted_serialize(b));
 		}
-		std::filesystem::remove(fname);
-		std::cout << "script plugin failed open " <<fname<< std::endl;
-		return 1;
+		string msg = counted_serialize(b);
+		msg += '\n';
+		// a scratch file is deleted by the script.
+		return subprocess::deliver(msg, use_memfd,
+			[this]() { return get_temp_file_name(); },
+			[this](const string& path, int fd) { return script_send(path, fd); },
+			"script") ? 1 : 0;
 	}
 
         int config(const std::map< std::string, std::string >& m) {
@@ -180,9 +395,34 @@ public:
 	}
 
         int config(const std::map< std::string, std::string >& m, std::string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
 		string d = get(m, "DIRECTORY", env_prefix);
 		string prog = get(m, "PROG", env_prefix);
 		string sdebug = get(m, "DEBUG", env_prefix);
+		string smode = get(m, "MODE", env_prefix);
+		string sformat = get(m, "FORMAT", env_prefix);
+		if ((smode != "spawn" && smode != "pipe") ||
+			(sformat != "ndjson" && sformat != "length")) {
+			return EINVAL;
+		}
+		std::stringstream qs(get(m, "QUEUE_SIZE", env_prefix));
+		std::stringstream rs(get(m, "RESTART_MS", env_prefix));
+		std::stringstream ts(get(m, "TIMEOUT_MS", env_prefix));
+		qs >> queue_max;
+		rs >> restart_ms;
+		ts >> timeout_ms;
+		if (qs.fail() || rs.fail() || ts.fail() || restart_ms < 0 || timeout_ms < 0) {
+			return EINVAL;
+		}
+		if (subprocess::parse_affinity(get(m, "AFFINITY", env_prefix), affinity, use_affinity)) {
+			return EINVAL;
+		}
+		if (subprocess::parse_payload(get(m, "PAYLOAD", env_prefix), use_memfd)) {
+			return EINVAL;
+		}
+		persistent = (smode == "pipe");
+		length_format = (sformat == "length");
 		return config(d, prog, sdebug);
 	}
 
@@ -213,13 +453,25 @@ public:
 			if (debug) {
 				std::cout << "created " << fdir <<std::endl;
 			}
-			mode = pi_pub_or_final;
 		}
+		if (persistent && prog != adc_script_plugin_prog_default) {
+			int serr = start_child();
+			if (serr) {
+				state = err;
+				std::cout << "unable to start program for plugin 'script': "
+					<< prog << " : " << std::strerror(serr) << std::endl;
+				return serr;
+			}
+		}
+		mode = pi_pub_or_final;
 		return 0;
 	}
 
         void finalize() {
 		if (mode == pi_pub_or_final) {
+			if (persistent) {
+				stop_child();
+			}
 			state = ok;
 			paused = false;
 			mode = pi_config;
@@ -247,6 +499,9 @@ public:
 	}
 
 	~script_plugin() {
+		if (child > 0) {
+			stop_child();
+		}
 		if (debug) {
 			std::cout << "Destructing script_plugin" << std::endl;
 		}
@@ -0,0 +1,507 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_shmring_ipp
+#define adc_shmring_ipp
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace adc {
+
+using std::cout;
+
+typedef std::string string;
+typedef std::string_view string_view;
+
+/*! \brief A multi-producer, single-consumer ring of records in a shm_open segment.
+  Producers reserve space by advancing head with compare-and-swap, mark
+  the reservation with its length and their pid, copy the record in, and
+  commit it with a release store of its header, so a write is a memcpy
+  plus three atomics and never blocks or waits on other producers. When
+  the ring lacks room, the record is dropped and the shared dropped
+  counter is incremented.
+
+  The consumer reads committed records in order from tail, zeroes the
+  space, and advances tail. A record never wraps: a producer that would
+  cross the end of the ring reserves the remainder as padding as well.
+  A reservation still uncommitted after stall_ms whose producer no longer
+  exists is skipped and counted as dropped, so a producer killed while
+  writing cannot stall the consumer. Only a producer that dies in the
+  few instructions between its reservation and marking it still can.
+ */
+class shm_ring {
+public:
+	/// \brief shared segment header; data follows at data_offset.
+	struct header {
+		std::atomic<uint64_t> magic;
+		uint64_t version;
+		uint64_t capacity;
+		alignas(64) std::atomic<uint64_t> head;
+		alignas(64) std::atomic<uint64_t> tail;
+		alignas(64) std::atomic<uint64_t> dropped;
+	};
+
+private:
+	/// kind in bits 0-7, producer pid in 8-31, payload length in 32-63.
+	struct record {
+		std::atomic<uint64_t> word;
+	};
+	enum kinds {
+		k_empty = 0,
+		k_reserved = 1,
+		k_record = 2,
+		k_pad = 3
+	};
+	static const uint64_t ring_magic = 0x676e697243444141ULL; // "AADCring"
+	static const uint64_t ring_version = 2;
+	static const size_t data_offset = 256;
+
+	int fd;
+	header *h;
+	char *data;
+	size_t map_len;
+	// consumer side: where and since when the reservation at tail is waited on.
+	uint64_t stall_pos;
+	std::chrono::steady_clock::time_point stall_since;
+
+	static size_t round8(size_t n) {
+		return (n + 7) & ~(size_t)7;
+	}
+
+	static uint64_t make_word(uint64_t kind, uint64_t pid, uint64_t len) {
+		return kind | (pid & 0xffffff) << 8 | len << 32;
+	}
+
+	static uint32_t kind_of(uint64_t w) {
+		return w & 0xff;
+	}
+
+	static pid_t pid_of(uint64_t w) {
+		return (w >> 8) & 0xffffff;
+	}
+
+	static uint32_t len_of(uint64_t w) {
+		return w >> 32;
+	}
+
+	/// \return true if the producer that marked w cannot commit it anymore.
+	bool abandoned(uint64_t t, uint64_t w) {
+		auto now = std::chrono::steady_clock::now();
+		if (t != stall_pos) {
+			stall_pos = t;
+			stall_since = now;
+			return false;
+		}
+		if (now - stall_since < std::chrono::milliseconds(stall_ms))
+			return false;
+		stall_since = now;
+		return kill(pid_of(w), 0) && errno == ESRCH;
+	}
+
+	record *at(uint64_t off) {
+		return reinterpret_cast<record *>(data + off);
+	}
+
+public:
+	/// ms the consumer waits on a reservation before checking its producer.
+	long stall_ms;
+
+	shm_ring() : fd(-1), h(nullptr), data(nullptr), map_len(0),
+		stall_pos(UINT64_MAX), stall_ms(1000) { }
+
+	~shm_ring() {
+		close();
+	}
+
+	shm_ring(const shm_ring&) = delete;
+	shm_ring& operator=(const shm_ring&) = delete;
+
+	/*! \brief the per-job segment name.
+	 * The job is the first of SLURM_JOB_ID, FLUX_JOB_ID, PBS_JOBID, and
+	 * LSB_JOBID set, or "local".
+	 */
+	static string default_name() {
+		const char *job = nullptr;
+		for (const char *v : { "SLURM_JOB_ID", "FLUX_JOB_ID", "PBS_JOBID", "LSB_JOBID" }) {
+			job = getenv(v);
+			if (job && job[0])
+				break;
+			job = nullptr;
+		}
+		return "/adc-ring-" + std::to_string(geteuid()) + "-" + (job ? job : "local");
+	}
+
+	/*! \brief open segment name, creating it with capacity data bytes if needed.
+	 * An existing segment keeps its capacity.
+	 * \return 0 or errno.
+	 */
+	int open(const string& name, size_t capacity) {
+		close();
+		capacity = round8(capacity);
+		if (capacity < 4096)
+			return EINVAL;
+		bool created = true;
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd < 0 && errno == EEXIST) {
+			created = false;
+			fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+		}
+		if (fd < 0)
+			return errno;
+		if (created && ftruncate(fd, data_offset + capacity)) {
+			int e = errno;
+			close();
+			shm_unlink(name.c_str());
+			return e;
+		}
+		struct stat sb;
+		// a creator in another process may not have sized it yet.
+		for (int i = 0; ; i++) {
+			if (fstat(fd, &sb)) {
+				int e = errno;
+				close();
+				return e;
+			}
+			if ((size_t)sb.st_size > data_offset || i == 1000)
+				break;
+			usleep(1000);
+		}
+		if ((size_t)sb.st_size <= data_offset) {
+			close();
+			return EPROTO;
+		}
+		map_len = sb.st_size;
+		void *m = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (m == MAP_FAILED) {
+			int e = errno;
+			close();
+			return e;
+		}
+		h = static_cast<header *>(m);
+		data = static_cast<char *>(m) + data_offset;
+		if (created) {
+			h->version = ring_version;
+			h->capacity = map_len - data_offset;
+			h->head.store(0, std::memory_order_relaxed);
+			h->tail.store(0, std::memory_order_relaxed);
+			h->dropped.store(0, std::memory_order_relaxed);
+			h->magic.store(ring_magic, std::memory_order_release);
+			return 0;
+		}
+		for (int i = 0; h->magic.load(std::memory_order_acquire) != ring_magic; i++) {
+			if (i == 1000) {
+				close();
+				return EPROTO;
+			}
+			usleep(1000);
+		}
+		if (h->version != ring_version || h->capacity != map_len - data_offset) {
+			close();
+			return EPROTO;
+		}
+		return 0;
+	}
+
+	void close() {
+		if (h)
+			munmap(h, map_len);
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+		h = nullptr;
+		data = nullptr;
+		map_len = 0;
+	}
+
+	bool is_open() const {
+		return h != nullptr;
+	}
+
+	/// \brief become the only consumer. \return 0, or EWOULDBLOCK if another holds the ring.
+	int lock_consumer() {
+		if (flock(fd, LOCK_EX | LOCK_NB))
+			return errno;
+		return 0;
+	}
+
+	/*! \brief copy n bytes at p into the ring.
+	 * \return 0, EAGAIN if the ring is full, or EMSGSIZE if n can never fit;
+	 * either failure counts a drop.
+	 */
+	int write(const char *p, size_t n) {
+		const uint64_t cap = h->capacity;
+		const uint64_t need = sizeof(record) + round8(n);
+		if (n > UINT32_MAX || need > cap / 2) {
+			h->dropped.fetch_add(1, std::memory_order_relaxed);
+			return EMSGSIZE;
+		}
+		uint64_t pos = h->head.load(std::memory_order_relaxed);
+		uint64_t pad;
+		for (;;) {
+			uint64_t off = pos % cap;
+			pad = (off + need > cap) ? cap - off : 0;
+			if (pos + pad + need - h->tail.load(std::memory_order_acquire) > cap) {
+				h->dropped.fetch_add(1, std::memory_order_relaxed);
+				return EAGAIN;
+			}
+			if (h->head.compare_exchange_weak(pos, pos + pad + need,
+				std::memory_order_relaxed, std::memory_order_relaxed))
+				break;
+		}
+		const pid_t me = getpid();
+		if (pad)
+			at(pos % cap)->word.store(make_word(k_pad, me, 0), std::memory_order_release);
+		record *r = at((pos + pad) % cap);
+		r->word.store(make_word(k_reserved, me, n), std::memory_order_release);
+		memcpy(static_cast<void *>(r + 1), p, n);
+		r->word.store(make_word(k_record, me, n), std::memory_order_release);
+		return 0;
+	}
+
+	/*! \brief move the oldest committed record into out.
+	 * \return true, or false if the ring is empty or the oldest record
+	 * is not yet committed.
+	 */
+	bool read(string& out) {
+		const uint64_t cap = h->capacity;
+		for (;;) {
+			uint64_t t = h->tail.load(std::memory_order_relaxed);
+			if (t == h->head.load(std::memory_order_acquire))
+				return false;
+			uint64_t off = t % cap;
+			record *r = at(off);
+			uint64_t w = r->word.load(std::memory_order_acquire);
+			uint32_t kind = kind_of(w);
+			if (kind == k_empty)
+				return false;
+			if (kind == k_reserved && !abandoned(t, w))
+				return false;
+			uint64_t span;
+			if (kind == k_pad) {
+				span = cap - off;
+			} else {
+				span = sizeof(record) + round8(len_of(w));
+				if (kind == k_record)
+					out.assign(reinterpret_cast<char *>(r + 1), len_of(w));
+				else
+					h->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			// producers see the space only after tail moves past it.
+			memset(static_cast<void *>(r), 0, span);
+			h->tail.store(t + span, std::memory_order_release);
+			if (kind == k_record)
+				return true;
+		}
+	}
+
+	/// \return the records dropped since the segment was created.
+	uint64_t dropped() const {
+		return h->dropped.load(std::memory_order_relaxed);
+	}
+
+	/// \return the data capacity in bytes.
+	uint64_t capacity() const {
+		return h->capacity;
+	}
+};
+
+
+/*! \brief Shared-memory ring publisher_api implementation.
+  This plugin copies each message into a shm_ring segment shared by the
+  processes of a job on a node, for a collector process (adc.ring.collector)
+  to forward. Publishing never blocks: it costs the message serialization,
+  a memcpy and three atomic operations. When the ring is full, the message
+  is dropped, the drop is counted in the segment header (reported by the
+  collector), and publish returns EAGAIN.
+
+  NAME is the shm_open name, by default /adc-ring-$uid-$job as in
+  shm_ring::default_name(). SIZE (default 64 MiB) is the ring capacity if
+  this process creates the segment.
+  Options are overridden with env("ADC_SHMRING_PLUGIN_$OPTION").
+  Unlike most publishers, publish() on this plugin is thread-safe.
+ */
+class shmring_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+public:
+	/// \brief default ring capacity in bytes.
+	/// Overridden with env("ADC_SHMRING_PLUGIN_SIZE").
+	inline static const char *adc_shmring_plugin_size_default = "67108864";
+
+	/// \brief ADC shmring plugin enable debug messages; (default "0": none)
+	/// Overridden with env("ADC_SHMRING_PLUGIN_DEBUG").
+	inline static const char *adc_shmring_plugin_debug_default = "0";
+
+private:
+	inline static const char *plugin_prefix = "ADC_SHMRING_PLUGIN_";
+	inline static const std::map< const string, const string > plugin_config_defaults =
+	{	{"NAME", ""},
+		{"SIZE", adc_shmring_plugin_size_default},
+		{"DEBUG", adc_shmring_plugin_debug_default}
+	};
+
+	const string vers;
+	const std::vector<string> tags;
+	string ring_name;
+	size_t size;
+	shm_ring ring;
+	std::atomic<uint64_t> dropped; // publish may run on many threads
+	int debug;
+	enum state state;
+	bool paused;
+	enum mode mode;
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+public:
+	shmring_plugin() : vers("1.0.0") , tags({"none"}), size(0), dropped(0), debug(0),
+		state(ok), paused(false), mode(pi_config) { }
+
+        int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		string m = counted_serialize(b);
+		int e = ring.write(m.data(), m.size());
+		if (e) {
+			uint64_t n = dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+			if (debug > 1) {
+				std::cout << "shmring plugin dropped " << n << ": "
+					<< std::strerror(e) << std::endl;
+			}
+		}
+		return e;
+	}
+
+        int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_prefix);
+	}
+
+        int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
+		ring_name = get(m, "NAME", env_prefix);
+		if (ring_name.empty())
+			ring_name = shm_ring::default_name();
+		std::stringstream ss(get(m, "SIZE", env_prefix));
+		std::stringstream ds(get(m, "DEBUG", env_prefix));
+		ss >> size;
+		ds >> debug;
+		if (ss.fail() || size < 4096)
+			return EINVAL;
+		if (debug < 0)
+			debug = 0;
+		mode = pi_init;
+		return 0;
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		if (!ring_name.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		int e = ring.open(ring_name, size);
+		if (e) {
+			state = err;
+			std::cout << "shmring plugin: unable to open " << ring_name << ": "
+				<< std::strerror(e) << std::endl;
+			return e;
+		}
+		if (debug) {
+			std::cout << "shmring plugin opened " << ring_name << " capacity "
+				<< ring.capacity() << std::endl;
+		}
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+        void finalize() {
+		if (mode == pi_pub_or_final) {
+			uint64_t n = dropped.load(std::memory_order_relaxed);
+			if (n && debug) {
+				std::cout << "shmring plugin dropped " << n << " messages" << std::endl;
+			}
+			ring.close();
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "shmring plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+        void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "shmring";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~shmring_plugin() {
+		ring.close();
+	}
+};
+
+} // adc
+#endif // adc_shmring_ipp
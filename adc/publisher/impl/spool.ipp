@@ -0,0 +1,728 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_spool_ipp
+#define adc_spool_ipp
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/inner_options.ipp>
+#include <adc/publisher/impl/subprocess.ipp>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace adc {
+
+using std::cout;
+
+typedef std::string string;
+typedef std::string_view string_view;
+
+/*! \brief A directory of per-application spool files, shared by the
+  processes of a user on a node.
+  The records of application A are appended, one serialized message per
+  line, to A.spool; the offset of the first undelivered record is kept
+  in A.pos. Appends hold an exclusive flock on A.spool. One replayer at a
+  time holds an exclusive flock on A.pos; when it has delivered every
+  record it removes A.spool and A.pos (under both locks). A.pos is reset
+  before A.spool is removed, so a crash in between replays records
+  rather than skipping them. A process that locks a file just removed
+  opens it again.
+ */
+class spool_dir {
+	string dir;
+
+	string path(const string& key, const char *suffix) const {
+		return dir + "/" + key + suffix;
+	}
+
+public:
+	/// \brief the file name used for application app.
+	static string key(string_view app) {
+		string k;
+		for (char c : app)
+			k += (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.') ? c : '_';
+		if (k.empty() || k[0] == '.')
+			k.insert(0, "_");
+		return k;
+	}
+
+	/// \brief use directory d, creating it if needed. \return 0 or errno.
+	int open(const string& d) {
+		dir = d;
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		return ec.value();
+	}
+
+	/// \brief the keys of the spool files and their sizes.
+	std::map< string, uint64_t > files() const {
+		std::map< string, uint64_t > m;
+		std::error_code ec;
+		for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+			if (e.path().extension() != ".spool")
+				continue;
+			std::error_code sec;
+			uint64_t sz = e.file_size(sec);
+			if (!sec)
+				m[e.path().stem().string()] = sz;
+		}
+		return m;
+	}
+
+	/// \brief the size of the spool of key; 0 if there is none.
+	uint64_t size(const string& key) const {
+		struct stat sb;
+		if (stat(path(key, ".spool").c_str(), &sb))
+			return 0;
+		return (uint64_t)sb.st_size;
+	}
+
+	/// \brief append msg as a record of key. \return 0 or errno.
+	int append(const string& key, const string& msg) const {
+		int fd;
+		for (;;) {
+			fd = ::open(path(key, ".spool").c_str(),
+				O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+			if (fd < 0)
+				return errno;
+			flock(fd, LOCK_EX);
+			if (!removed(fd))
+				break;
+			::close(fd);
+		}
+		string line = msg + "\n";
+		int err = 0;
+		ssize_t n = write(fd, line.data(), line.size());
+		if (n != (ssize_t)line.size())
+			err = n < 0 ? errno : EIO;
+		flock(fd, LOCK_UN);
+		::close(fd);
+		return err;
+	}
+
+	/*! \brief deliver the records of key in order with deliver(record),
+	 * which returns 0 when the record has been delivered. Stops at the
+	 * first failure, or when stop() becomes true.
+	 * \param freed is increased by the bytes removed from the spool.
+	 * \return 0 if the spool of key is empty, EBUSY if another replayer
+	 * holds it, EAGAIN if a delivery failed or stop() was true, or errno.
+	 */
+	int replay(const string& key, std::function<int(const string&)> deliver,
+		std::function<bool()> stop, uint64_t& freed) const {
+		int pfd = ::open(path(key, ".pos").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (pfd < 0)
+			return errno;
+		if (flock(pfd, LOCK_EX | LOCK_NB) || removed(pfd)) {
+			::close(pfd);
+			return EBUSY;
+		}
+		int sfd = ::open(path(key, ".spool").c_str(), O_RDWR | O_CLOEXEC);
+		if (sfd < 0) {
+			int err = errno;
+			::close(pfd);
+			return err == ENOENT ? 0 : err;
+		}
+		char pbuf[32] = {0};
+		uint64_t pos = 0;
+		if (pread(pfd, pbuf, sizeof(pbuf) - 1, 0) > 0)
+			pos = strtoull(pbuf, nullptr, 10);
+		int err = 0;
+		string pending;
+		char buf[65536];
+		for (;;) {
+			struct stat sb;
+			if (fstat(sfd, &sb)) {
+				err = errno;
+				break;
+			}
+			uint64_t size = (uint64_t)sb.st_size;
+			if (pos > size)
+				pos = 0; // emptied after the offset was reset.
+			uint64_t at = pos + pending.size();
+			if (at >= size) {
+				// all delivered; remove the spool unless a record just arrived.
+				flock(sfd, LOCK_EX);
+				if (!fstat(sfd, &sb) && (uint64_t)sb.st_size == size) {
+					write_pos(pfd, 0);
+					if (!unlink(path(key, ".spool").c_str()) || !ftruncate(sfd, 0))
+						freed += size;
+					unlink(path(key, ".pos").c_str());
+					pos = 0;
+					pending.clear();
+					flock(sfd, LOCK_UN);
+					break;
+				}
+				flock(sfd, LOCK_UN);
+				continue;
+			}
+			ssize_t n = pread(sfd, buf, std::min((uint64_t)sizeof(buf), size - at), at);
+			if (n <= 0) {
+				err = n < 0 ? errno : EIO;
+				break;
+			}
+			pending.append(buf, n);
+			size_t nl;
+			while ((nl = pending.find('\n')) != string::npos) {
+				if (stop()) {
+					err = EAGAIN;
+					break;
+				}
+				if (nl && deliver(pending.substr(0, nl))) {
+					err = EAGAIN;
+					break;
+				}
+				pos += nl + 1;
+				pending.erase(0, nl + 1);
+				write_pos(pfd, pos);
+			}
+			if (err)
+				break;
+		}
+		::close(sfd);
+		::close(pfd);
+		return err;
+	}
+
+private:
+	// true if the file open as fd has been unlinked.
+	static bool removed(int fd) {
+		struct stat sb;
+		return !fstat(fd, &sb) && sb.st_nlink == 0;
+	}
+
+	static void write_pos(int pfd, uint64_t pos) {
+		string s = std::to_string(pos) + "\n";
+		if (!ftruncate(pfd, 0) && pwrite(pfd, s.data(), s.size(), 0) < 0)
+			std::cout << "spool: offset update failed: " << strerror(errno) << std::endl;
+	}
+};
+
+/*! \brief Spooling publisher_api decorator for deliveries that can fail.
+  This plugin passes messages to the publisher named by PUBLISHER
+  (default "curl"), which must report the outcome of its deliveries
+  (payload_sender: curl, ldms_message_publish and ldmsd_stream_publish).
+  Messages whose delivery fails, at once or when the utility exits, are
+  appended to a spool file per application in DIRECTORY/$uid/$PUBLISHER
+  (default DIRECTORY /dev/shm/adc-spool; node-local storage should be
+  used). A background thread replays spooled messages through the
+  publisher one at a time, retrying an application after RETRY_MIN_MS
+  (default 1000), doubled on each failure up to RETRY_MAX_MS (default
+  300000). While an application has spooled messages, its new messages
+  are spooled behind them, so spooled messages are delivered in order;
+  a message in flight when the endpoint fails may still arrive after
+  later ones. Delivery is at least once: a message may be sent again
+  if its outcome is lost.
+
+  The spool survives the process. At initialize and every SCAN_SECONDS
+  (default 30), spools left by other processes of the same user and
+  PUBLISHER are found and drained; one process at a time drains each.
+  At finalize, deliveries still in flight are waited for, up to
+  TIMEOUT_MS (default 5000), and those that failed are spooled; only a
+  delivery that fails after that is lost. Spool files are removed once
+  replayed. When the spool directory holds MAX_BYTES (default
+  268435456), messages to spool are dropped and publish returns EAGAIN.
+
+  Options PUBLISHER_$X (or env("ADC_SPOOL_PLUGIN_PUBLISHER_$X")) are passed
+  to the decorated publisher as option $X; the decorated publisher
+  otherwise uses its own env settings.
+  Options are overridden with env("ADC_SPOOL_PLUGIN_$OPTION").
+ */
+class spool_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+public:
+	/// \brief creates the decorated publisher by name, or returns an empty pointer.
+	typedef std::function< std::shared_ptr< publisher_api >(const string&) > publisher_maker;
+
+	/// \brief default decorated publisher.
+	/// Overridden with env("ADC_SPOOL_PLUGIN_PUBLISHER").
+	inline static const char *adc_spool_plugin_publisher_default = "curl";
+
+	/// \brief default spool root directory; it should be node-local.
+	/// Overridden with env("ADC_SPOOL_PLUGIN_DIRECTORY").
+	inline static const char *adc_spool_plugin_directory_default = "/dev/shm/adc-spool";
+
+	/// \brief ADC spool plugin enable debug messages; (default "0": none)
+	/// Overridden with env("ADC_SPOOL_PLUGIN_DEBUG").
+	inline static const char *adc_spool_plugin_debug_default = "0";
+
+private:
+	inline static const char *plugin_prefix = "ADC_SPOOL_PLUGIN_";
+	inline static const std::map< const string, const string > plugin_config_defaults =
+	{	{"PUBLISHER", adc_spool_plugin_publisher_default},
+		{"DIRECTORY", adc_spool_plugin_directory_default},
+		{"MAX_BYTES", "268435456"},
+		{"RETRY_MIN_MS", "1000"},
+		{"RETRY_MAX_MS", "300000"},
+		{"SCAN_SECONDS", "30"},
+		{"TIMEOUT_MS", "5000"},
+		{"DEBUG", adc_spool_plugin_debug_default}
+	};
+
+	typedef std::chrono::steady_clock clock;
+
+	// state shared with delivery callbacks, which may outlive the plugin.
+	// Lock order is lock, then deferred_lock.
+	struct shared {
+		spool_dir dir;
+		uint64_t max_bytes = 0;
+		std::atomic< uint64_t > bytes{0};	// estimate of the spool size
+		std::atomic< uint64_t > spooled{0};
+		std::atomic< uint64_t > dropped{0};
+		std::mutex lock;
+		std::condition_variable wake;
+		std::map< string, clock::time_point > backlog;	// key: next retry
+		// failed deliveries not yet spooled. Delivery callbacks run on
+		// the shared child reaper and must not block, so they only queue
+		// here; deferred_lock is never held across file i/o.
+		std::mutex deferred_lock;
+		std::map< string, std::vector< string > > deferred;
+		uint64_t in_flight = 0;	// sends whose callback has not run
+		std::condition_variable idle;	// in_flight reached 0
+		int debug = 0;
+
+		// count a send about to start.
+		void sending() {
+			std::lock_guard< std::mutex > d(deferred_lock);
+			in_flight++;
+		}
+
+		// end a send; if it failed, queue msg to be spooled by the replayer.
+		void sent(const string& key, const string& msg, bool ok) {
+			{
+				std::lock_guard< std::mutex > d(deferred_lock);
+				if (!ok)
+					deferred[key].push_back(msg);
+				if (!--in_flight)
+					idle.notify_all();
+			}
+			if (!ok)
+				wake.notify_all();
+		}
+
+		// wait up to ms for the sends in flight to end. \return true if they did.
+		bool wait_idle(long ms) {
+			std::unique_lock< std::mutex > d(deferred_lock);
+			return idle.wait_for(d, std::chrono::milliseconds(ms),
+				[this]() { return in_flight == 0; });
+		}
+
+		// with lock held: true if new messages of key must be spooled.
+		bool behind(const string& key) {
+			if (backlog.count(key))
+				return true;
+			std::lock_guard< std::mutex > d(deferred_lock);
+			return deferred.count(key) > 0;
+		}
+
+		// with lock held: spool msg for key behind any deferred messages.
+		// \return 0, EAGAIN if full, or errno.
+		int spool_locked(const string& key, const string& msg) {
+			{
+				std::lock_guard< std::mutex > d(deferred_lock);
+				auto it = deferred.find(key);
+				if (it != deferred.end()) {
+					it->second.push_back(msg);
+					return 0;
+				}
+			}
+			return add_locked(key, msg);
+		}
+
+		// spool msg for key. \return 0, EAGAIN if full, or errno.
+		int spool(const string& key, const string& msg) {
+			std::lock_guard< std::mutex > g(lock);
+			return spool_locked(key, msg);
+		}
+
+		// with lock held: append the deferred messages to their spools.
+		void flush_locked() {
+			std::map< string, std::vector< string > > batch;
+			{
+				std::lock_guard< std::mutex > d(deferred_lock);
+				batch.swap(deferred);
+			}
+			for (const auto& k : batch)
+				for (const auto& msg : k.second)
+					add_locked(k.first, msg);
+		}
+
+		// with lock held: append msg to the spool of key.
+		// \return 0, EAGAIN if full, or errno.
+		int add_locked(const string& key, const string& msg) {
+			if (bytes.load() + msg.size() + 1 > max_bytes) {
+				dropped++;
+				return EAGAIN;
+			}
+			int e = dir.append(key, msg);
+			if (e) {
+				if (debug)
+					std::cout << "spool plugin: append failed: " << strerror(e) << std::endl;
+				return e;
+			}
+			bytes += msg.size() + 1;
+			spooled++;
+			if (!backlog.count(key)) {
+				backlog[key] = clock::now();
+				wake.notify_all();
+			}
+			return 0;
+		}
+	};
+
+	const string vers;
+	const std::vector<string> tags;
+	publisher_maker make_publisher;
+	std::shared_ptr< publisher_api > inner;
+	payload_sender *sender;
+	string inner_name;
+	string root;
+	std::shared_ptr< shared > sh;
+	std::map< string, long > retry_ms;	// current backoff per key
+	long retry_min_ms;
+	long retry_max_ms;
+	long scan_seconds;
+	long timeout_ms;
+	std::thread replayer;
+	std::atomic< bool > stopping;
+	std::atomic< bool > paused;
+	std::atomic< uint64_t > replayed;
+	int debug;
+	enum state state;
+	enum mode mode;
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	static bool delivered(int status) {
+		return status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+
+	// add spools found on disk to the backlog and refresh the size estimate.
+	void scan() {
+		uint64_t total = 0;
+		auto found = sh->dir.files();
+		std::lock_guard< std::mutex > g(sh->lock);
+		for (const auto& f : found) {
+			total += f.second;
+			if (f.second && !sh->backlog.count(f.first))
+				sh->backlog[f.first] = clock::now();
+		}
+		sh->bytes = total;
+	}
+
+	// deliver one record and wait for the outcome. \return 0 if delivered.
+	int deliver_wait(const string& msg) {
+		struct waiter {
+			std::mutex m;
+			std::condition_variable cv;
+			bool done = false;
+			int status = -1;
+		};
+		auto w = std::make_shared< waiter >();
+		int e = sender->send(msg, [w](int status) {
+			std::lock_guard< std::mutex > g(w->m);
+			w->status = status;
+			w->done = true;
+			w->cv.notify_all();
+		});
+		if (e)
+			return e;
+		std::unique_lock< std::mutex > g(w->m);
+		while (!w->done) {
+			if (stopping)
+				return EINTR;
+			w->cv.wait_for(g, std::chrono::milliseconds(100));
+		}
+		return delivered(w->status) ? 0 : EIO;
+	}
+
+	void replay_loop() {
+		auto next_scan = clock::now() + std::chrono::seconds(scan_seconds);
+		std::unique_lock< std::mutex > g(sh->lock);
+		while (!stopping) {
+			sh->flush_locked();
+			auto now = clock::now();
+			if (now >= next_scan) {
+				g.unlock();
+				scan();
+				g.lock();
+				next_scan = now + std::chrono::seconds(scan_seconds);
+			}
+			string key;
+			auto next = next_scan;
+			if (!paused) {
+				for (const auto& b : sh->backlog) {
+					if (b.second <= now) {
+						key = b.first;
+						break;
+					}
+					if (b.second < next)
+						next = b.second;
+				}
+			}
+			if (key.empty()) {
+				sh->wake.wait_until(g, std::min(next, now + std::chrono::seconds(1)));
+				continue;
+			}
+			g.unlock();
+			uint64_t freed = 0;
+			uint64_t sent = 0;
+			int e = sh->dir.replay(key,
+				[this, &sent](const string& m) {
+					int r = deliver_wait(m);
+					if (!r)
+						sent++;
+					return r;
+				},
+				[this]() { return stopping || paused; }, freed);
+			replayed += sent;
+			g.lock();
+			sh->bytes -= std::min(freed, sh->bytes.load());
+			if (debug && (sent || e)) {
+				std::cout << "spool plugin: " << key << ": replayed " << sent
+					<< (e ? " then stopped: " : "") << (e ? strerror(e) : "") << std::endl;
+			}
+			if (!e) {
+				// a message spooled since replay emptied the file keeps
+				// the key in the backlog, so later ones queue behind it.
+				if (sh->dir.size(key)) {
+					sh->backlog[key] = clock::now();
+				} else {
+					sh->backlog.erase(key);
+					retry_ms.erase(key);
+				}
+				continue;
+			}
+			long& r = retry_ms[key];
+			if (e == EBUSY || sent)
+				r = retry_min_ms;
+			else
+				r = r ? std::min(2 * r, retry_max_ms) : retry_min_ms;
+			sh->backlog[key] = clock::now() + std::chrono::milliseconds(r);
+		}
+		sh->flush_locked();
+	}
+
+public:
+	spool_plugin(publisher_maker make_publisher) :
+		vers("1.0.0") , tags({"none"}), make_publisher(make_publisher),
+		sender(nullptr), retry_min_ms(1000), retry_max_ms(300000),
+		scan_seconds(30), timeout_ms(5000), stopping(false), paused(false), replayed(0),
+		debug(0), state(ok), mode(pi_config) { }
+
+        int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		const char *app = b->get_value_string("/header/application");
+		string key = spool_dir::key(app ? app : "");
+		string msg = counted_serialize(b);
+		{
+			std::lock_guard< std::mutex > g(sh->lock);
+			if (sh->behind(key))
+				return sh->spool_locked(key, msg);
+		}
+		auto s = sh;
+		sh->sending();
+		int e = sender->send(msg, [s, key, msg](int status) {
+			s->sent(key, msg, delivered(status));
+		});
+		if (e) {
+			sh->sent(key, msg, true);
+			return sh->spool(key, msg);
+		}
+		return 0;
+	}
+
+        int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_prefix);
+	}
+
+        int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
+		inner_name = get(m, "PUBLISHER", env_prefix);
+		string dir = get(m, "DIRECTORY", env_prefix);
+		uint64_t max_bytes = 0;
+		std::stringstream ms(get(m, "MAX_BYTES", env_prefix));
+		std::stringstream ls(get(m, "RETRY_MIN_MS", env_prefix));
+		std::stringstream hs(get(m, "RETRY_MAX_MS", env_prefix));
+		std::stringstream ss(get(m, "SCAN_SECONDS", env_prefix));
+		std::stringstream ts(get(m, "TIMEOUT_MS", env_prefix));
+		std::stringstream ds(get(m, "DEBUG", env_prefix));
+		ms >> max_bytes;
+		ls >> retry_min_ms;
+		hs >> retry_max_ms;
+		ss >> scan_seconds;
+		ts >> timeout_ms;
+		ds >> debug;
+		if (ms.fail() || ls.fail() || hs.fail() || ss.fail() || ts.fail() || dir.empty() ||
+			retry_min_ms < 1 || retry_max_ms < retry_min_ms || scan_seconds < 1 ||
+			timeout_ms < 0)
+			return EINVAL;
+		if (debug < 0)
+			debug = 0;
+		if (inner_name == name())
+			return EINVAL;
+		inner = make_publisher(inner_name);
+		if (!inner) {
+			std::cout << "spool plugin: no publisher named " << inner_name << std::endl;
+			return EINVAL;
+		}
+		sender = dynamic_cast< payload_sender * >(inner.get());
+		if (!sender) {
+			std::cout << "spool plugin: publisher " << inner_name
+				<< " does not report deliveries" << std::endl;
+			inner.reset();
+			return EINVAL;
+		}
+		int e = inner->config(inner_options(m, env_prefix, *inner));
+		if (e) {
+			inner.reset();
+			sender = nullptr;
+			return e;
+		}
+		root = dir + "/" + std::to_string(geteuid()) + "/" + inner_name;
+		sh = std::make_shared< shared >();
+		sh->max_bytes = max_bytes;
+		sh->debug = debug;
+		mode = pi_init;
+		return 0;
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		if (!inner_name.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		int e = sh->dir.open(root);
+		if (e) {
+			std::cout << "spool plugin: cannot create " << root << ": "
+				<< strerror(e) << std::endl;
+			state = err;
+			return e;
+		}
+		e = inner->initialize();
+		if (e) {
+			state = err;
+			return e;
+		}
+		scan();
+		stopping = false;
+		replayer = std::thread(&spool_plugin::replay_loop, this);
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+        void finalize() {
+		if (mode == pi_pub_or_final) {
+			stopping = true;
+			sh->wake.notify_all();
+			if (replayer.joinable())
+				replayer.join();
+			// spool the failures of sends still in flight, so they outlive the process.
+			bool idle = sh->wait_idle(timeout_ms);
+			{
+				std::lock_guard< std::mutex > g(sh->lock);
+				sh->flush_locked();
+			}
+			if (debug && !idle) {
+				std::cout << "spool plugin: deliveries still in flight at finalize" << std::endl;
+			}
+			if (debug) {
+				std::cout << "spool plugin: spooled " << sh->spooled
+					<< " replayed " << replayed
+					<< " dropped " << sh->dropped << std::endl;
+			}
+			inner->finalize();
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "spool plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+        void resume() {
+		paused = false;
+		if (sh)
+			sh->wake.notify_all();
+	}
+
+	string_view name() const {
+		return "spool";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~spool_plugin() {
+		if (replayer.joinable()) {
+			stopping = true;
+			sh->wake.notify_all();
+			replayer.join();
+		}
+	}
+};
+
+} // adc
+#endif // adc_spool_ipp
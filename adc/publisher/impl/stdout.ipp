@@ -18,7 +18,7 @@ std::map< const std::string, const std::string> stdout_defaults;
   Multiple independent instances of this plugin may be used simultaneously,
   but message integrity depends on the behavior of stdout.
  */
-class stdout_plugin : public publisher_api {
+class stdout_plugin : public publisher_api, public counted_publisher {
 	enum state {
 		ok,
 		err
@@ -40,7 +40,7 @@ public:
 			return 0;
 		if (state != ok)
 			return 1;
-		std::cout << b->serialize() << std::endl;
+		std::cout << counted_serialize(b) << std::endl;
 		return 0;
 	}
 
@@ -0,0 +1,668 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_subprocess_ipp
+#define adc_subprocess_ipp
+#include <adc/publisher/publisher.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace adc {
+
+/*! \brief Interface of publishers that deliver serialized messages in
+  the background and can report the outcome of each delivery, such as
+  those running a utility per message. The spool plugin uses it.
+ */
+class payload_sender {
+public:
+	virtual ~payload_sender() {}
+
+	/*! \brief deliver msg, a serialized message, as publish would.
+	 * If delivery starts, done is called when it ends, on another thread,
+	 * with the wait status of the utility (or -1 if unknown); done must
+	 * not block.
+	 * \return 0 if delivery started, or an error code.
+	 */
+	virtual int send(const std::string& msg, std::function<void(int)> done) = 0;
+};
+
+/*! \brief Asynchronous reaper for children started by publishers.
+  Children are watched individually (never with waitpid(-1)), so children
+  the application starts itself are not disturbed. One thread per process
+  waits on a pidfd per child (Linux 5.3+), or polls every 50 ms where
+  pidfd_open is unavailable, and runs each child's completion callback
+  with its wait status, or -1 if the child was reaped elsewhere.
+  Callbacks run on the reaper thread and must not block. Children given
+  to terminate are sent SIGKILL if they outlive their grace period.
+ */
+class child_reaper {
+	typedef std::chrono::steady_clock clock;
+
+	struct watched {
+		int pidfd;
+		std::function<void(int)> done;
+		bool kill_pending;
+		clock::time_point kill_at;
+	};
+
+	std::mutex lock;
+	std::map<pid_t, watched> children;
+	std::thread worker;
+	int wake;
+	bool stop;
+
+	child_reaper() : wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), stop(false) { }
+
+	static int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+		return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+		(void)pid;
+		errno = ENOSYS;
+		return -1;
+#endif
+	}
+
+	/* reap finished children and kill those past their grace period.
+	 * \return the poll timeout in ms until the next check is due, or -1.
+	 */
+	int reap() {
+		std::vector< std::pair< std::function<void(int)>, int> > finished;
+		int timeout = -1;
+		auto now = clock::now();
+		{
+			std::lock_guard<std::mutex> g(lock);
+			for (auto it = children.begin(); it != children.end(); ) {
+				int status = 0;
+				pid_t r = waitpid(it->first, &status, WNOHANG);
+				if (r == 0 || (r < 0 && errno == EINTR)) {
+					if (it->second.pidfd < 0)
+						timeout = 50;
+					if (it->second.kill_pending) {
+						if (now >= it->second.kill_at) {
+							kill(it->first, SIGKILL);
+							it->second.kill_pending = false;
+						} else {
+							int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+								it->second.kill_at - now).count() + 1;
+							if (timeout < 0 || ms < timeout)
+								timeout = ms;
+						}
+					}
+					++it;
+					continue;
+				}
+				if (it->second.pidfd >= 0)
+					close(it->second.pidfd);
+				finished.emplace_back(std::move(it->second.done), r > 0 ? status : -1);
+				it = children.erase(it);
+			}
+		}
+		for (auto& f : finished) {
+			if (f.first)
+				f.first(f.second);
+		}
+		return timeout;
+	}
+
+	void run() {
+		std::vector<struct pollfd> fds;
+		for (;;) {
+			int timeout = reap();
+			fds.clear();
+			fds.push_back({ wake, POLLIN, 0 });
+			{
+				std::lock_guard<std::mutex> g(lock);
+				if (stop)
+					return;
+				for (const auto& c : children) {
+					if (c.second.pidfd >= 0)
+						fds.push_back({ c.second.pidfd, POLLIN, 0 });
+				}
+			}
+			poll(fds.data(), fds.size(), timeout);
+			if (fds[0].revents) {
+				uint64_t v;
+				while (read(wake, &v, sizeof(v)) > 0) { }
+			}
+		}
+	}
+
+public:
+	child_reaper(const child_reaper&) = delete;
+	child_reaper& operator=(const child_reaper&) = delete;
+
+	~child_reaper() {
+		{
+			std::lock_guard<std::mutex> g(lock);
+			stop = true;
+		}
+		uint64_t one = 1;
+		if (write(wake, &one, sizeof(one)) < 0) { }
+		if (worker.joinable())
+			worker.join();
+		for (auto& c : children) {
+			if (c.second.pidfd >= 0)
+				close(c.second.pidfd);
+		}
+		close(wake);
+	}
+
+	/// \return the process-wide reaper.
+	static child_reaper& instance() {
+		static child_reaper r;
+		return r;
+	}
+
+	/// \brief reap pid when it exits, then call done(wait status) if given.
+	void watch(pid_t pid, std::function<void(int)> done) {
+		add(pid, std::move(done), false, clock::time_point());
+	}
+
+	/// \brief send pid SIGTERM, then SIGKILL if it is alive after grace_ms; reap it.
+	void terminate(pid_t pid, int grace_ms) {
+		kill(pid, SIGTERM);
+		add(pid, nullptr, true, clock::now() + std::chrono::milliseconds(grace_ms));
+	}
+
+private:
+	void add(pid_t pid, std::function<void(int)> done, bool kill_pending,
+		clock::time_point kill_at) {
+		int pfd = pidfd_open(pid);
+		if (pfd >= 0)
+			fcntl(pfd, F_SETFD, FD_CLOEXEC);
+		{
+			std::lock_guard<std::mutex> g(lock);
+			children[pid] = { pfd, std::move(done), kill_pending, kill_at };
+			if (!worker.joinable())
+				worker = std::thread(&child_reaper::run, this);
+		}
+		uint64_t one = 1;
+		if (write(wake, &one, sizeof(one)) < 0) { }
+	}
+};
+
+/*! \brief Process launch for publishers that deliver through other programs.
+  Programs are started with posix_spawnp (vfork semantics, so the cost does
+  not grow with the application's address space) from an argument vector,
+  without a shell. Message payloads are handed to them in a scratch file,
+  or on request in a memfd as stdin.
+ */
+class subprocess {
+public:
+	/// \brief launch settings.
+	struct options {
+		int stdin_fd = -1; //!< if >= 0, becomes the child's stdin.
+		int stdout_fd = -1; //!< if >= 0, becomes the child's stdout.
+		bool quiet = true; //!< send the child's stdout (unless stdout_fd) and stderr to /dev/null.
+		const cpu_set_t *affinity = nullptr; //!< if set, the child's cpu affinity.
+	};
+
+	/*! \brief parse an AFFINITY option value.
+	 * "all" is every processor, per get_default_affinity(); otherwise a
+	 * range list such as "0-1,56-57". An empty value leaves affinity unset.
+	 * \return 0, or EINVAL if the list cannot be parsed.
+	 */
+	static int parse_affinity(const std::string& spec, cpu_set_t& set, bool& use) {
+		CPU_ZERO(&set);
+		use = false;
+		if (spec.empty())
+			return 0;
+		std::string list = (spec == "all") ? get_default_affinity() : spec;
+		std::stringstream ss(list);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			if (item.empty())
+				continue;
+			char *end;
+			unsigned long lo = strtoul(item.c_str(), &end, 10);
+			unsigned long hi = lo;
+			if (*end == '-')
+				hi = strtoul(end + 1, &end, 10);
+			if (*end || end == item.c_str() || hi < lo)
+				return EINVAL;
+			for (unsigned long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+				CPU_SET(c, &set);
+		}
+		use = CPU_COUNT(&set) > 0;
+		return use ? 0 : EINVAL;
+	}
+
+	/// \brief the file argument by which a child reads a payload given as its stdin.
+	inline static const char *stdin_path = "/proc/self/fd/0";
+
+	/*! \brief copy data into an anonymous memory file for a child to read.
+	 * Pass fd as options::stdin_fd and stdin_path as the child's file
+	 * argument, then close fd after launch. The payload is never in a
+	 * filesystem, so it cannot be left behind if the child is killed.
+	 * \return 0 or errno (ENOSYS where memfd_create is unavailable).
+	 */
+	static int memfd_payload(const std::string& data, int& fd) {
+#ifdef MFD_CLOEXEC
+		fd = memfd_create("adc-msg", MFD_CLOEXEC);
+#else
+		fd = -1;
+		errno = ENOSYS;
+#endif
+		if (fd < 0)
+			return errno;
+		size_t done = 0;
+		while (done < data.size()) {
+			ssize_t w = write(fd, data.data() + done, data.size() - done);
+			if (w < 0) {
+				if (errno == EINTR)
+					continue;
+				int err = errno;
+				close(fd);
+				fd = -1;
+				return err;
+			}
+			done += w;
+		}
+		lseek(fd, 0, SEEK_SET);
+		return 0;
+	}
+
+	/// \brief parse a PAYLOAD option value. \return 0, or EINVAL if not memfd or file.
+	static int parse_payload(const std::string& spec, bool& use_memfd) {
+		use_memfd = (spec == "memfd");
+		return (use_memfd || spec == "file") ? 0 : EINVAL;
+	}
+
+	/// \brief the range list, such as "0-1,56-57", of the cpus in set.
+	static std::string cpu_list(const cpu_set_t& set) {
+		std::string list;
+		for (int c = 0; c < CPU_SETSIZE; c++) {
+			if (!CPU_ISSET(c, &set))
+				continue;
+			int hi = c;
+			while (hi + 1 < CPU_SETSIZE && CPU_ISSET(hi + 1, &set))
+				hi++;
+			if (list.size())
+				list += ',';
+			list += std::to_string(c);
+			if (hi > c)
+				list += "-" + std::to_string(hi);
+			c = hi;
+		}
+		return list;
+	}
+
+	/// \return true if taskset is found in PATH; looked up once.
+	static bool have_taskset() {
+		static const bool found = []() {
+			const char *path = getenv("PATH");
+			std::stringstream ss(path ? path : "/usr/bin:/bin");
+			std::string d;
+			while (std::getline(ss, d, ':'))
+				if (d.size() && !access((d + "/taskset").c_str(), X_OK))
+					return true;
+			return false;
+		}();
+		return found;
+	}
+
+	/*! \brief start argv[0] (searched in PATH) with the given arguments.
+	 * An affinity that differs from the calling thread's is applied in the
+	 * child, by starting argv through taskset; the application's threads
+	 * are never moved. Without taskset, the affinity is not applied.
+	 * The child is not reaped; pass pid to child_reaper or waitpid.
+	 * \return 0 or errno.
+	 */
+	static int spawn(const std::vector<std::string>& argv, const options& o, pid_t& pid) {
+		if (argv.empty())
+			return EINVAL;
+		std::vector<std::string> words;
+		cpu_set_t current;
+		if (o.affinity && !sched_getaffinity(0, sizeof(current), &current) &&
+			!CPU_EQUAL(&current, o.affinity) && have_taskset())
+			words = { "taskset", "-c", cpu_list(*o.affinity) };
+		std::vector<char *> args;
+		for (const auto& a : words)
+			args.push_back(const_cast<char *>(a.c_str()));
+		for (const auto& a : argv)
+			args.push_back(const_cast<char *>(a.c_str()));
+		args.push_back(nullptr);
+
+		posix_spawn_file_actions_t fa;
+		posix_spawn_file_actions_init(&fa);
+		if (o.stdin_fd >= 0)
+			posix_spawn_file_actions_adddup2(&fa, o.stdin_fd, 0);
+		if (o.stdout_fd >= 0) {
+			posix_spawn_file_actions_adddup2(&fa, o.stdout_fd, 1);
+			if (o.quiet)
+				posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+		} else if (o.quiet) {
+			posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+			posix_spawn_file_actions_adddup2(&fa, 1, 2);
+		}
+
+		int err = posix_spawnp(&pid, args[0], &fa, nullptr, args.data(), environ);
+		posix_spawn_file_actions_destroy(&fa);
+		return err;
+	}
+
+	/*! \brief start argv in the background and reap it asynchronously.
+	 * If cleanup is not empty, that file is removed when the child exits
+	 * (or only when it fails, if cleanup_on_success is false), or at once
+	 * if the child cannot be started. If done is set, it is then called
+	 * on the reaper thread with the wait status (or -1), unless the child
+	 * cannot be started.
+	 * \return 0 or errno.
+	 */
+	static int launch(const std::vector<std::string>& argv, const options& o,
+		const std::string& cleanup = "", bool cleanup_on_success = true,
+		std::function<void(int)> done = nullptr) {
+		pid_t pid;
+		int err = spawn(argv, o, pid);
+		if (err) {
+			if (cleanup.size())
+				unlink(cleanup.c_str());
+			return err;
+		}
+		child_reaper::instance().watch(pid, [cleanup, cleanup_on_success, done](int status) {
+			bool ok = status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+			if (cleanup.size() && (cleanup_on_success || !ok))
+				unlink(cleanup.c_str());
+			if (done)
+				done(status);
+		});
+		return 0;
+	}
+
+	/// \brief split a program option value on whitespace into argv words.
+	static std::vector<std::string> split_words(const std::string& s) {
+		std::vector<std::string> words;
+		std::stringstream ss(s);
+		std::string w;
+		while (ss >> w)
+			words.push_back(w);
+		return words;
+	}
+
+	/*! \brief hand msg to a child started by send(path, fd): in a memfd
+	 * given as fd and path stdin_path if use_memfd and memfd_create works,
+	 * else in a scratch file named by scratch() with fd -1, which the child
+	 * (or launch, if it fails) removes. send returns as launch does.
+	 * Failures are reported with the plugin name who.
+	 * \return 0, EAGAIN if send was refused for now, or 1.
+	 */
+	static int deliver(const std::string& msg, bool use_memfd,
+		const std::function<std::string()>& scratch,
+		const std::function<int(const std::string&, int)>& send, const char *who) {
+		int pfd;
+		int err;
+		if (use_memfd && !memfd_payload(msg, pfd)) {
+			err = send(stdin_path, pfd);
+			close(pfd);
+			return err == EAGAIN ? EAGAIN : (err ? 1 : 0);
+		}
+		std::string fname = scratch();
+		if (fname.empty())
+			return 1;
+		std::ofstream out(fname);
+		if (!out.good()) {
+			unlink(fname.c_str());
+			std::cout << who << " plugin failed open " << fname << std::endl;
+			return 1;
+		}
+		out << msg;
+		out.close();
+		if (!out.good()) {
+			unlink(fname.c_str());
+			std::cout << who << " plugin failed write to " << fname << std::endl;
+			return 1;
+		}
+		err = send(fname, -1);
+		return err == EAGAIN ? EAGAIN : (err ? 1 : 0);
+	}
+};
+
+/*! \brief Bounded background launcher for publishers that run a program
+  per message, so a burst of messages cannot start a process each at once.
+  At most max_inflight children run at a time; later launches wait in a
+  FIFO queue of at most max_queued, and are started on the reaper thread
+  as children exit. The outcomes are counted in the publisher_stats
+  given to attach: exit codes, the most children running and waiting,
+  and, for launches that capture stdout, the HTTP status the child
+  prints last (as curl -w does). Queued launches still run after the
+  publisher is destroyed; those queued when the process exits are lost.
+ */
+class launch_limiter {
+	struct job {
+		std::vector<std::string> argv;
+		cpu_set_t affinity;
+		bool use_affinity;
+		bool quiet;
+		int stdin_fd;	// owned by the job
+		std::string cleanup;
+		bool capture;
+		std::function<void(int)> done;
+	};
+
+	struct shared {
+		std::mutex lock;
+		size_t max_inflight = 16;
+		size_t max_queued = 1024;
+		size_t inflight = 0;
+		std::deque<job> queue;
+		publisher_stats *stats = nullptr;
+	};
+
+	std::shared_ptr<shared> sh;
+
+	// the last number in what the child wrote to fd.
+	static int read_code(int fd) {
+		char buf[64];
+		struct stat sb;
+		if (fstat(fd, &sb) || sb.st_size <= 0)
+			return 0;
+		off_t at = sb.st_size > (off_t)sizeof(buf) ? sb.st_size - (off_t)sizeof(buf) : 0;
+		ssize_t n = pread(fd, buf, sizeof(buf), at);
+		int code = 0;
+		int scale = 1;
+		bool digits = false;
+		for (ssize_t i = n - 1; i >= 0; i--) {
+			if (buf[i] >= '0' && buf[i] <= '9') {
+				code += (buf[i] - '0') * scale;
+				scale *= 10;
+				digits = true;
+			} else if (digits) {
+				break;
+			}
+		}
+		return code;
+	}
+
+	static int exit_code(int status) {
+		if (status < 0)
+			return -1;
+		if (WIFEXITED(status))
+			return WEXITSTATUS(status);
+		if (WIFSIGNALED(status))
+			return 128 + WTERMSIG(status);
+		return -1;
+	}
+
+	// start j; on success its done and cleanup are moved to the reaper.
+	// \return 0 or errno.
+	static int start(const std::shared_ptr<shared>& sh, job& j) {
+		subprocess::options o;
+		o.stdin_fd = j.stdin_fd;
+		o.quiet = j.quiet;
+		o.affinity = j.use_affinity ? &j.affinity : nullptr;
+		int out = -1;
+		if (j.capture && !subprocess::memfd_payload("", out))
+			o.stdout_fd = out;
+		pid_t pid;
+		int err = subprocess::spawn(j.argv, o, pid);
+		if (j.stdin_fd >= 0) {
+			close(j.stdin_fd);
+			j.stdin_fd = -1;
+		}
+		if (err) {
+			if (out >= 0)
+				close(out);
+			return err;
+		}
+		child_reaper::instance().watch(pid, [sh, out, cleanup = std::move(j.cleanup),
+			done = std::move(j.done)](int status) {
+			if (cleanup.size())
+				unlink(cleanup.c_str());
+			int http = 0;
+			if (out >= 0) {
+				http = read_code(out);
+				close(out);
+			}
+			finished(sh, exit_code(status), http);
+			if (done)
+				done(status);
+		});
+		return 0;
+	}
+
+	// count a finished child and start queued jobs in its place.
+	static void finished(const std::shared_ptr<shared>& sh, int code, int http) {
+		std::unique_lock<std::mutex> g(sh->lock);
+		if (sh->stats) {
+			sh->stats->record_delivery(code);
+			if (http)
+				sh->stats->record_http_code(http);
+		}
+		sh->inflight--;
+		while (sh->inflight < sh->max_inflight && !sh->queue.empty()) {
+			job j = std::move(sh->queue.front());
+			sh->queue.pop_front();
+			sh->inflight++;
+			g.unlock();
+			int err = start(sh, j);
+			g.lock();
+			if (err) {
+				sh->inflight--;
+				if (sh->stats)
+					sh->stats->record_delivery(-1);
+				g.unlock();
+				if (j.cleanup.size())
+					unlink(j.cleanup.c_str());
+				if (j.done)
+					j.done(-1);
+				g.lock();
+			}
+		}
+	}
+
+public:
+	launch_limiter() : sh(std::make_shared<shared>()) { }
+
+	launch_limiter(const launch_limiter&) = delete;
+	launch_limiter& operator=(const launch_limiter&) = delete;
+
+	~launch_limiter() {
+		attach(nullptr);
+	}
+
+	/// \brief set the limits. \return 0, or EINVAL if max_inflight is 0.
+	int configure(size_t max_inflight, size_t max_queued) {
+		if (!max_inflight)
+			return EINVAL;
+		std::lock_guard<std::mutex> g(sh->lock);
+		sh->max_inflight = max_inflight;
+		sh->max_queued = max_queued;
+		return 0;
+	}
+
+	/// \brief count outcomes in stats, or stop counting if it is null.
+	void attach(publisher_stats *stats) {
+		std::lock_guard<std::mutex> g(sh->lock);
+		sh->stats = stats;
+	}
+
+	/*! \brief start argv now if under the limit, or queue it.
+	 * As subprocess::launch, but o.stdin_fd is duplicated, so the caller
+	 * closes its own at once, and with capture the child's stdout is kept
+	 * to read an HTTP status from at exit.
+	 * \return 0 if started or queued, EAGAIN if the queue is full, or
+	 * errno. On error, cleanup is removed and done is not called.
+	 */
+	int launch(const std::vector<std::string>& argv, const subprocess::options& o,
+		const std::string& cleanup, bool capture, std::function<void(int)> done) {
+		job j;
+		j.argv = argv;
+		j.use_affinity = o.affinity != nullptr;
+		if (j.use_affinity)
+			j.affinity = *o.affinity;
+		j.quiet = o.quiet;
+		j.stdin_fd = -1;
+		j.cleanup = cleanup;
+		j.capture = capture;
+		j.done = done;
+		std::unique_lock<std::mutex> g(sh->lock);
+		if (sh->inflight < sh->max_inflight) {
+			sh->inflight++;
+			if (sh->stats)
+				sh->stats->record_backlog(sh->inflight, sh->queue.size());
+			g.unlock();
+			if (o.stdin_fd >= 0)
+				j.stdin_fd = fcntl(o.stdin_fd, F_DUPFD_CLOEXEC, 0);
+			int err = (o.stdin_fd >= 0 && j.stdin_fd < 0) ? errno : start(sh, j);
+			if (err) {
+				if (j.stdin_fd >= 0)
+					close(j.stdin_fd);
+				if (cleanup.size())
+					unlink(cleanup.c_str());
+				g.lock();
+				sh->inflight--;
+			}
+			return err;
+		}
+		if (sh->queue.size() >= sh->max_queued) {
+			g.unlock();
+			if (cleanup.size())
+				unlink(cleanup.c_str());
+			return EAGAIN;
+		}
+		if (o.stdin_fd >= 0) {
+			j.stdin_fd = fcntl(o.stdin_fd, F_DUPFD_CLOEXEC, 0);
+			if (j.stdin_fd < 0) {
+				int err = errno;
+				g.unlock();
+				if (cleanup.size())
+					unlink(cleanup.c_str());
+				return err;
+			}
+		}
+		sh->queue.push_back(std::move(j));
+		if (sh->stats)
+			sh->stats->record_backlog(sh->inflight, sh->queue.size());
+		return 0;
+	}
+};
+
+} // adc
+#endif // adc_subprocess_ipp
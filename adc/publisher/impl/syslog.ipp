@@ -6,7 +6,16 @@
 #include <syslog.h>
 #include <adc/builder/builder.hpp>
 #include <adc/publisher/publisher.hpp>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <uuid/uuid.h>
 
 namespace adc {
 
@@ -32,27 +41,53 @@ int get_priority_from_string(string s)
 
 
 /*! \brief syslog publisher_api implementation.
-  This plugin sends messages to syslog synchronously.
-  Multiple independent instances of this plugin may be used simultaneously,
-  but the underlying syslog setting (priority) will be that
-  of the most recently created instance unless a map with "PRIORITY" is supplied
-  to config().
+  With TRANSPORT "syslog" (the default), this plugin sends messages with
+  syslog(3), synchronously. Multiple independent instances of this plugin
+  may be used simultaneously, but the underlying syslog setting (priority)
+  will be that of the most recently created instance unless a map with
+  "PRIORITY" is supplied to config().
+
+  With TRANSPORT "socket", messages are written as RFC 5424 frames
+     <PRI>1 TIMESTAMP HOSTNAME ADC PID adc SD MSG
+  directly to the datagram socket SOCKET (default /dev/log), without
+  blocking. A frame is at most CHUNK_SIZE bytes (default 8192); a larger
+  message is split into chunks, each with the structured data
+     [adc@32473 uuid="..." seq="1" total="N"]
+  sharing one uuid, so a collector can reassemble the json. SD is "-"
+  for unsplit messages. If the socket is full, the rest of the message is
+  dropped, the drop is counted, and publish returns EAGAIN. On Linux the
+  listener's queue holds net.unix.max_dgram_qlen (often 10) datagrams, so
+  CHUNK_SIZE should be large enough that typical messages need few chunks.
 
   If not configured, the default priority is LOG_INFO.
   env("ADC_SYSLOG_PLUGIN_PRIORITY") overrides the default
   if defined with a priority string from
-  /usr/include/sys/syslog.h.
+  /usr/include/sys/syslog.h. Other options are overridden with
+  env("ADC_SYSLOG_PLUGIN_$OPTION").
  */
-class syslog_plugin : public publisher_api {
+class syslog_plugin : public publisher_api, public counted_publisher {
 
 private:
 	inline static const std::map< const string, const string > plugin_syslog_config_defaults =
-		{{ "PRIORITY", "info"} };
+		{{ "PRIORITY", "info"},
+		{ "TRANSPORT", "syslog"},
+		{ "SOCKET", "/dev/log"},
+		{ "CHUNK_SIZE", "8192"},
+		{ "DEBUG", "0"} };
 	inline static const char *plugin_prefix = "ADC_SYSLOG_PLUGIN_";
+	// the structured data id; 32473 is the documentation enterprise number.
+	inline static const char *sd_id = "adc@32473";
 	const string vers;
 	const std::vector<string> tags;
 	int priority;
 	bool paused;
+	bool direct;
+	string path;
+	size_t chunk_size;
+	int sock;
+	string host;
+	uint64_t dropped;
+	int debug;
 
 	int config(string p) {
 		priority = get_priority_from_string(std::move(p));
@@ -76,8 +111,132 @@ private:
 		}
 	}
 
+	// (re)connect the datagram socket to path. \return 0 or errno.
+	int open_socket() {
+		if (sock >= 0)
+			close(sock);
+		sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+		if (sock < 0)
+			return errno;
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(sa.sun_path)) {
+			close(sock);
+			sock = -1;
+			return ENAMETOOLONG;
+		}
+		memcpy(sa.sun_path, path.c_str(), path.size());
+		if (connect(sock, (struct sockaddr *)&sa, sizeof(sa))) {
+			int err = errno;
+			close(sock);
+			sock = -1;
+			return err;
+		}
+		return 0;
+	}
+
+	// the RFC 5424 header through the structured data, ending in a space.
+	string frame_header(const string& stamp, const char *id, size_t seq, size_t total) {
+		string h = "<" + std::to_string(LOG_USER | priority) + ">1 " + stamp + " " +
+			host + " ADC " + std::to_string(getpid()) + " adc ";
+		if (total > 1) {
+			h += "[";
+			h += sd_id;
+			h += " uuid=\"";
+			h += id;
+			h += "\" seq=\"" + std::to_string(seq) + "\" total=\"" +
+				std::to_string(total) + "\"] ";
+		} else {
+			h += "- ";
+		}
+		return h;
+	}
+
+	static string timestamp() {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		struct tm t;
+		gmtime_r(&ts.tv_sec, &t);
+		char buf[40];
+		size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &t);
+		snprintf(buf + n, sizeof(buf) - n, ".%06ldZ", ts.tv_nsec / 1000);
+		return buf;
+	}
+
+	// send one frame. \return 0 or errno; reconnects once if the listener restarted.
+	int send_frame(const string& f) {
+		for (int attempt = 0; attempt < 2; attempt++) {
+			if (sock < 0) {
+				int err = open_socket();
+				if (err)
+					return err;
+			}
+			ssize_t n = send(sock, f.data(), f.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (n >= 0)
+				return 0;
+			int err = errno;
+			if (err != ECONNREFUSED && err != ENOTCONN)
+				return err;
+			close(sock);
+			sock = -1;
+		}
+		return ECONNREFUSED;
+	}
+
+	void set_host() {
+		char hn[256];
+		if (gethostname(hn, sizeof(hn)) || !hn[0])
+			strcpy(hn, "-");
+		hn[sizeof(hn) - 1] = '\0';
+		host = hn;
+	}
+
+	int publish_direct(const string& msg) {
+		if (host.empty())
+			set_host();
+		string stamp = timestamp();
+		char id[40] = "";
+		size_t total = 1;
+		size_t per;
+		// the header length depends on the chunk count; grow it until the chunks fit.
+		for (;;) {
+			size_t hlen = frame_header(stamp, total > 1 ? "00000000-0000-0000-0000-000000000000" : "",
+				total, total).size();
+			if (hlen >= chunk_size) {
+				dropped++;
+				return EMSGSIZE;
+			}
+			per = chunk_size - hlen;
+			size_t need = msg.size() ? (msg.size() + per - 1) / per : 1;
+			if (need <= total)
+				break;
+			total = need;
+		}
+		if (total > 1) {
+			uuid_t uuid;
+			uuid_generate_random(uuid);
+			uuid_unparse_lower(uuid, id);
+		}
+		for (size_t seq = 1; seq <= total; seq++) {
+			string f = frame_header(stamp, id, seq, total);
+			f.append(msg, (seq - 1) * per, per);
+			int err = send_frame(f);
+			if (err) {
+				dropped++;
+				if (debug) {
+					std::cout << "syslog plugin dropped message " << dropped << ": "
+						<< std::strerror(err) << std::endl;
+				}
+				return (err == EWOULDBLOCK) ? EAGAIN : err;
+			}
+		}
+		return 0;
+	}
+
 public:
-	syslog_plugin() : vers("1.0.0") , tags({"none"}), priority(PRIORITY_UNSET_ADC_SYSLOG), paused(false) {
+	syslog_plugin() : vers("1.0.0") , tags({"none"}), priority(PRIORITY_UNSET_ADC_SYSLOG), paused(false),
+		direct(false), chunk_size(8192), sock(-1), dropped(0), debug(0) {
 		openlog("ADC", LOG_PID, LOG_USER);
 
 	}
@@ -89,7 +248,9 @@ public:
 			return 0;
 		if (priority == PRIORITY_UNSET_ADC_SYSLOG)
 			priority = LOG_INFO;
-		auto str = b->serialize();
+		auto str = counted_serialize(b);
+		if (direct)
+			return publish_direct(str);
 		syslog(priority, "%s", str.c_str());
 		return 0;
 	}
@@ -100,21 +261,48 @@ public:
 
         int config(const std::map< std::string, std::string >& m, std::string_view env_prefix) {
 		string p = get(m, "PRIORITY", env_prefix);
+		string t = get(m, "TRANSPORT", env_prefix);
+		if (t != "syslog" && t != "socket")
+			return EINVAL;
+		std::stringstream cs(get(m, "CHUNK_SIZE", env_prefix));
+		std::stringstream ds(get(m, "DEBUG", env_prefix));
+		cs >> chunk_size;
+		ds >> debug;
+		if (cs.fail() || chunk_size < 256)
+			return EINVAL;
+		direct = (t == "socket");
+		path = get(m, "SOCKET", env_prefix);
 		return config(std::move(p));
 	}
-        
+
 	const std::map< const std::string, const std::string> & get_option_defaults() {
 		return plugin_syslog_config_defaults;
 	}
-        
+
 	int initialize() {
 		std::map <string, string >m;
 		if (priority == PRIORITY_UNSET_ADC_SYSLOG)
 			config(m);
+		if (direct) {
+			set_host();
+			int err = open_socket();
+			if (err) {
+				// retried at each publish; the listener may start later.
+				std::cout << "syslog plugin: unable to connect " << path << ": "
+					<< std::strerror(err) << std::endl;
+			}
+		}
 		return 0;
 	}
 
         void finalize() {
+		if (sock >= 0) {
+			close(sock);
+			sock = -1;
+		}
+		if (dropped && debug) {
+			std::cout << "syslog plugin dropped " << dropped << " messages" << std::endl;
+		}
 	}
 
 	void pause() {
@@ -134,6 +322,8 @@ public:
 	}
 
 	~syslog_plugin() {
+		if (sock >= 0)
+			close(sock);
 		closelog();
 	}
 };
@@ -0,0 +1,273 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_uds_ipp
+#define adc_uds_ipp
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace adc {
+
+using std::cout;
+
+typedef std::string string;
+typedef std::string_view string_view;
+
+
+/*! \brief Unix domain socket publisher_api implementation.
+  This plugin sends each message as one SOCK_SEQPACKET packet to a
+  node-local aggregator (adc.aggregator) listening on SOCKET (by default
+  /dev/shm/adc/$uid/adc.aggregator.sock, as in default_socket()), which
+  batches the messages of all local processes and forwards them through
+  its own publishers. Publishing costs one non-blocking send.
+
+  If the aggregator is busy and the socket is full, the message is
+  dropped, the drop is counted, and publish returns EAGAIN. If the
+  aggregator is not running, publish returns ENOTCONN and the connection
+  is retried at publish no more often than every RETRY_MS (default 1000).
+  A message larger than the socket send buffer fails with EMSGSIZE.
+
+  Multiple independent instances of this plugin may be used simultaneously.
+  Options are overridden with env("ADC_UDS_PLUGIN_$OPTION").
+ */
+class uds_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+public:
+	/// \brief default aggregator socket; empty selects default_socket().
+	/// Overridden with env("ADC_UDS_PLUGIN_SOCKET").
+	inline static const char *adc_uds_plugin_socket_default = "";
+
+	/// \brief the aggregator socket of the effective user; each user on a
+	/// node runs their own adc.aggregator.
+	static string default_socket() {
+		return "/dev/shm/adc/" + std::to_string(geteuid()) + "/adc.aggregator.sock";
+	}
+
+	/// \brief ADC uds plugin enable debug messages; (default "0": none)
+	/// Overridden with env("ADC_UDS_PLUGIN_DEBUG").
+	inline static const char *adc_uds_plugin_debug_default = "0";
+
+private:
+	inline static const char *plugin_prefix = "ADC_UDS_PLUGIN_";
+	inline static const std::map< const string, const string > plugin_config_defaults =
+	{	{"SOCKET", adc_uds_plugin_socket_default},
+		{"RETRY_MS", "1000"},
+		{"DEBUG", adc_uds_plugin_debug_default}
+	};
+
+	const string vers;
+	const std::vector<string> tags;
+	string path;
+	long retry_ms;
+	int sock;
+	std::chrono::steady_clock::time_point last_try;
+	uint64_t dropped;
+	int debug;
+	enum state state;
+	bool paused;
+	enum mode mode;
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	void disconnect() {
+		if (sock >= 0)
+			close(sock);
+		sock = -1;
+	}
+
+	// connect to the aggregator. \return 0 or errno.
+	int connect_socket() {
+		disconnect();
+		last_try = std::chrono::steady_clock::now();
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(sa.sun_path))
+			return ENAMETOOLONG;
+		memcpy(sa.sun_path, path.c_str(), path.size());
+		sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+		if (sock < 0)
+			return errno;
+		if (connect(sock, (struct sockaddr *)&sa, sizeof(sa))) {
+			int e = errno;
+			disconnect();
+			return e;
+		}
+		// the aggregator never replies.
+		shutdown(sock, SHUT_RD);
+		return 0;
+	}
+
+	// connect if disconnected and RETRY_MS has passed. \return true if connected.
+	bool ready() {
+		if (sock >= 0)
+			return true;
+		auto since = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - last_try).count();
+		if (since < retry_ms)
+			return false;
+		int e = connect_socket();
+		if (e && debug) {
+			std::cout << "uds plugin: unable to connect " << path << ": "
+				<< std::strerror(e) << std::endl;
+		}
+		return !e;
+	}
+
+public:
+	uds_plugin() : vers("1.0.0") , tags({"none"}), retry_ms(1000), sock(-1), dropped(0),
+		debug(0), state(ok), paused(false), mode(pi_config) { }
+
+        int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		string m = counted_serialize(b);
+		// a second attempt follows a reconnect after the aggregator restarted.
+		for (int attempt = 0; attempt < 2; attempt++) {
+			if (!ready()) {
+				dropped++;
+				return ENOTCONN;
+			}
+			ssize_t n = send(sock, m.data(), m.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (n >= 0)
+				return 0;
+			int e = errno;
+			if (e == EAGAIN || e == EWOULDBLOCK || e == EMSGSIZE) {
+				dropped++;
+				if (debug > 1) {
+					std::cout << "uds plugin dropped " << dropped << ": "
+						<< std::strerror(e) << std::endl;
+				}
+				return e == EMSGSIZE ? e : EAGAIN;
+			}
+			disconnect();
+			if (attempt == 0)
+				last_try = std::chrono::steady_clock::time_point();
+		}
+		dropped++;
+		return ENOTCONN;
+	}
+
+        int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_prefix);
+	}
+
+        int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		if (mode != pi_config)
+			return 2;
+		path = get(m, "SOCKET", env_prefix);
+		if (path.empty())
+			path = default_socket();
+		std::stringstream rs(get(m, "RETRY_MS", env_prefix));
+		std::stringstream ds(get(m, "DEBUG", env_prefix));
+		rs >> retry_ms;
+		ds >> debug;
+		if (rs.fail() || retry_ms < 0)
+			return EINVAL;
+		if (debug < 0)
+			debug = 0;
+		mode = pi_init;
+		return 0;
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		if (!path.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		int e = connect_socket();
+		if (e) {
+			// not fatal; the aggregator may start later.
+			std::cout << "uds plugin: unable to connect " << path << ": "
+				<< std::strerror(e) << std::endl;
+		}
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+        void finalize() {
+		if (mode == pi_pub_or_final) {
+			disconnect();
+			if (dropped && debug) {
+				std::cout << "uds plugin dropped " << dropped << " messages" << std::endl;
+			}
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "uds plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+        void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "uds";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~uds_plugin() {
+		disconnect();
+	}
+};
+
+} // adc
+#endif // adc_uds_ipp
@@ -0,0 +1,659 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <adc/builder/builder.hpp>
+#include <adc/publisher/publisher.hpp>
+#include <adc/publisher/impl/record_writer.ipp>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef ADC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace adc {
+
+using std::string;
+using std::string_view;
+
+/*! \brief io_uring asynchronous file output publisher_api implementation.
+  This plugin writes each message to the configured file, with
+  \<adct-json>\</adct-json> delimiters surrounding it, as the file plugin does.
+  Messages are copied into one of QUEUE_DEPTH registered buffers of
+  BUFFER_SIZE bytes each and written with IORING_OP_WRITE_FIXED at explicit
+  file offsets. Completions are reaped in batches, without a system call
+  when they are already posted; publish waits only when the next buffer
+  is still being written. A message larger than BUFFER_SIZE is written
+  synchronously after the outstanding writes complete.
+
+  Options (each overridden with env("ADC_URINGFILE_PLUGIN_$OPTION")):
+  - DIRECTORY: output directory (default ".").
+  - FILE: output file name (default adc.uringfile_plugin.log).
+  - APPEND: "true" to append to an existing file (default "false").
+  - QUEUE_DEPTH: registered buffers and ring entries (default 8).
+  - BUFFER_SIZE: bytes per registered buffer (default 1048576).
+  - FLUSH: "buffer" (default) submits only when a buffer fills or at
+    finalize, so a publish costs no system call until then; "record"
+    submits each message as it is published, a system call each, so that
+    less is lost if the process dies.
+  - DEBUG: debugging output if a number greater than 0.
+
+  A write that fails asynchronously is reported as its errno by the
+  return of the next publish call. Since finalize cannot return a value,
+  errors found while draining at finalize are printed to std::cerr.
+
+  If io_uring is not available (not compiled in, or the kernel refuses
+  io_uring_setup or buffer registration), the plugin falls back to the
+  record_writer path used by the file plugin, with its "finalize" flush
+  policy and a BUFFER_SIZE buffer for FLUSH=buffer, or its "record" policy.
+ */
+class uringfile_plugin : public publisher_api, public counted_publisher {
+	enum state {
+		ok,
+		err
+	};
+	enum mode {
+		/* the next mode needed for correct operation */
+		pi_config,
+		pi_init,
+		pi_pub_or_final
+	};
+
+	/* a registered buffer; bytes [0,submitted) are in flight or done. */
+	struct rbuf {
+		char *data;
+		size_t used;
+		size_t submitted;
+		unsigned inflight;
+	};
+
+	/* a submitted write, indexed by sqe user_data. */
+	struct op {
+		unsigned buf;
+		size_t boff;
+		size_t len;
+		uint64_t foff;
+		bool busy;
+	};
+
+private:
+	inline static const std::map< const string, const string > plugin_uringfile_config_defaults =
+		{{ "DIRECTORY", "."},
+		 { "FILE", "adc.uringfile_plugin.log" },
+		 { "APPEND", "false" },
+		 { "QUEUE_DEPTH", "8" },
+		 { "BUFFER_SIZE", "1048576" },
+		 { "FLUSH", "buffer" },
+		 { "DEBUG", "0" }
+		};
+	inline static const char *plugin_uringfile_prefix = "ADC_URINGFILE_PLUGIN_";
+	const string vers;
+	const std::vector<string> tags;
+	string fname;
+	string fdir;
+	bool fappend;
+	bool submit_each;
+	unsigned depth;
+	size_t bsize;
+	int debug;
+	enum state state;
+	bool paused;
+	enum mode mode;
+
+	// output used by both paths
+	int fd;
+	uint64_t file_off;
+	int async_err;
+	bool use_ring;
+	record_writer fallback;
+
+#ifdef ADC_HAVE_IO_URING
+	int ring_fd;
+	void *sq_map;
+	size_t sq_map_len;
+	void *cq_map;
+	size_t cq_map_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	struct io_uring_cqe *cqes;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	unsigned sq_entries;
+	unsigned inflight;
+	char *pool;
+	std::vector<rbuf> bufs;
+	std::vector<op> ops;
+	unsigned cur;
+#endif
+
+	int config(const string dir, const string file, bool append, const string& sdepth,
+		const string& sbsize, const string& sflush, const string& sdebug) {
+		if (mode != pi_config)
+			return 2;
+		std::stringstream ssd(sdepth), ssb(sbsize);
+		ssd >> depth;
+		ssb >> bsize;
+		if (ssd.fail() || ssb.fail() || !depth || !bsize)
+			return EINVAL;
+		if (sflush == "record") {
+			submit_each = true;
+		} else if (sflush == "buffer") {
+			submit_each = false;
+		} else {
+			return EINVAL;
+		}
+		fname = file;
+		fdir = dir;
+		fappend = append;
+		mode = pi_init;
+		std::stringstream ss(sdebug);
+		ss >> debug;
+		if (debug < 0) {
+			debug = 0;
+		}
+		if (debug > 0) {
+			std::cout<< "uringfile plugin configured" <<std::endl;
+		}
+		return 0;
+	}
+
+	// find field in m, then with prefix in env, then the default.
+	const string get(const std::map< string, string >& m,
+			string field, string_view env_prefix) {
+		// fields not defined in config_defaults raise an exception.
+		auto it = m.find(field);
+		if (it != m.end()) {
+			return it->second;
+		}
+		string en = string(env_prefix) += field;
+		char *ec = getenv(en.c_str());
+		if (!ec) {
+			return plugin_uringfile_config_defaults.at(field);
+		} else {
+			return string(ec);
+		}
+	}
+
+	// write all iov content at off, resuming after partial writes and EINTR.
+	static int pwritev_all(int wfd, struct iovec *iov, int iovcnt, uint64_t off)
+	{
+		while (iovcnt > 0) {
+			ssize_t n = ::pwritev(wfd, iov, iovcnt, off);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			off += n;
+			size_t done = static_cast<size_t>(n);
+			while (iovcnt > 0 && done >= iov->iov_len) {
+				done -= iov->iov_len;
+				iov++;
+				iovcnt--;
+			}
+			if (iovcnt > 0) {
+				iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+				iov->iov_len -= done;
+			}
+		}
+		return 0;
+	}
+
+	void note_error(int e) {
+		if (e && !async_err)
+			async_err = e;
+	}
+
+	// return and clear the first unreported asynchronous error.
+	int take_error() {
+		int e = async_err;
+		async_err = 0;
+		return e;
+	}
+
+#ifdef ADC_HAVE_IO_URING
+	static int sys_setup(unsigned entries, struct io_uring_params *p) {
+		return (int)syscall(__NR_io_uring_setup, entries, p);
+	}
+
+	static int sys_enter(int rfd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+		return (int)syscall(__NR_io_uring_enter, rfd, to_submit, min_complete, flags, NULL, 0);
+	}
+
+	static int sys_register(int rfd, unsigned opcode, const void *arg, unsigned nr_args) {
+		return (int)syscall(__NR_io_uring_register, rfd, opcode, arg, nr_args);
+	}
+
+	/* map the rings and register the buffer pool.
+	 * \return 0 or errno; on error the caller calls ring_close and falls back.
+	 */
+	int ring_open() {
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		ring_fd = sys_setup(depth, &p);
+		if (ring_fd < 0) {
+			ring_fd = -1;
+			return errno;
+		}
+		sq_entries = p.sq_entries;
+		sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		if (single) {
+			sq_map_len = std::max(sq_map_len, cq_map_len);
+		}
+		void *m = mmap(nullptr, sq_map_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		if (m == MAP_FAILED) {
+			return errno;
+		}
+		sq_map = m;
+		if (single) {
+			cq_map = sq_map;
+		} else {
+			m = mmap(nullptr, cq_map_len, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+			if (m == MAP_FAILED) {
+				return errno;
+			}
+			cq_map = m;
+		}
+		sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+		m = mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		if (m == MAP_FAILED) {
+			return errno;
+		}
+		sqes = static_cast<struct io_uring_sqe *>(m);
+		char *sq = static_cast<char *>(sq_map);
+		char *cq = static_cast<char *>(cq_map);
+		sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+		sq_mask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+		cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+		cq_mask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+		cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+
+		m = mmap(nullptr, depth * bsize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (m == MAP_FAILED) {
+			return errno;
+		}
+		pool = static_cast<char *>(m);
+		std::vector<struct iovec> iov(depth);
+		bufs.assign(depth, rbuf{nullptr, 0, 0, 0});
+		for (unsigned i = 0; i < depth; i++) {
+			bufs[i].data = pool + i * bsize;
+			iov[i].iov_base = bufs[i].data;
+			iov[i].iov_len = bsize;
+		}
+		if (sys_register(ring_fd, IORING_REGISTER_BUFFERS, iov.data(), depth) < 0) {
+			return errno;
+		}
+		ops.assign(sq_entries, op{0, 0, 0, 0, false});
+		cur = 0;
+		inflight = 0;
+		return 0;
+	}
+
+	void ring_close() {
+		if (pool) {
+			munmap(pool, depth * bsize);
+			pool = nullptr;
+		}
+		if (sqes) {
+			munmap(sqes, sqes_len);
+			sqes = nullptr;
+		}
+		if (cq_map && cq_map != sq_map) {
+			munmap(cq_map, cq_map_len);
+		}
+		cq_map = nullptr;
+		if (sq_map) {
+			munmap(sq_map, sq_map_len);
+			sq_map = nullptr;
+		}
+		if (ring_fd >= 0) {
+			close(ring_fd);
+			ring_fd = -1;
+		}
+		bufs.clear();
+		ops.clear();
+		inflight = 0;
+	}
+
+	/* account for one completion; a short write is finished synchronously. */
+	void complete(uint64_t idx, int res) {
+		op& o = ops[idx];
+		if (res < 0) {
+			note_error(-res);
+		} else if ((size_t)res < o.len) {
+			struct iovec iov = { bufs[o.buf].data + o.boff + res, o.len - res };
+			note_error(pwritev_all(fd, &iov, 1, o.foff + res));
+		}
+		bufs[o.buf].inflight--;
+		o.busy = false;
+		inflight--;
+	}
+
+	/* consume posted completions, waiting until at least min_complete are seen.
+	 * returns errno if waiting fails, leaving the rest in flight. */
+	int reap(unsigned min_complete) {
+		while (true) {
+			unsigned head = *cq_head;
+			unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+			unsigned got = 0;
+			while (head != tail) {
+				struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+				complete(cqe->user_data, cqe->res);
+				head++;
+				got++;
+			}
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+			if (got >= min_complete || !inflight)
+				return 0;
+			min_complete -= got;
+			if (sys_enter(ring_fd, 0, min_complete, IORING_ENTER_GETEVENTS) < 0
+				&& errno != EINTR)
+				return errno;
+		}
+	}
+
+	/* submit the unsubmitted tail of the current buffer. */
+	int submit_current() {
+		rbuf& b = bufs[cur];
+		if (b.used == b.submitted)
+			return 0;
+		if (inflight == sq_entries) {
+			int e = reap(1);
+			if (e)
+				return e;
+		}
+		unsigned oi = 0;
+		while (ops[oi].busy)
+			oi++;
+		size_t len = b.used - b.submitted;
+		ops[oi] = op{cur, b.submitted, len, file_off, true};
+
+		unsigned tail = *sq_tail;
+		unsigned si = tail & *sq_mask;
+		struct io_uring_sqe *sqe = &sqes[si];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->fd = fd;
+		sqe->off = file_off;
+		sqe->addr = (uint64_t)(uintptr_t)(b.data + b.submitted);
+		sqe->len = len;
+		sqe->buf_index = cur;
+		sqe->user_data = oi;
+		sq_array[si] = si;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+		while (sys_enter(ring_fd, 1, 0, 0) < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN || errno == EBUSY) && inflight && !reap(1))
+				continue;
+			/* the kernel took nothing: withdraw the entry and write it here. */
+			__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+			ops[oi].busy = false;
+			struct iovec iov = { b.data + b.submitted, len };
+			int e = pwritev_all(fd, &iov, 1, file_off);
+			file_off += len;
+			b.submitted = b.used;
+			return e;
+		}
+		file_off += len;
+		b.submitted = b.used;
+		b.inflight++;
+		inflight++;
+		return 0;
+	}
+
+	/* submit everything and wait for all writes to complete. */
+	int drain() {
+		int e = submit_current();
+		while (inflight && !e)
+			e = reap(inflight);
+		return e;
+	}
+
+	int ring_write(string_view prefix, string_view payload, string_view suffix) {
+		size_t len = prefix.size() + payload.size() + suffix.size();
+		if (len > bsize) {
+			int e = drain();
+			if (e)
+				return e;
+			struct iovec iov[3] = {
+				{ const_cast<char *>(prefix.data()), prefix.size() },
+				{ const_cast<char *>(payload.data()), payload.size() },
+				{ const_cast<char *>(suffix.data()), suffix.size() } };
+			e = pwritev_all(fd, iov, 3, file_off);
+			file_off += len;
+			return e;
+		}
+		if (bufs[cur].used + len > bsize) {
+			int e = submit_current();
+			if (e)
+				return e;
+			cur = (cur + 1) % depth;
+			while (bufs[cur].inflight) {
+				e = reap(1);
+				if (e)
+					return e;
+			}
+			bufs[cur].used = 0;
+			bufs[cur].submitted = 0;
+		}
+		rbuf& b = bufs[cur];
+		char *dst = b.data + b.used;
+		memcpy(dst, prefix.data(), prefix.size());
+		dst += prefix.size();
+		memcpy(dst, payload.data(), payload.size());
+		dst += payload.size();
+		memcpy(dst, suffix.data(), suffix.size());
+		b.used += len;
+		if (submit_each) {
+			int e = submit_current();
+			if (e)
+				return e;
+		}
+		if (inflight)
+			reap(0);
+		return 0;
+	}
+#endif
+
+public:
+	uringfile_plugin() : vers("1.0.0") , tags({"none"}), fappend(false), submit_each(true),
+		depth(0), bsize(0), debug(0), state(ok), paused(false), mode(pi_config),
+		fd(-1), file_off(0), async_err(0), use_ring(false)
+#ifdef ADC_HAVE_IO_URING
+		, ring_fd(-1), sq_map(nullptr), sq_map_len(0), cq_map(nullptr), cq_map_len(0),
+		sqes(nullptr), sqes_len(0), cqes(nullptr), sq_tail(nullptr), sq_mask(nullptr),
+		sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr),
+		sq_entries(0), inflight(0), pool(nullptr), cur(0)
+#endif
+		{ }
+
+	int publish(std::shared_ptr<builder_api> b) {
+		if (!b)
+			return EINVAL;
+		if (paused)
+			return 0;
+		if (state != ok)
+			return 1;
+		if (mode != pi_pub_or_final)
+			return 2;
+		string payload = counted_serialize(b);
+		int e;
+#ifdef ADC_HAVE_IO_URING
+		if (use_ring) {
+			e = ring_write("<adct-json>", payload, "</adct-json>\n");
+			note_error(e);
+			e = take_error();
+		} else
+#endif
+		{
+			e = fallback.write_record("<adct-json>", payload, "</adct-json>\n");
+		}
+		if (debug > 1) {
+			std::cout << "'uringfile' wrote" << std::endl;
+		}
+		return e;
+	}
+
+	int config(const std::map< std::string, std::string >& m) {
+		return config(m, plugin_uringfile_prefix);
+	}
+
+	int config(const std::map< std::string, std::string >& m, string_view env_prefix) {
+		string d = get(m, "DIRECTORY", env_prefix);
+		string f = get(m, "FILE", env_prefix);
+		bool app = ( get(m, "APPEND", env_prefix) == "true");
+		string sdepth = get(m, "QUEUE_DEPTH", env_prefix);
+		string sbsize = get(m, "BUFFER_SIZE", env_prefix);
+		string sflush = get(m, "FLUSH", env_prefix);
+		string sdebug = get(m, "DEBUG", env_prefix);
+		return config(d, f, app, sdepth, sbsize, sflush, sdebug);
+	}
+
+	const std::map< const std::string, const std::string> & get_option_defaults() {
+		return plugin_uringfile_config_defaults;
+	}
+
+	int initialize() {
+		std::map <string, string >m;
+		// config if never config'd
+		if (!fname.size())
+			config(m);
+		if (mode != pi_init) {
+			return 2;
+		}
+		if ( state == err ) {
+			std::cout << "uringfile plugin initialize found pre-existing error" << std::endl;
+			return 3;
+		}
+		std::error_code ec;
+		std::filesystem::create_directories(fdir, ec);
+		if (ec.value() != 0 && ec.value() != EEXIST ) {
+			state = err;
+			std::cout << "unable to create output directory for plugin 'uringfile'; "
+			       	<< fdir << " : " << ec.message() << std::endl;
+			return ec.value();
+		}
+		std::filesystem::path dpath {fdir};
+		std::filesystem::path fpath = dpath / fname;
+		async_err = 0;
+		use_ring = false;
+#ifdef ADC_HAVE_IO_URING
+		fd = open(fpath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC |
+			(fappend ? 0 : O_TRUNC), 0644);
+		if (fd < 0) {
+			state = err;
+			return errno;
+		}
+		struct stat sb;
+		file_off = (fappend && !fstat(fd, &sb)) ? sb.st_size : 0;
+		int rerr = ring_open();
+		if (rerr) {
+			if (debug) {
+				std::cout << "uringfile plugin: io_uring unavailable ("
+					<< std::strerror(rerr) << "); using write()" << std::endl;
+			}
+			ring_close();
+			close(fd);
+			fd = -1;
+		} else {
+			use_ring = true;
+		}
+#endif
+		if (!use_ring) {
+			fallback.configure(std::to_string(bsize), submit_each ? "record" : "finalize",
+				record_writer::flush_count_default, record_writer::flush_ms_default,
+				record_writer::sync_default);
+			int oerr = fallback.open(fpath, fappend);
+			if (oerr) {
+				state = err;
+				if (debug) {
+					std::cout << "uringfile plugin: unable to open " << fpath << ": "
+						<< std::strerror(oerr) << std::endl;
+				}
+				return oerr;
+			}
+		}
+		mode = pi_pub_or_final;
+		return 0;
+	}
+
+	void finalize() {
+		if (mode == pi_pub_or_final) {
+			int e = 0;
+#ifdef ADC_HAVE_IO_URING
+			if (use_ring) {
+				note_error(drain());
+				e = take_error();
+				ring_close();
+				if (close(fd) && !e)
+					e = errno;
+				fd = -1;
+			} else
+#endif
+			{
+				e = fallback.close();
+			}
+			if (e) {
+				std::cerr << "uringfile plugin: write error on " << fname
+					<< ": " << std::strerror(e) << std::endl;
+			}
+			state = ok;
+			paused = false;
+			mode = pi_config;
+		} else {
+			if (debug) {
+				std::cout << "uringfile plugin finalize on non-running plugin" << std::endl;
+			}
+		}
+	}
+
+	void pause() {
+		paused = true;
+	}
+
+	void resume() {
+		paused = false;
+	}
+
+	string_view name() const {
+		return "uringfile";
+	}
+
+	string_view version() const {
+		return vers;
+	}
+
+	~uringfile_plugin() {
+		if (mode == pi_pub_or_final)
+			finalize();
+		if (debug) {
+			std::cout << "Destructing uringfile_plugin" << std::endl;
+		}
+	}
+};
+
+} // adc
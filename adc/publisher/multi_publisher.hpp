@@ -25,7 +25,21 @@ namespace adc {
 inline version multi_publisher_version(MULTI_PUBLISHER_VERSION, MULTI_PUBLISHER_TAGS);
 
 /*! @brief Interface for a group of publishers all being fed the same message(s).
- 
+
+  The group can govern its own overhead: if env("ADC_MULTI_PUBLISHER_BUDGET")
+  is a percent greater than 0 (e.g. 0.5), the wall time spent in publish
+  (and reported with add_overhead) is compared with the elapsed wall time
+  every env("ADC_MULTI_PUBLISHER_BUDGET_WINDOW") seconds (default 10).
+  Over budget, publishers not named in the colon-separated
+  env("ADC_MULTI_PUBLISHER_CRITICAL") are paused. They are resumed
+  after a window under env("ADC_MULTI_PUBLISHER_BUDGET_RESUME") percent
+  (default half the budget), once they have been paused for the hold
+  time: 1 window, doubled (to at most 64) each time the budget is
+  exceeded in the first window after a resume. Each pause and resume is
+  published, to every publisher not paused by the application, as a message with
+  application "adc_governor" recording the overhead measured, the
+  settings, and the publishers affected; a resume also records the
+  seconds paused and the messages suppressed.
   */
 class ADC_VISIBLE multi_publisher_api
 {
@@ -52,6 +66,22 @@ public:
 	/// @brief List names of all configured publishers
 	virtual std::vector< std::string >get_names() = 0;
 
+	/// @brief Get the counters of the group, named "multi_publisher",
+	/// followed by those of each publisher in the order added.
+	/// The group counts one publish per message, taking the time of all
+	/// publishers, with the first nonzero code among them.
+	/// Counting is disabled if env("ADC_PUBLISHER_STATS") is "0".
+	virtual std::vector< std::pair< std::string, publisher_stats::snapshot > > get_stats() = 0;
+
+	/// @brief Count ns spent in ADC outside publish (such as building
+	/// messages) toward the overhead budget, if one is set.
+	virtual void add_overhead(uint64_t ns) = 0;
+
+	/// @brief Add section "adc_self" to b, with a section of counters
+	/// (see publisher_stats::snapshot::add_to) per element of get_stats.
+	/// A repeated publisher name is suffixed with .N.
+	virtual void add_self_section(std::shared_ptr<builder_api> b) = 0;
+
 	virtual ~multi_publisher_api() {}
 };
 
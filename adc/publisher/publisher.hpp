@@ -11,6 +11,7 @@
 #include <memory>
 #include "adc/types.hpp"
 #include "adc/builder/builder.hpp"
+#include "adc/publisher/publisher_stats.hpp"
 
 namespace adc {
 
@@ -100,6 +101,73 @@ public:
 
 };
 
+/*! @brief Self-instrumentation storage for publisher implementations.
+
+Plugins derive from this as well as publisher_api to keep a
+publisher_stats: they serialize through counted_serialize() and may
+record background deliveries in self_stats. The multi_publisher finds
+it with dynamic_cast and records publish outcomes there too; for
+publishers without it, the multi_publisher keeps their counters itself.
+It is not part of publisher_api, so the layout modules are built
+against does not change with publisher_stats.
+*/
+class ADC_VISIBLE counted_publisher
+{
+public:
+	virtual ~counted_publisher() {};
+
+	/// @brief Get the self-instrumentation counters of the plugin.
+	/// See publisher_stats for which are recorded where.
+	publisher_stats& get_stats() {
+		return self_stats;
+	}
+
+protected:
+	/// @brief Serialize b, recording the time and size in the counters.
+	/// Plugins use this in place of b->serialize().
+	std::string counted_serialize(const std::shared_ptr<builder_api>& b) {
+		if (!publisher_stats::time_next()) {
+			std::string s = b->serialize();
+			if (publisher_stats::enabled())
+				self_stats.record_serialize(s.size());
+			return s;
+		}
+		uint64_t t0 = publisher_stats::now_ns();
+		std::string s = b->serialize();
+		self_stats.record_serialize_time(publisher_stats::now_ns() - t0);
+		self_stats.record_serialize(s.size());
+		return s;
+	}
+
+	/// @brief the counters of this plugin.
+	publisher_stats self_stats;
+};
+
+/// @brief version of the publisher module entry points defined by ADC_PUBLISHER_MODULE.
+#define ADC_PUBLISHER_MODULE_API 1
+
+/*! @brief Define the entry points of a publisher module.
+
+A publisher module is a shared object named adc_publisher_$name.so in
+a directory listed in env("ADC_PLUGIN_PATH") or in the installed plugin
+directory. The factory loads it only when publisher $name is requested,
+so its dependencies are not loaded by applications that do not use it.
+Use this macro once in the module, outside any namespace, with the
+publisher_api implementation class, which must be default constructible.
+Publishers compiled into the library take precedence over modules of
+the same name.
+*/
+#define ADC_PUBLISHER_MODULE(plugin_class) \
+extern "C" ADC_VISIBLE int adc_publisher_module_api() { \
+	return ADC_PUBLISHER_MODULE_API; \
+} \
+extern "C" ADC_VISIBLE adc::publisher_api *adc_publisher_module_create() { \
+	return new plugin_class(); \
+} \
+extern "C" ADC_VISIBLE void adc_publisher_module_destroy(adc::publisher_api *p) { \
+	delete p; \
+}
+
 /// @brief name/plugin map.
 typedef std::map< const std::string, std::shared_ptr<publisher_api> > plugin_map;
 
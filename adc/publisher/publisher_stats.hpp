@@ -0,0 +1,342 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_publisher_stats_hpp
+#define adc_publisher_stats_hpp
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "adc/types.hpp"
+#include "adc/builder/builder.hpp"
+
+namespace adc {
+
+/** @addtogroup API
+ *  @{
+ */
+
+/*! @brief Self-instrumentation counters of a publisher.
+
+All updates are relaxed atomic increments, so they may be made from any
+thread and cost a few ns each. Reading the clock costs more, so counts
+are exact but only 1 in N publish and serialize calls per thread is
+timed, where N is env("ADC_PUBLISHER_STATS") (default 16); if it is "0",
+nothing is recorded. Latencies are kept in histograms of log2(ns)
+buckets: bucket i counts times in [2^i, 2^(i+1)) ns, bucket 0 also
+counts times under 2 ns, and the last bucket is unbounded above.
+
+Publish outcomes (messages, drops, errors, publish latency) are recorded
+by the multi_publisher for each of its publishers, and pauses when it
+(or its overhead governor) pauses them. Publish calls to a publisher the
+governor has paused are not counted as messages. Serialization time and
+bytes are recorded by the publishers themselves, as are the outcomes of
+deliveries completed in the background (by the programs some publishers
+run per message); those are counted under a mutex, as they are off the
+publish path.
+*/
+class ADC_VISIBLE publisher_stats {
+public:
+	/// @brief the number of latency histogram buckets.
+	static const size_t buckets = 40;
+	/// @brief error codes at or above this are counted together as max_code.
+	static const int max_code = 134;
+
+	/// @brief a copy of the counters at one time.
+	struct snapshot {
+		uint64_t messages = 0;	///< publish calls returning 0
+		uint64_t drops = 0;	///< publish calls returning EAGAIN
+		uint64_t errors = 0;	///< publish calls returning other codes
+		uint64_t pauses = 0;	///< pause calls
+		uint64_t bytes = 0;	///< serialized message bytes
+		uint64_t serializations = 0;	///< serialize calls
+		uint64_t publish_timed = 0;	///< publish calls timed
+		uint64_t serialize_timed = 0;	///< serialize calls timed
+		uint64_t publish_ns = 0;	///< total time of publish calls timed
+		uint64_t serialize_ns = 0;	///< total time of serialize calls timed
+		std::map< int, uint64_t > error_codes;	///< nonzero error counts by code
+		uint64_t delivered = 0;	///< background deliveries that succeeded
+		uint64_t delivery_failures = 0;	///< background deliveries that failed
+		uint64_t inflight_max = 0;	///< most background deliveries running at once
+		uint64_t queued_max = 0;	///< most background deliveries waiting at once
+		std::map< int, uint64_t > delivery_codes;	///< failures by exit code (128+signal; -1 unknown)
+		std::map< int, uint64_t > http_codes;	///< deliveries by HTTP status
+		std::array< uint64_t, buckets > publish_hist = {};
+		std::array< uint64_t, buckets > serialize_hist = {};
+
+		/// @brief add the counters of o to these.
+		void merge(const snapshot& o) {
+			messages += o.messages;
+			drops += o.drops;
+			errors += o.errors;
+			pauses += o.pauses;
+			bytes += o.bytes;
+			serializations += o.serializations;
+			publish_timed += o.publish_timed;
+			serialize_timed += o.serialize_timed;
+			publish_ns += o.publish_ns;
+			serialize_ns += o.serialize_ns;
+			for (const auto& c : o.error_codes)
+				error_codes[c.first] += c.second;
+			delivered += o.delivered;
+			delivery_failures += o.delivery_failures;
+			inflight_max = std::max(inflight_max, o.inflight_max);
+			queued_max = std::max(queued_max, o.queued_max);
+			for (const auto& c : o.delivery_codes)
+				delivery_codes[c.first] += c.second;
+			for (const auto& c : o.http_codes)
+				http_codes[c.first] += c.second;
+			for (size_t i = 0; i < buckets; i++) {
+				publish_hist[i] += o.publish_hist[i];
+				serialize_hist[i] += o.serialize_hist[i];
+			}
+		}
+
+		/// @return the upper bound in ns of the bucket holding quantile q
+		/// of hist, or 0 if hist is empty.
+		static uint64_t quantile_ns(const std::array< uint64_t, buckets >& hist, double q) {
+			uint64_t n = 0;
+			for (auto c : hist)
+				n += c;
+			if (!n)
+				return 0;
+			uint64_t rank = (uint64_t)(q * (double)n);
+			if (rank >= n)
+				rank = n - 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < buckets; i++) {
+				seen += hist[i];
+				if (seen > rank)
+					return (uint64_t)1 << (i + 1);
+			}
+			return (uint64_t)1 << buckets;
+		}
+
+		/*! @brief add the counters as fields of b.
+		 Fields are messages, drops, errors, pauses, bytes, serializations,
+		 publish_timed, serialize_timed, publish_ns_total,
+		 serialize_ns_total, publish_ns_p50/p99 and
+		 serialize_ns_p50/p99 (bucket upper bounds), the arrays
+		 error_codes/error_counts, and the histogram arrays
+		 publish_ns_log2 and serialize_ns_log2; if there were background
+		 deliveries, also delivered, delivery_failures, inflight_max,
+		 queued_max, and the arrays delivery_codes/delivery_counts and
+		 http_codes/http_counts.
+		 */
+		void add_to(std::shared_ptr< builder_api > b) const {
+			b->add("messages", messages);
+			b->add("drops", drops);
+			b->add("errors", errors);
+			b->add("pauses", pauses);
+			b->add("bytes", bytes);
+			b->add("serializations", serializations);
+			b->add("publish_timed", publish_timed);
+			b->add("serialize_timed", serialize_timed);
+			b->add("publish_ns_total", publish_ns);
+			b->add("serialize_ns_total", serialize_ns);
+			b->add("publish_ns_p50", quantile_ns(publish_hist, 0.5));
+			b->add("publish_ns_p99", quantile_ns(publish_hist, 0.99));
+			b->add("serialize_ns_p50", quantile_ns(serialize_hist, 0.5));
+			b->add("serialize_ns_p99", quantile_ns(serialize_hist, 0.99));
+			add_counts(b, "error_codes", "error_counts", error_codes);
+			std::array< uint64_t, buckets > h = publish_hist;
+			b->add_array("publish_ns_log2", h.data(), h.size());
+			h = serialize_hist;
+			b->add_array("serialize_ns_log2", h.data(), h.size());
+			if (!(delivered || delivery_failures))
+				return;
+			b->add("delivered", delivered);
+			b->add("delivery_failures", delivery_failures);
+			b->add("inflight_max", inflight_max);
+			b->add("queued_max", queued_max);
+			add_counts(b, "delivery_codes", "delivery_counts", delivery_codes);
+			add_counts(b, "http_codes", "http_counts", http_codes);
+		}
+
+	private:
+		static void add_counts(std::shared_ptr< builder_api > b, std::string_view keys,
+			std::string_view values, const std::map< int, uint64_t >& m) {
+			std::vector< int32_t > codes;
+			std::vector< uint64_t > counts;
+			for (const auto& c : m) {
+				codes.push_back(c.first);
+				counts.push_back(c.second);
+			}
+			b->add_array(keys, codes.data(), codes.size());
+			b->add_array(values, counts.data(), counts.size());
+		}
+	};
+
+	/// @return N from env("ADC_PUBLISHER_STATS"), read once.
+	static unsigned interval() {
+		static const unsigned n = []() {
+			const char *env = getenv("ADC_PUBLISHER_STATS");
+			if (!env || !*env)
+				return 16u;
+			return (unsigned)strtoul(env, nullptr, 10);
+		}();
+		return n;
+	}
+
+	/// @return true if recording is enabled.
+	static bool enabled() {
+		return interval() != 0;
+	}
+
+	/// @return true if the caller should time its next call:
+	/// 1 call in interval() on this thread.
+	static bool time_next() {
+		static thread_local unsigned calls = 0;
+		unsigned n = interval();
+		if (!n)
+			return false;
+		if (++calls < n)
+			return false;
+		calls = 0;
+		return true;
+	}
+
+	/// @return a monotonic time in ns for computing the intervals recorded.
+	static uint64_t now_ns() {
+		return (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// @brief record a publish call returning rc.
+	void record_publish(int rc) {
+		if (!rc) {
+			messages.fetch_add(1, std::memory_order_relaxed);
+		} else if (rc == EAGAIN) {
+			drops.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			errors.fetch_add(1, std::memory_order_relaxed);
+			codes[(rc > 0 && rc < max_code) ? rc : max_code].fetch_add(1,
+				std::memory_order_relaxed);
+		}
+	}
+
+	/// @brief record the time of a publish call.
+	void record_publish_time(uint64_t ns) {
+		publish_timed.fetch_add(1, std::memory_order_relaxed);
+		publish_ns.fetch_add(ns, std::memory_order_relaxed);
+		publish_hist[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @brief record the serialization of len bytes.
+	void record_serialize(size_t len) {
+		bytes.fetch_add(len, std::memory_order_relaxed);
+		serializations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @brief record the time of a serialization.
+	void record_serialize_time(uint64_t ns) {
+		serialize_timed.fetch_add(1, std::memory_order_relaxed);
+		serialize_ns.fetch_add(ns, std::memory_order_relaxed);
+		serialize_hist[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @brief record a background delivery ending with code:
+	/// an exit code, 128+signal, or -1 if unknown; 0 is success.
+	void record_delivery(int code) {
+		std::lock_guard< std::mutex > g(delivery_lock);
+		if (!code) {
+			delivered_count++;
+		} else {
+			failed_count++;
+			delivery_code_counts[code]++;
+		}
+	}
+
+	/// @brief record the HTTP status of a background delivery.
+	void record_http_code(int code) {
+		std::lock_guard< std::mutex > g(delivery_lock);
+		http_code_counts[code]++;
+	}
+
+	/// @brief record the background deliveries running and waiting.
+	void record_backlog(uint64_t inflight, uint64_t queued) {
+		std::lock_guard< std::mutex > g(delivery_lock);
+		inflight_high = std::max(inflight_high, inflight);
+		queued_high = std::max(queued_high, queued);
+	}
+
+	/// @brief record a pause call.
+	void record_pause() {
+		pauses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @return a copy of the counters. Counters updated concurrently
+	/// may be copied before or after the update.
+	snapshot get() const {
+		snapshot s;
+		s.messages = messages.load(std::memory_order_relaxed);
+		s.drops = drops.load(std::memory_order_relaxed);
+		s.errors = errors.load(std::memory_order_relaxed);
+		s.pauses = pauses.load(std::memory_order_relaxed);
+		s.bytes = bytes.load(std::memory_order_relaxed);
+		s.serializations = serializations.load(std::memory_order_relaxed);
+		s.publish_timed = publish_timed.load(std::memory_order_relaxed);
+		s.serialize_timed = serialize_timed.load(std::memory_order_relaxed);
+		s.publish_ns = publish_ns.load(std::memory_order_relaxed);
+		s.serialize_ns = serialize_ns.load(std::memory_order_relaxed);
+		for (int i = 1; i <= max_code; i++) {
+			uint64_t c = codes[i].load(std::memory_order_relaxed);
+			if (c)
+				s.error_codes[i] = c;
+		}
+		for (size_t i = 0; i < buckets; i++) {
+			s.publish_hist[i] = publish_hist[i].load(std::memory_order_relaxed);
+			s.serialize_hist[i] = serialize_hist[i].load(std::memory_order_relaxed);
+		}
+		std::lock_guard< std::mutex > g(delivery_lock);
+		s.delivered = delivered_count;
+		s.delivery_failures = failed_count;
+		s.inflight_max = inflight_high;
+		s.queued_max = queued_high;
+		s.delivery_codes = delivery_code_counts;
+		s.http_codes = http_code_counts;
+		return s;
+	}
+
+private:
+	static size_t bucket(uint64_t ns) {
+		if (ns < 2)
+			return 0;
+		size_t i = 63 - __builtin_clzll(ns);
+		return i < buckets ? i : buckets - 1;
+	}
+
+	std::atomic< uint64_t > messages{0};
+	std::atomic< uint64_t > drops{0};
+	std::atomic< uint64_t > errors{0};
+	std::atomic< uint64_t > pauses{0};
+	std::atomic< uint64_t > bytes{0};
+	std::atomic< uint64_t > serializations{0};
+	std::atomic< uint64_t > publish_timed{0};
+	std::atomic< uint64_t > serialize_timed{0};
+	std::atomic< uint64_t > publish_ns{0};
+	std::atomic< uint64_t > serialize_ns{0};
+	std::array< std::atomic< uint64_t >, max_code + 1 > codes = {};
+	std::array< std::atomic< uint64_t >, buckets > publish_hist = {};
+	std::array< std::atomic< uint64_t >, buckets > serialize_hist = {};
+	mutable std::mutex delivery_lock;
+	uint64_t delivered_count = 0;
+	uint64_t failed_count = 0;
+	uint64_t inflight_high = 0;
+	uint64_t queued_high = 0;
+	std::map< int, uint64_t > delivery_code_counts;
+	std::map< int, uint64_t > http_code_counts;
+};
+
+/** @}*/
+
+} // namespace adc
+#endif // adc_publisher_stats_hpp
@@ -0,0 +1,237 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_field_scan_ipp
+#define adc_field_scan_ipp
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace adc {
+
+/*! \brief Extract members of top-level sections of a json object without a DOM.
+  Only the top-level object is walked; member values not requested are
+  skipped by bracket counting (string aware), and the walk stops as soon as
+  every requested field is resolved. Requested fields are direct members
+  of a top-level object member, e.g. /header/uuid.
+
+  Values are returned as views of the input: strings without their quotes
+  and still escaped (escaped is set if they contain a backslash), other
+  scalars as their raw text. Objects and arrays are reported found but
+  with an empty value.
+ */
+class field_scan {
+public:
+	/// \brief a requested /section/name field and its result.
+	struct field {
+		std::string_view section;
+		std::string_view name;
+		std::string_view value;
+		bool found;
+		bool is_string;
+		bool escaped;
+	};
+
+	/// \brief set the request of f and clear its result.
+	static void request(field& f, std::string_view section, std::string_view name) {
+		f = { section, name, std::string_view(), false, false, false };
+	}
+
+	/*! \brief fill in the fields found in json object j.
+	 * \return false if j is malformed before all fields were resolved, so
+	 * unresolved fields may exist but were not seen.
+	 */
+	static bool scan(std::string_view j, field *f, size_t n) {
+		size_t i = skip_ws(j, 0);
+		if (i >= j.size() || j[i] != '{')
+			return false;
+		size_t pending = 0;
+		for (size_t k = 0; k < n; k++) {
+			f[k].value = std::string_view();
+			f[k].found = f[k].is_string = f[k].escaped = false;
+			pending++;
+		}
+		i++;
+		while (pending) {
+			i = skip_ws(j, i);
+			if (i >= j.size())
+				return false;
+			if (j[i] == '}')
+				return true;
+			std::string_view key;
+			if (!member_key(j, i, key))
+				return false;
+			bool wanted = false;
+			for (size_t k = 0; k < n; k++) {
+				if (!f[k].found && f[k].section == key) {
+					wanted = true;
+					break;
+				}
+			}
+			if (wanted && j[i] == '{') {
+				if (!scan_section(j, i, key, f, n, pending))
+					return false;
+			} else if (!skip_value(j, i)) {
+				return false;
+			}
+			i = skip_ws(j, i);
+			if (i < j.size() && j[i] == ',') {
+				i++;
+			} else if (i < j.size() && j[i] == '}') {
+				return true;
+			} else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*! \brief convert a "sec.frac" decimal seconds text to ns.
+	 * Digits past ns resolution are ignored.
+	 */
+	static uint64_t seconds_to_ns(std::string_view v) {
+		uint64_t sec = 0, ns = 0;
+		size_t i = 0;
+		for (; i < v.size() && v[i] >= '0' && v[i] <= '9'; i++)
+			sec = sec * 10 + (v[i] - '0');
+		if (i < v.size() && v[i] == '.') {
+			i++;
+			int digits = 0;
+			for (; i < v.size() && v[i] >= '0' && v[i] <= '9' && digits < 9; i++, digits++)
+				ns = ns * 10 + (v[i] - '0');
+			for (; digits < 9; digits++)
+				ns *= 10;
+		}
+		return sec * 1000000000ULL + ns;
+	}
+
+private:
+	static size_t skip_ws(std::string_view j, size_t i) {
+		while (i < j.size() && (j[i] == ' ' || j[i] == '\n' || j[i] == '\r' || j[i] == '\t'))
+			i++;
+		return i;
+	}
+
+	// \return position after the closing quote of the string whose open quote is at i, or npos.
+	static size_t string_end(std::string_view j, size_t i, bool& escaped) {
+		escaped = false;
+		i++;
+		while (i < j.size()) {
+			const void *q = memchr(j.data() + i, '"', j.size() - i);
+			if (!q)
+				return std::string_view::npos;
+			size_t e = static_cast<const char *>(q) - j.data();
+			size_t bs = 0;
+			while (e - bs > i && j[e - bs - 1] == '\\')
+				bs++;
+			if (bs)
+				escaped = true;
+			if (!(bs & 1))
+				return e + 1;
+			i = e + 1;
+		}
+		return std::string_view::npos;
+	}
+
+	// parse "key" ws : ws at i, leaving i at the value.
+	static bool member_key(std::string_view j, size_t& i, std::string_view& key) {
+		if (j[i] != '"')
+			return false;
+		bool escaped;
+		size_t e = string_end(j, i, escaped);
+		if (e == std::string_view::npos)
+			return false;
+		key = j.substr(i + 1, e - i - 2);
+		i = skip_ws(j, e);
+		if (i >= j.size() || j[i] != ':')
+			return false;
+		i = skip_ws(j, i + 1);
+		return i < j.size();
+	}
+
+	// advance i past the value starting at i.
+	static bool skip_value(std::string_view j, size_t& i) {
+		bool escaped;
+		char c = j[i];
+		if (c == '"') {
+			i = string_end(j, i, escaped);
+			return i != std::string_view::npos;
+		}
+		if (c == '{' || c == '[') {
+			int depth = 0;
+			while (i < j.size()) {
+				c = j[i];
+				if (c == '"') {
+					i = string_end(j, i, escaped);
+					if (i == std::string_view::npos)
+						return false;
+					continue;
+				}
+				if (c == '{' || c == '[') {
+					depth++;
+				} else if (c == '}' || c == ']') {
+					if (--depth == 0) {
+						i++;
+						return true;
+					}
+				}
+				i++;
+			}
+			return false;
+		}
+		while (i < j.size() && j[i] != ',' && j[i] != '}' && j[i] != ']' &&
+			j[i] != ' ' && j[i] != '\n' && j[i] != '\r' && j[i] != '\t')
+			i++;
+		return i < j.size();
+	}
+
+	// walk the members of the section object at i, resolving fields of section.
+	static bool scan_section(std::string_view j, size_t& i, std::string_view section,
+		field *f, size_t n, size_t& pending) {
+		i = skip_ws(j, i + 1);
+		if (i < j.size() && j[i] == '}') {
+			i++;
+			return true;
+		}
+		while (i < j.size()) {
+			std::string_view key;
+			if (!member_key(j, i, key))
+				return false;
+			size_t start = i;
+			if (!skip_value(j, i))
+				return false;
+			for (size_t k = 0; k < n; k++) {
+				if (f[k].found || f[k].section != section || f[k].name != key)
+					continue;
+				f[k].found = true;
+				pending--;
+				char c = j[start];
+				if (c == '"') {
+					f[k].is_string = true;
+					f[k].value = j.substr(start + 1, i - start - 2);
+					f[k].escaped = f[k].value.find('\\') != std::string_view::npos;
+				} else if (c == '{' || c == '[') {
+					f[k].value = std::string_view();
+				} else {
+					f[k].value = j.substr(start, i - start);
+				}
+			}
+			i = skip_ws(j, i);
+			if (i >= j.size())
+				return false;
+			if (j[i] == '}') {
+				i++;
+				return true;
+			}
+			if (j[i] != ',')
+				return false;
+			i = skip_ws(j, i + 1);
+		}
+		return false;
+	}
+};
+
+} // adc
+#endif // adc_field_scan_ipp
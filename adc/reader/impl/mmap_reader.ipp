@@ -0,0 +1,282 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_mmap_reader_ipp
+#define adc_mmap_reader_ipp
+#include <adc/reader/reader.hpp>
+#include <adc/publisher/impl/record_scan.ipp>
+#include <adc/reader/impl/field_scan.ipp>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace adc {
+
+/*! \brief log_reader_api implementation over memory-mapped files.
+  One file is mapped at a time and records are located incrementally with
+  the vectorized tag search of record_scan, so memory use does not grow
+  with the log size and returned records are views of the mapping.
+
+  Filter predicates are first evaluated with field_scan, which walks only
+  the top-level members up to the requested sections. A record is parsed
+  with boost::json only when that scan cannot decide a predicate it has
+  not already failed: the field is missing from a malformed record, or its
+  value has escapes. Records failing any predicate on the scan are
+  rejected without parsing, so selective filters read at near the speed
+  of the tag search.
+ */
+class mmap_log_reader : public log_reader_api {
+	enum pred {
+		p_application,
+		p_uuid,
+		p_wfid,
+		p_timestamp
+	};
+
+	std::vector<std::string> files;
+	size_t next_file;
+	std::string path;
+	const char *base;
+	size_t len;
+	size_t pos;
+	log_filter filter;
+	field_scan::field fields[4];
+	pred preds[4];
+	size_t npred;
+	counts c;
+	boost::json::parser jp;
+
+	void unmap() {
+		if (base)
+			munmap(const_cast<char *>(base), len);
+		base = nullptr;
+		len = 0;
+		pos = 0;
+	}
+
+	// map the next queued file. \return false if none remain.
+	bool map_next() {
+		unmap();
+		while (next_file < files.size()) {
+			path = files[next_file++];
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				c.invalid++;
+				continue;
+			}
+			struct stat sb;
+			if (fstat(fd, &sb) || sb.st_size == 0) {
+				::close(fd);
+				continue;
+			}
+			void *m = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (m == MAP_FAILED) {
+				c.invalid++;
+				continue;
+			}
+			madvise(m, sb.st_size, MADV_SEQUENTIAL);
+			base = static_cast<const char *>(m);
+			len = sb.st_size;
+			return true;
+		}
+		return false;
+	}
+
+	static bool junk(const char *p, const char *e) {
+		for (; p < e; p++) {
+			if (*p != '\n' && *p != ' ' && *p != '\r' && *p != '\t')
+				return true;
+		}
+		return false;
+	}
+
+	// find the next well-formed record at or after pos; \return false at end of file.
+	bool next_span(size_t& begin, size_t& end) {
+		bool open = false;
+		size_t t = record_scan::next_tag(base, len, pos, len, open);
+		while (t < len) {
+			if (!open) {
+				// close tag without open tag
+				c.invalid++;
+				pos = t + record_scan::close_tag.size();
+				t = record_scan::next_tag(base, len, pos, len, open);
+				continue;
+			}
+			if (junk(base + pos, base + t))
+				c.invalid++;
+			size_t from = t + record_scan::open_tag.size();
+			size_t u = record_scan::next_tag(base, len, from, len, open);
+			if (u == len) {
+				c.invalid++;
+				pos = len;
+				return false;
+			}
+			if (open) {
+				// missing close tag; resume at the next record.
+				c.invalid++;
+				pos = u;
+				t = u;
+				continue;
+			}
+			begin = t;
+			end = u + record_scan::close_tag.size();
+			pos = end;
+			return true;
+		}
+		if (junk(base + pos, base + len))
+			c.invalid++;
+		pos = len;
+		return false;
+	}
+
+	bool value_matches(pred p, std::string_view v) const {
+		switch (p) {
+		case p_application:
+			return filter.application.count(std::string(v)) != 0;
+		case p_uuid:
+			return filter.uuid.count(std::string(v)) != 0;
+		case p_wfid:
+			return filter.wfid.count(std::string(v)) != 0;
+		case p_timestamp: {
+			uint64_t ns = field_scan::seconds_to_ns(v);
+			return ns >= filter.timestamp_begin_ns && ns < filter.timestamp_end_ns;
+		}
+		}
+		return false;
+	}
+
+	// evaluate the filter with a full parse of j.
+	bool parse_select(std::string_view j) {
+		c.parsed++;
+		boost::json::error_code ec;
+		jp.reset();
+		jp.write(j.data(), j.size(), ec);
+		if (!ec)
+			jp.finish(ec);
+		if (ec)
+			return false;
+		boost::json::value v = jp.release();
+		for (size_t k = 0; k < npred; k++) {
+			std::string pointer = "/" + std::string(fields[k].section) + "/" +
+				std::string(fields[k].name);
+			const boost::json::value *f = v.find_pointer(pointer, ec);
+			if (!f)
+				return false;
+			std::string text;
+			if (f->is_string()) {
+				text = std::string(f->get_string());
+			} else if (preds[k] == p_timestamp && f->is_number()) {
+				text = boost::json::serialize(*f);
+			} else {
+				return false;
+			}
+			if (!value_matches(preds[k], text))
+				return false;
+		}
+		return true;
+	}
+
+	bool select(std::string_view j) {
+		if (!npred)
+			return true;
+		bool complete = field_scan::scan(j, fields, npred);
+		bool undecided = false;
+		for (size_t k = 0; k < npred; k++) {
+			const auto& f = fields[k];
+			if (!f.found) {
+				if (complete)
+					return false;
+				undecided = true;
+				continue;
+			}
+			bool usable = !f.escaped && f.value.size() &&
+				(f.is_string || preds[k] == p_timestamp);
+			if (!usable) {
+				undecided = true;
+				continue;
+			}
+			if (!value_matches(preds[k], f.value))
+				return false;
+		}
+		if (!undecided)
+			return true;
+		return parse_select(j);
+	}
+
+	void add_pred(pred p, std::string_view section, std::string_view name) {
+		field_scan::request(fields[npred], section, name);
+		preds[npred++] = p;
+	}
+
+public:
+	mmap_log_reader() : next_file(0), base(nullptr), len(0), pos(0), npred(0), c{0, 0, 0, 0} { }
+
+	~mmap_log_reader() {
+		unmap();
+	}
+
+	int add_file(const std::string& p) {
+		if (access(p.c_str(), R_OK))
+			return errno;
+		files.push_back(p);
+		return 0;
+	}
+
+	void set_filter(const log_filter& f) {
+		filter = f;
+		npred = 0;
+		if (filter.application.size())
+			add_pred(p_application, "header", "application");
+		if (filter.timestamp_begin_ns != 0 || filter.timestamp_end_ns != UINT64_MAX)
+			add_pred(p_timestamp, "header", "timestamp");
+		if (filter.uuid.size())
+			add_pred(p_uuid, "header", "uuid");
+		if (filter.wfid.size())
+			add_pred(p_wfid, "adc_workflow", "wfid");
+	}
+
+	bool next(log_record& r) {
+		for (;;) {
+			if (!base && !map_next())
+				return false;
+			size_t begin, end;
+			while (next_span(begin, end)) {
+				c.records++;
+				std::string_view j(base + begin + record_scan::open_tag.size(),
+					end - begin - record_scan::open_tag.size() - record_scan::close_tag.size());
+				if (select(j)) {
+					c.selected++;
+					r.json = j;
+					r.path = path;
+					r.offset = begin;
+					return true;
+				}
+			}
+			unmap();
+		}
+	}
+
+	counts get_counts() const {
+		return c;
+	}
+
+	void close() {
+		unmap();
+		files.clear();
+		next_file = 0;
+		path.clear();
+		set_filter(log_filter());
+		c = {0, 0, 0, 0};
+	}
+};
+
+} // adc
+#endif // adc_mmap_reader_ipp
@@ -0,0 +1,100 @@
+/* Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_reader_hpp
+#define adc_reader_hpp
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <set>
+#include "adc/types.hpp"
+
+namespace adc {
+
+/** @addtogroup API
+ *  @{
+ */
+
+inline version log_reader_api_version("1.0.0", {"none"});
+
+/*! @brief Record selection for a log_reader_api.
+
+Each non-empty set is a predicate requiring the record's field to equal
+one of its members; the timestamp range is a predicate if it is not the
+full range. A record is selected if it satisfies all predicates.
+Fields are compared after json unescaping.
+ */
+class log_filter {
+public:
+	std::set<std::string> application; //!< values of /header/application
+	std::set<std::string> uuid; //!< values of /header/uuid
+	std::set<std::string> wfid; //!< values of /adc_workflow/wfid
+	uint64_t timestamp_begin_ns = 0; //!< least /header/timestamp selected, in ns since the epoch.
+	uint64_t timestamp_end_ns = UINT64_MAX; //!< /header/timestamp selected is less than this.
+
+	/// @return true if every record is selected.
+	bool empty() const {
+		return application.empty() && uuid.empty() && wfid.empty() &&
+			timestamp_begin_ns == 0 && timestamp_end_ns == UINT64_MAX;
+	}
+};
+
+/*! @brief A record returned by a log_reader_api.
+The views refer to reader-owned memory and are valid until the
+next call to next() or close() on the reader.
+ */
+struct log_record {
+	std::string_view json; //!< the record text, without the <adct-json> tags.
+	std::string_view path; //!< the file containing the record.
+	uint64_t offset; //!< offset of the record's open tag in the file.
+};
+
+/*! @brief Reader of <adct-json> framed logs, such as those written by the
+file, multifile, mmapfile, uringfile, and mpifile publishers.
+
+Life-cycle of a reader:
+- r is created by a call to the factory.
+- r->add_file is called for each input, in the order to be read.
+- r->set_filter is called 0 or 1 times (by default every record is returned).
+- r->next is called until it returns false.
+- r->close is called, after which the reader may be reused.
+
+Records are returned in file order. Framing errors are skipped and counted.
+A reader object should not be assumed thread-safe.
+ */
+class ADC_VISIBLE log_reader_api
+{
+public:
+	virtual ~log_reader_api() {};
+
+	/// @brief counts since the last close().
+	struct counts {
+		uint64_t records; //!< well-formed records examined.
+		uint64_t selected; //!< records returned.
+		uint64_t parsed; //!< records that needed a full json parse to evaluate the filter.
+		uint64_t invalid; //!< framing errors skipped.
+	};
+
+	/// @brief Queue a file to read.
+	/// @return 0, or errno if the file cannot be read.
+	virtual int add_file(const std::string& path) = 0;
+
+	/// @brief Set the record selection.
+	virtual void set_filter(const log_filter& f) = 0;
+
+	/// @brief Get the next selected record.
+	/// @return true with r filled in, or false when all files are read.
+	virtual bool next(log_record& r) = 0;
+
+	/// @return counts of the records examined.
+	virtual counts get_counts() const = 0;
+
+	/// @brief Release all files and reset the counts and filter.
+	virtual void close() = 0;
+};
+
+/** @}*/
+
+} // namespace adc
+#endif // adc_reader_hpp
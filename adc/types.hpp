@@ -13,6 +13,7 @@
 #include <complex>
 #include <variant>
 #include <array>
+#include <type_traits>
 #include <sys/time.h>
 
 #include "adc/adc_config.h"
@@ -189,6 +190,33 @@ ADC_VISIBLE scalar_type scalar_type_from_name(const std::string& name);
 /*! @brief return non-zero if to_string and enum scalar_type are inconsisent. */
 ADC_VISIBLE int test_enum_strings();
 
+/*! @brief get the scalar_type of C++ type T, for the typed builder accessors.
+ *
+ * std::string maps to cp_cstr, which the accessors match with any string type.
+ * Other types fail to compile.
+ */
+template< typename T >
+constexpr scalar_type scalar_type_of() {
+	if constexpr (std::is_same_v< T, bool >) return cp_bool;
+	else if constexpr (std::is_same_v< T, char >) return cp_char;
+	else if constexpr (std::is_same_v< T, char16_t >) return cp_char16;
+	else if constexpr (std::is_same_v< T, char32_t >) return cp_char32;
+	else if constexpr (std::is_same_v< T, uint8_t >) return cp_uint8;
+	else if constexpr (std::is_same_v< T, uint16_t >) return cp_uint16;
+	else if constexpr (std::is_same_v< T, uint32_t >) return cp_uint32;
+	else if constexpr (std::is_same_v< T, uint64_t >) return cp_uint64;
+	else if constexpr (std::is_same_v< T, int8_t >) return cp_int8;
+	else if constexpr (std::is_same_v< T, int16_t >) return cp_int16;
+	else if constexpr (std::is_same_v< T, int32_t >) return cp_int32;
+	else if constexpr (std::is_same_v< T, int64_t >) return cp_int64;
+	else if constexpr (std::is_same_v< T, float >) return cp_f32;
+	else if constexpr (std::is_same_v< T, double >) return cp_f64;
+	else if constexpr (std::is_same_v< T, std::complex<float> >) return cp_c_f32;
+	else if constexpr (std::is_same_v< T, std::complex<double> >) return cp_c_f64;
+	else if constexpr (std::is_same_v< T, std::string >) return cp_cstr;
+	else static_assert(sizeof(T) == 0, "no scalar_type for this type");
+}
+
 /*! @brief classification of json-adjacent structure elements.
  * This is not currently in use and may be retired soon.
  */
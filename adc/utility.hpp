@@ -6,6 +6,8 @@
 #define adc_utility_hpp
 #include <string>
 #include <string_view>
+#include <cstdint>
+#include <vector>
 #include <map>
 #include <set>
 
@@ -34,6 +36,11 @@ ADC_VISIBLE std::string get_multifile_log_path(std::string_view dir, std::string
  *
  * @return the list of new consolidated logs from reduction of a multifile publisher tree.
  *
+ * Inputs are written in order of rank, then application, then path, taken from
+ * the $application.R$rank.XXXXXX file names. Inputs that cannot be copied are
+ * left out of the consolidated log and out of old_paths, so they may be merged
+ * by a later call.
+ *
  * Example:
  * /FS/adc/ may be multiuser
  * /FS/adc/$user is owned/writable by $user
@@ -44,20 +51,55 @@ ADC_VISIBLE std::string get_multifile_log_path(std::string_view dir, std::string
  */
 ADC_VISIBLE std::vector< std::string > consolidate_multifile_logs(const std::string& match, std::vector< std::string>& old_paths, bool debug=false);
 
+/*! Utility to merge parallel outputs from multifile publisher using multiple threads.
+ * As consolidate_multifile_logs above, but up to threads files are copied at once
+ * into their precomputed regions of the output, with copy_file_range where
+ * the file system supports it. Use 0 threads for the hardware concurrency.
+ */
+ADC_VISIBLE std::vector< std::string > consolidate_multifile_logs(const std::string& match, std::vector< std::string>& old_paths, bool debug, unsigned threads);
+
 /*! Utility to validate that multi-record files were correctly written.
  * Each record is a json object delimited by <adct-json></adct-json> xml tags.
- * @return vector of the start positions of invalid records.
+ * @return vector of the start positions of invalid records, in increasing order,
+ *         or the single value std::string::npos if the file cannot be read.
  * @param filename input to check.
  * @param check_json validates that individual record contents are json formatted (but does not
  *        check adct schema compliance).
  * @param record_count output of number of valid records found.
  *
  * <adct-json> tags cannot be nested. Unclosed tags are assumed closed by the start of the next record.
- * 
- * BUGS:
- * not yet implemented. returns emtpy vector and 0 record_count until implemented.
+ * A close tag without an open tag and non-whitespace text between records are also reported.
+ * The file is memory-mapped and scanned by all available hardware threads.
  */
 ADC_VISIBLE std::vector<size_t> validate_multifile_log(std::string_view filename, bool check_json, size_t & record_count);
+
+/*! Utility to validate multi-record files as above, using at most threads threads
+ * to scan and parse (0 uses the hardware concurrency).
+ */
+ADC_VISIBLE std::vector<size_t> validate_multifile_log(std::string_view filename, bool check_json, size_t & record_count, unsigned threads);
+
+/*! Utility to (re)build the sidecar index log_path.idx of a record log.
+ * Logs written by the file or multifile publisher with INDEX "true", and
+ * consolidated logs of indexed multifile output, already have one.
+ * @param threads scan threads; 0 uses the hardware concurrency.
+ * @return 0 or errno.
+ */
+ADC_VISIBLE int index_multifile_log(const std::string& log_path, unsigned threads);
+
+/*! Utility to find records by header uuid using the sidecar index of log_path.
+ * @param records output json texts of the matching records.
+ * @return 0, errno, or EINVAL if the index is missing a valid header or
+ *         does not fit the log.
+ */
+ADC_VISIBLE int find_indexed_records_by_uuid(const std::string& log_path, std::string_view uuid, std::vector< std::string >& records);
+
+/*! Utility to find records by header timestamp using the sidecar index of log_path.
+ * @param begin_ns start of the range, in ns since the epoch (inclusive).
+ * @param end_ns end of the range, in ns since the epoch (exclusive).
+ * @param records output json texts of the matching records, in time order.
+ * @return 0 or errno as find_indexed_records_by_uuid.
+ */
+ADC_VISIBLE int find_indexed_records_by_time(const std::string& log_path, uint64_t begin_ns, uint64_t end_ns, std::vector< std::string >& records);
 /** @}*/
 } // namespace adc
 #endif // adc_utility_hpp
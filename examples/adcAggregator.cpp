@@ -0,0 +1,285 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include "adc/publisher/impl/uds.ipp"
+#include "batchForward.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*! \file adcAggregator.cpp
+ * This is a node-local aggregator for the uds publisher. It receives
+ * messages from all local processes on a SOCK_SEQPACKET socket, batches
+ * them, and forwards each batch as one message through the publishers
+ * named (colon-separated) by -p or env("ADC_AGGREGATOR_PUBLISHER_NAMES"),
+ * which are created and configured as by factory::get_multi_publisher_from_env.
+ * The filesystem or network then sees one writer per node.
+ *
+ * usage: adc.aggregator [-s socket] [-p publishers] [-n batch_records]
+ *        [-t batch_ms] [-z none|zlib] [-v]
+ *
+ * A batch is sent when it holds batch_records (default 256) messages or
+ * 4 MiB, or batch_ms (default 1000) after its first message. The batch
+ * message has application "adc_aggregator" and app_data fields
+ * - records: the number of messages;
+ * - encoding: "json" if data is the json array of the messages, or
+ *   "zlib+base64" if data is the base64 text of the zlib-compressed
+ *   newline-separated messages (with -z zlib, the default where zlib is
+ *   available);
+ * - data.
+ * The socket defaults to env("ADC_UDS_PLUGIN_SOCKET") or
+ * /dev/shm/adc/$uid/adc.aggregator.sock. A stale socket of the same user
+ * is replaced; a live one, or one owned by another user, is left alone
+ * and the aggregator does not start. SIGINT and SIGTERM send the last
+ * batch and stop the aggregator. With -v, counts are printed at exit.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace adcAggregator {
+
+using namespace batchForward;
+
+int usage()
+{
+	std::cerr << "usage: adc.aggregator [-s socket] [-p publishers] [-n batch_records]"
+		" [-t batch_ms] [-z none|zlib] [-v]" << std::endl;
+	return 1;
+}
+
+/**
+ * \brief remove the socket at path if this user owns it and nothing
+ * listens on it. \return 0, or EADDRINUSE if it must be left alone.
+ */
+int remove_stale(const std::string& path, const struct sockaddr_un& sa)
+{
+	struct stat sb;
+	if (lstat(path.c_str(), &sb))
+		return 0;
+	if (!S_ISSOCK(sb.st_mode) || sb.st_uid != geteuid())
+		return EADDRINUSE;
+	int c = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (c >= 0) {
+		bool live = !connect(c, (const struct sockaddr *)&sa, sizeof(sa));
+		close(c);
+		if (live)
+			return EADDRINUSE;
+	}
+	unlink(path.c_str());
+	return 0;
+}
+
+/**
+ * \brief bind a listening SOCK_SEQPACKET socket at path; its inode is
+ * stored in ino. \return fd or -1.
+ */
+int listen_at(const std::string& path, ino_t& ino)
+{
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	memcpy(sa.sun_path, path.c_str(), path.size());
+	if (path == adc::uds_plugin::default_socket()) {
+		// the shared root is open to every user, like /tmp.
+		if (!mkdir("/dev/shm/adc", 01777))
+			chmod("/dev/shm/adc", 01777);
+	}
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+	int e = remove_stale(path, sa);
+	if (e) {
+		errno = e;
+		return -1;
+	}
+	int s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (s < 0)
+		return -1;
+	struct stat sb;
+	if (bind(s, (struct sockaddr *)&sa, sizeof(sa)) || listen(s, SOMAXCONN) ||
+		stat(path.c_str(), &sb)) {
+		e = errno;
+		close(s);
+		errno = e;
+		return -1;
+	}
+	ino = sb.st_ino;
+	return s;
+}
+
+/**
+ * \brief receive messages until signaled, forwarding them in batches.
+ */
+int main(int argc, char **argv) {
+	std::string path = adc::uds_plugin::default_socket();
+	const char *env = getenv("ADC_UDS_PLUGIN_SOCKET");
+	if (env && env[0])
+		path = env;
+	std::string names;
+	env = getenv("ADC_AGGREGATOR_PUBLISHER_NAMES");
+	if (env)
+		names = env;
+	batch b;
+#ifdef ADC_HAVE_ZLIB
+	bool compress = true;
+#else
+	bool compress = false;
+#endif
+	bool verbose = false;
+	for (int i = 1; i < argc; i++) {
+		std::string opt = argv[i];
+		if (opt == "-v") {
+			verbose = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return usage();
+		std::string v = argv[++i];
+		if (opt == "-s") {
+			path = v;
+		} else if (opt == "-p") {
+			names = v;
+		} else if (opt == "-n") {
+			b.max_records = std::strtoul(v.c_str(), nullptr, 10);
+		} else if (opt == "-t") {
+			b.max_ms = std::strtol(v.c_str(), nullptr, 10);
+		} else if (opt == "-z" && (v == "none" || v == "zlib")) {
+			compress = (v == "zlib");
+#ifndef ADC_HAVE_ZLIB
+			if (compress) {
+				std::cerr << "adc.aggregator: built without zlib" << std::endl;
+				return 1;
+			}
+#endif
+		} else {
+			return usage();
+		}
+	}
+	if (names.empty() || b.max_records == 0 || b.max_ms <= 0)
+		return usage();
+
+	adc::factory f;
+	auto mp = start_publishers(f, names, "uds", "adc.aggregator");
+	if (!mp)
+		return 1;
+
+	ino_t ino = 0;
+	int ls = listen_at(path, ino);
+	if (ls < 0) {
+		std::cerr << "adc.aggregator: " << path << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+	catch_stop_signals();
+	signal(SIGPIPE, SIG_IGN);
+
+	std::vector<struct pollfd> fds;
+	fds.push_back({ ls, POLLIN, 0 });
+	// one packet is at most the sender's socket buffer; larger ones are truncated.
+	std::vector<char> buf(4 * 1024 * 1024);
+	counts c;
+	uint64_t truncated = 0;
+	auto send = [&]() {
+		send_batch(f, *mp, "adc_aggregator", f.get_builder(), b, compress, c);
+	};
+	while (!stopping) {
+		int n = poll(fds.data(), fds.size(), b.ms_left());
+		if (n < 0 && errno != EINTR)
+			break;
+		if (fds[0].revents & POLLIN) {
+			int cs;
+			while ((cs = accept4(ls, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0)
+				fds.push_back({ cs, POLLIN, 0 });
+		}
+		for (size_t k = 1; k < fds.size(); k++) {
+			if (!fds[k].revents)
+				continue;
+			bool closed = (fds[k].revents & (POLLHUP | POLLERR)) && !(fds[k].revents & POLLIN);
+			while (!closed) {
+				ssize_t r = recv(fds[k].fd, buf.data(), buf.size(), MSG_DONTWAIT | MSG_TRUNC);
+				if (r < 0) {
+					if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+						closed = true;
+					break;
+				}
+				if (r == 0) {
+					closed = true;
+					break;
+				}
+				if ((size_t)r > buf.size()) {
+					truncated++;
+					continue;
+				}
+				c.received++;
+				if (b.add(std::string(buf.data(), r)))
+					send();
+			}
+			if (closed) {
+				close(fds[k].fd);
+				fds[k].fd = -1;
+			}
+		}
+		for (size_t k = fds.size() - 1; k > 0; k--) {
+			if (fds[k].fd < 0)
+				fds.erase(fds.begin() + k);
+		}
+		if (b.ms_left() == 0)
+			send();
+	}
+	// take what is already queued on the connections, then send the last batch.
+	for (size_t k = 1; k < fds.size(); k++) {
+		ssize_t r;
+		while ((r = recv(fds[k].fd, buf.data(), buf.size(), MSG_DONTWAIT | MSG_TRUNC)) > 0) {
+			if ((size_t)r > buf.size()) {
+				truncated++;
+				continue;
+			}
+			c.received++;
+			if (b.add(std::string(buf.data(), r)))
+				send();
+		}
+		close(fds[k].fd);
+	}
+	if (b.records.size())
+		send();
+	mp->terminate();
+	close(ls);
+	// remove the socket only if it is still the one bound here.
+	struct stat sb;
+	if (!stat(path.c_str(), &sb) && sb.st_ino == ino)
+		unlink(path.c_str());
+	if (verbose) {
+		std::cerr << "received " << c.received << " truncated " << truncated
+			<< " batches " << c.batches << " failed " << c.failed
+			<< " bytes in " << c.raw_bytes << " out " << c.sent_bytes << std::endl;
+	}
+	return 0;
+}
+
+} // adcAggregator
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::adcAggregator::main(argc, argv);
+}
@@ -100,7 +100,8 @@ int main(int argc, char ** argv) {
 		auto pattern = adc::get_multifile_log_path(path, wfid);
 
 		std::vector< std::string > old_paths;
-		auto new_files = adc::consolidate_multifile_logs(pattern.c_str(), old_paths);
+		// copy with 0 (= hardware concurrency) threads.
+		auto new_files = adc::consolidate_multifile_logs(pattern.c_str(), old_paths, false, 0);
 		if (old_paths.size()) {
 			for (auto i : old_paths) {
 				std::cout << "consolidating from:" << i << std::endl;
@@ -0,0 +1,469 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/adc.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef ADC_HAVE_MPI
+#include <mpi.h>
+#endif
+
+/*! \file adcLoadgen.cpp
+ * This is a load generator for comparing publishers and their
+ * configurations. Each of N threads (or N MPI ranks with -mpi) builds
+ * synthetic messages and publishes them through its own multi_publisher
+ * from factory::get_multi_publisher_from_env with the plugins named by -p
+ * (colon-separated, default env("ADC_MULTI_PUBLISHER_NAMES")), which are
+ * configured by their usual environment variables. With more than one
+ * writer, ".r<rank>" (with -mpi) or ".t<thread>" is appended to the FILE
+ * option of publishers that have one, so writers do not clobber the same
+ * file; mpifile, whose file is shared by design, is left alone.
+ *
+ * usage: adc.loadgen [-p publishers] [-n messages] [-t threads] [-s pad_bytes]
+ *        [-f fields] [-m sections] [-r rate] [-w directory]... [-o result.json] [-mpi]
+ *
+ * - messages (default 10000) are published by each thread or rank;
+ * - pad_bytes (default 256) is the size of a string field in app_data;
+ * - fields (default 8) is the number of extra numeric fields in app_data;
+ * - sections (default "app") is a comma-separated mix of app, host
+ *   (ADC_HS_OS|ADC_HS_RAMSIZE), memory, code, model and exit, added after
+ *   the header section;
+ * - rate (default 0: unlimited) is messages/second per thread or rank,
+ *   on a fixed schedule;
+ * - each -w directory is counted before and after, to report the files
+ *   the publishers created there.
+ *
+ * The report gives messages/s over the publishing wall time; p50, p99,
+ * p99.9 and max publish() latency; mean build time; the CPU time of the
+ * process and of its reaped children (subprocess publishers) per message;
+ * the processes forked on the node (from /proc/stat, so other activity on
+ * the node is included); and files created. With -o the report is also
+ * written as json.
+ *
+ * Local stand-in sinks: loadgen-http-sink.py for the curl publisher
+ * (ADC_CURL_PLUGIN_URL=http://127.0.0.1:PORT/log) and
+ * fake_ldms_message_publish.sh for the ldms_message_publish publisher
+ * (ADC_LDMS_MESSAGE_PUBLISH_PLUGIN_PROG).
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace adcLoadgen {
+
+struct gen_config {
+	std::vector<std::string> plugins;
+	uint64_t messages = 10000;
+	int threads = 1;
+	size_t pad = 256;
+	int fields = 8;
+	bool app = true;
+	bool host = false;
+	bool memory = false;
+	bool code = false;
+	bool model = false;
+	bool exit = false;
+	double rate = 0;
+	int rank = 0;
+	int ranks = 1;
+};
+
+struct thread_result {
+	std::vector<uint64_t> latency_ns;
+	uint64_t build_ns = 0;
+	uint64_t failed = 0;
+	bool started = false;
+};
+
+/// \return the non-empty parts of s between delimiters.
+std::vector<std::string> split(const std::string& s, char delimiter)
+{
+	std::vector<std::string> parts;
+	std::stringstream ss(s);
+	std::string part;
+	while (std::getline(ss, part, delimiter))
+		if (part.size())
+			parts.push_back(part);
+	return parts;
+}
+
+int usage()
+{
+	std::cerr << "usage: adc.loadgen [-p publishers] [-n messages] [-t threads] [-s pad_bytes]"
+		" [-f fields] [-m sections] [-r rate] [-w directory]... [-o result.json] [-mpi]"
+		<< std::endl;
+	return 1;
+}
+
+/**
+ * \brief build message seq of thread per the section mix in g.
+ */
+std::shared_ptr<adc::builder_api> make_message(adc::factory& f, const gen_config& g,
+	std::vector<std::string>& keys, std::string& pad, uint64_t seq, int thread)
+{
+	auto b = f.get_builder();
+	b->add_header_section("adc_loadgen");
+	if (g.host)
+		b->add_host_section(ADC_HS_OS | ADC_HS_RAMSIZE);
+	if (g.app) {
+		auto app_data = f.get_builder();
+		app_data->add("seq", seq);
+		app_data->add("thread", (int64_t)thread);
+		for (int k = 0; k < g.fields; k++)
+			app_data->add(keys[k], 0.5 * (seq + k));
+		if (pad.size())
+			app_data->add("pad", pad);
+		b->add_app_data_section(app_data);
+	}
+	if (g.memory)
+		b->add_memory_usage_section();
+	if (g.code) {
+		auto version = f.get_builder();
+		version->add("version", "1.0.0");
+		b->add_code_section("adc_loadgen", version, f.get_builder());
+	}
+	if (g.model) {
+		auto model_data = f.get_builder();
+		model_data->add("step", seq);
+		model_data->add("nx", 128);
+		b->add_model_data_section(model_data);
+	}
+	if (g.exit)
+		b->add_exit_data_section(0, "ok", f.get_builder());
+	return b;
+}
+
+/**
+ * \brief make the publishers of one thread as get_multi_publisher_from_env
+ * does, but with the thread index in the FILE option if threads share the process.
+ */
+std::shared_ptr<adc::multi_publisher_api> make_publishers(adc::factory& f,
+	const gen_config& g, int thread)
+{
+	std::vector<std::string> plugins = g.plugins;
+	if (g.threads * g.ranks < 2)
+		return f.get_multi_publisher_from_env(plugins);
+	std::string suffix;
+	if (g.ranks > 1)
+		suffix += ".r" + std::to_string(g.rank);
+	if (g.threads > 1)
+		suffix += ".t" + std::to_string(thread);
+	auto mp = f.get_multi_publisher();
+	for (const auto& name : plugins) {
+		auto p = f.get_publisher(name);
+		if (!p)
+			continue;
+		std::map<std::string, std::string> opts;
+		const auto& defaults = p->get_option_defaults();
+		auto it = defaults.find("FILE");
+		if (it != defaults.end() && name != "mpifile") {
+			std::string var = "ADC_" + name + "_PLUGIN_FILE";
+			std::transform(var.begin(), var.end(), var.begin(), ::toupper);
+			const char *file = getenv(var.c_str());
+			opts["FILE"] = (file ? std::string(file) : it->second) + suffix;
+		}
+		if (p->config(opts) || p->initialize())
+			continue;
+		mp->add(p);
+	}
+	return mp;
+}
+
+/**
+ * \brief publish g.messages messages from one thread or rank into r.
+ */
+void generate(const gen_config& g, int thread, thread_result& r)
+{
+	typedef std::chrono::steady_clock clock;
+	adc::factory f;
+	auto mp = make_publishers(f, g, thread);
+	if (mp->get_names().size() != g.plugins.size()) {
+		std::cerr << "adc.loadgen: thread " << thread << " started "
+			<< mp->get_names().size() << " of " << g.plugins.size()
+			<< " publishers" << std::endl;
+		mp->terminate();
+		return;
+	}
+	r.started = true;
+	std::vector<std::string> keys;
+	for (int k = 0; k < g.fields; k++)
+		keys.push_back("f" + std::to_string(k));
+	std::string pad(g.pad, 'x');
+	r.latency_ns.reserve(g.messages);
+	auto next = clock::now();
+	auto period = std::chrono::nanoseconds(g.rate > 0 ? (int64_t)(1e9 / g.rate) : 0);
+	for (uint64_t i = 0; i < g.messages; i++) {
+		if (g.rate > 0) {
+			std::this_thread::sleep_until(next);
+			next += period;
+		}
+		auto t0 = clock::now();
+		auto b = make_message(f, g, keys, pad, i, thread);
+		auto t1 = clock::now();
+		if (mp->publish(b))
+			r.failed++;
+		auto t2 = clock::now();
+		r.build_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+		r.latency_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+	}
+	mp->terminate();
+}
+
+double cpu_seconds(int who)
+{
+	struct rusage ru;
+	getrusage(who, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		1e-6 * (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+/// \return the processes forked on the node since boot.
+uint64_t forks_since_boot()
+{
+	std::ifstream in("/proc/stat");
+	std::string key;
+	uint64_t v = 0;
+	while (in >> key) {
+		if (key == "processes") {
+			in >> v;
+			break;
+		}
+		in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+	}
+	return v;
+}
+
+/// \return the regular files under the directories.
+uint64_t count_files(const std::vector<std::string>& dirs)
+{
+	uint64_t n = 0;
+	for (const auto& d : dirs) {
+		std::error_code ec;
+		for (auto it = std::filesystem::recursive_directory_iterator(d, ec);
+			!ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (it->is_regular_file(ec))
+				n++;
+		}
+	}
+	return n;
+}
+
+/// \return the nearest-rank percentile p of sorted v.
+uint64_t percentile(const std::vector<uint64_t>& v, double p)
+{
+	if (v.empty())
+		return 0;
+	size_t k = (size_t)(p / 100 * v.size());
+	return v[std::min(k, v.size() - 1)];
+}
+
+int main(int argc, char **argv) {
+	gen_config g;
+	std::string names;
+	const char *env = getenv("ADC_MULTI_PUBLISHER_NAMES");
+	if (env)
+		names = env;
+	std::vector<std::string> watch;
+	std::string output;
+	std::string mix = "app";
+	bool use_mpi = false;
+	for (int i = 1; i < argc; i++) {
+		std::string opt = argv[i];
+		if (opt == "-mpi") {
+			use_mpi = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return usage();
+		std::string v = argv[++i];
+		if (opt == "-p") {
+			names = v;
+		} else if (opt == "-n") {
+			g.messages = std::strtoull(v.c_str(), nullptr, 10);
+		} else if (opt == "-t") {
+			g.threads = std::atoi(v.c_str());
+		} else if (opt == "-s") {
+			g.pad = std::strtoul(v.c_str(), nullptr, 10);
+		} else if (opt == "-f") {
+			g.fields = std::atoi(v.c_str());
+		} else if (opt == "-m") {
+			mix = v;
+		} else if (opt == "-r") {
+			g.rate = std::strtod(v.c_str(), nullptr);
+		} else if (opt == "-w") {
+			watch.push_back(v);
+		} else if (opt == "-o") {
+			output = v;
+		} else {
+			return usage();
+		}
+	}
+	g.app = false;
+	for (const auto& s : split(mix, ',')) {
+		if (s == "app") g.app = true;
+		else if (s == "host") g.host = true;
+		else if (s == "memory") g.memory = true;
+		else if (s == "code") g.code = true;
+		else if (s == "model") g.model = true;
+		else if (s == "exit") g.exit = true;
+		else if (s.size()) return usage();
+	}
+	g.plugins = split(names, ':');
+	if (g.plugins.empty() || g.messages == 0 || g.threads < 1 || g.fields < 0 || g.rate < 0)
+		return usage();
+
+	int rank = 0;
+	int ranks = 1;
+	if (use_mpi) {
+#ifdef ADC_HAVE_MPI
+		MPI_Init(&argc, &argv);
+		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+		MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+		g.threads = 1;
+		g.rank = rank;
+		g.ranks = ranks;
+#else
+		std::cerr << "adc.loadgen: built without MPI" << std::endl;
+		return 1;
+#endif
+	}
+
+	uint64_t files0 = rank == 0 ? count_files(watch) : 0;
+	uint64_t forks0 = forks_since_boot();
+	double cpu0 = cpu_seconds(RUSAGE_SELF);
+	double child0 = cpu_seconds(RUSAGE_CHILDREN);
+#ifdef ADC_HAVE_MPI
+	if (use_mpi)
+		MPI_Barrier(MPI_COMM_WORLD);
+#endif
+	auto start = std::chrono::steady_clock::now();
+	std::vector<thread_result> results(g.threads);
+	std::vector<std::thread> workers;
+	for (int t = 1; t < g.threads; t++)
+		workers.emplace_back(generate, std::cref(g), t, std::ref(results[t]));
+	generate(g, use_mpi ? rank : 0, results[0]);
+	for (auto& w : workers)
+		w.join();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double cpu = cpu_seconds(RUSAGE_SELF) - cpu0;
+	double child = cpu_seconds(RUSAGE_CHILDREN) - child0;
+
+	std::vector<uint64_t> lat;
+	uint64_t build_ns = 0;
+	uint64_t failed = 0;
+	int started = 0;
+	for (auto& r : results) {
+		lat.insert(lat.end(), r.latency_ns.begin(), r.latency_ns.end());
+		build_ns += r.build_ns;
+		failed += r.failed;
+		started += r.started;
+	}
+#ifdef ADC_HAVE_MPI
+	if (use_mpi) {
+		// gather latencies on rank 0; sum the counters; take the slowest wall time.
+		int n = lat.size();
+		std::vector<int> counts(ranks), displs(ranks);
+		MPI_Gather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+		std::vector<uint64_t> all;
+		if (rank == 0) {
+			int total = 0;
+			for (int i = 0; i < ranks; i++) {
+				displs[i] = total;
+				total += counts[i];
+			}
+			all.resize(total);
+		}
+		MPI_Gatherv(lat.data(), n, MPI_UINT64_T, all.data(), counts.data(), displs.data(),
+			MPI_UINT64_T, 0, MPI_COMM_WORLD);
+		lat.swap(all);
+		double sums[2] = { cpu, child }, tsums[2];
+		MPI_Reduce(sums, tsums, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+		cpu = tsums[0];
+		child = tsums[1];
+		uint64_t counters[2] = { build_ns, failed }, tcounters[2];
+		MPI_Reduce(counters, tcounters, 2, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+		build_ns = tcounters[0];
+		failed = tcounters[1];
+		int tstarted;
+		MPI_Reduce(&started, &tstarted, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+		started = tstarted;
+		double twall;
+		MPI_Reduce(&wall, &twall, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		wall = twall;
+	}
+#endif
+	uint64_t forks = forks_since_boot() - forks0;
+	int workers_total = use_mpi ? ranks : g.threads;
+	int rc = 0;
+	if (rank == 0) {
+		uint64_t files = count_files(watch) - files0;
+		uint64_t msgs = lat.size();
+		std::sort(lat.begin(), lat.end());
+		double rate = wall > 0 ? msgs / wall : 0;
+		double per_msg = msgs ? 1.0 / msgs : 0;
+		std::cout << std::fixed << std::setprecision(1)
+			<< "publishers " << names << " " << (use_mpi ? "ranks " : "threads ")
+			<< workers_total << " messages " << msgs << " failed " << failed << std::endl
+			<< "messages/s " << rate << std::endl
+			<< "publish ns p50 " << percentile(lat, 50) << " p99 " << percentile(lat, 99)
+			<< " p99.9 " << percentile(lat, 99.9) << " max " << (msgs ? lat.back() : 0) << std::endl
+			<< "build ns mean " << build_ns * per_msg << std::endl
+			<< "cpu us/message self " << 1e6 * cpu * per_msg
+			<< " children " << 1e6 * child * per_msg << std::endl
+			<< "processes forked on node " << forks << " files created " << files << std::endl;
+		if (output.size()) {
+			std::ofstream out(output);
+			out << "{\"benchmark\":\"adc.loadgen\",\"publishers\":\"" << names
+				<< "\",\"sections\":\"" << mix << "\",\"pad_bytes\":" << g.pad
+				<< ",\"fields\":" << g.fields << ",\"rate\":" << g.rate
+				<< ",\"" << (use_mpi ? "ranks" : "threads") << "\":" << workers_total
+				<< ",\"messages\":" << msgs << ",\"failed\":" << failed
+				<< ",\"wall_s\":" << wall << ",\"messages_per_s\":" << rate
+				<< ",\"publish_ns_p50\":" << percentile(lat, 50)
+				<< ",\"publish_ns_p99\":" << percentile(lat, 99)
+				<< ",\"publish_ns_p999\":" << percentile(lat, 99.9)
+				<< ",\"publish_ns_max\":" << (msgs ? lat.back() : 0)
+				<< ",\"build_ns_mean\":" << build_ns * per_msg
+				<< ",\"cpu_s_self\":" << cpu << ",\"cpu_s_children\":" << child
+				<< ",\"processes_forked_on_node\":" << forks
+				<< ",\"files_created\":" << files << "}" << std::endl;
+			if (!out) {
+				std::cerr << "adc.loadgen: unable to write " << output << std::endl;
+				rc = 1;
+			}
+		}
+		if (started != workers_total || failed)
+			rc = 1;
+	}
+#ifdef ADC_HAVE_MPI
+	if (use_mpi)
+		MPI_Finalize();
+#endif
+	return rc;
+}
+
+} // adcLoadgen
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::adcLoadgen::main(argc, argv);
+}
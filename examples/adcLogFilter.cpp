@@ -0,0 +1,106 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/*! \file adcLogFilter.cpp
+ * This prints the records of adct-json logs selected by header fields,
+ * using the factory log reader.
+ *
+ * usage: adc.log.filter [-a application] [-u uuid] [-w wfid]
+ *        [-b begin_seconds] [-e end_seconds] [-c] file...
+ *
+ * -a, -u, and -w may be repeated; a record matches if it has any of the
+ * values given for each. -b and -e bound /header/timestamp as [begin, end).
+ * With -c, only the counts and elapsed time are printed, to stderr.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace adcLogFilter {
+
+int usage()
+{
+	std::cerr << "usage: adc.log.filter [-a application] [-u uuid] [-w wfid]"
+		" [-b begin_seconds] [-e end_seconds] [-c] file..." << std::endl;
+	return 1;
+}
+
+/**
+ * \brief print the selected records, one per line.
+ */
+int main(int argc, char **argv) {
+	adc::log_filter filter;
+	bool count_only = false;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		std::string opt = argv[i];
+		if (opt == "-c") {
+			count_only = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return usage();
+		const char *v = argv[++i];
+		if (opt == "-a") {
+			filter.application.insert(v);
+		} else if (opt == "-u") {
+			filter.uuid.insert(v);
+		} else if (opt == "-w") {
+			filter.wfid.insert(v);
+		} else if (opt == "-b") {
+			filter.timestamp_begin_ns = std::strtod(v, nullptr) * 1e9;
+		} else if (opt == "-e") {
+			filter.timestamp_end_ns = std::strtod(v, nullptr) * 1e9;
+		} else {
+			return usage();
+		}
+	}
+	if (i == argc)
+		return usage();
+
+	adc::factory f;
+	auto r = f.get_log_reader();
+	for (; i < argc; i++) {
+		int err = r->add_file(argv[i]);
+		if (err) {
+			std::cerr << argv[i] << ": " << std::strerror(err) << std::endl;
+			return 1;
+		}
+	}
+	r->set_filter(filter);
+
+	auto start = std::chrono::steady_clock::now();
+	adc::log_record rec;
+	while (r->next(rec)) {
+		if (!count_only)
+			std::cout << rec.json << '\n';
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	auto c = r->get_counts();
+	if (count_only || c.invalid) {
+		std::cerr << "records " << c.records << " selected " << c.selected
+			<< " parsed " << c.parsed << " invalid " << c.invalid
+			<< " seconds " << elapsed.count() << std::endl;
+	}
+	r->close();
+	return 0;
+}
+
+} // adcLogFilter
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::adcLogFilter::main(argc, argv);
+}
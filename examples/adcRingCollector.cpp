@@ -0,0 +1,181 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include "adc/publisher/impl/shmring.ipp"
+#include "batchForward.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*! \file adcRingCollector.cpp
+ * This is the collector for the shmring publisher. It drains the
+ * shared-memory ring written by the processes of a job on the node and
+ * forwards the messages in batches through the publishers named
+ * (colon-separated) by -p or env("ADC_RING_COLLECTOR_PUBLISHER_NAMES"),
+ * which are created and configured as by factory::get_multi_publisher_from_env.
+ * Only one collector may drain a ring.
+ *
+ * usage: adc.ring.collector [-r ring] [-p publishers] [-n batch_records]
+ *        [-t batch_ms] [-i idle_ms] [-u] [-v]
+ *
+ * The ring defaults to env("ADC_SHMRING_PLUGIN_NAME") or the per-job name
+ * the plugin uses; the collector creates it (with env("ADC_SHMRING_PLUGIN_SIZE")
+ * or the default capacity) if it starts first, and unlinks it at exit
+ * unless -u is given (to leave it for a later collector). The ring is polled every idle_ms (default 10) while empty.
+ *
+ * A batch is sent when it holds batch_records (default 256) messages or
+ * 4 MiB, or batch_ms (default 1000) after its first message. The batch
+ * message has application "adc_ring_collector" and app_data fields
+ * - records: the number of messages;
+ * - dropped: the number of messages producers dropped on a full ring
+ *   since the previous batch;
+ * - encoding: "json";
+ * - data: the json array of the messages.
+ * SIGINT and SIGTERM send the last batch and stop the collector.
+ * With -v, counts are printed at exit.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace adcRingCollector {
+
+using namespace batchForward;
+
+int usage()
+{
+	std::cerr << "usage: adc.ring.collector [-r ring] [-p publishers] [-n batch_records]"
+		" [-t batch_ms] [-i idle_ms] [-u] [-v]" << std::endl;
+	return 1;
+}
+
+/**
+ * \brief drain the ring until signaled, forwarding messages in batches.
+ */
+int main(int argc, char **argv) {
+	std::string name;
+	const char *env = getenv("ADC_SHMRING_PLUGIN_NAME");
+	if (env)
+		name = env;
+	if (name.empty())
+		name = adc::shm_ring::default_name();
+	size_t size = std::strtoul(adc::shmring_plugin::adc_shmring_plugin_size_default, nullptr, 10);
+	env = getenv("ADC_SHMRING_PLUGIN_SIZE");
+	if (env)
+		size = std::strtoul(env, nullptr, 10);
+	std::string names;
+	env = getenv("ADC_RING_COLLECTOR_PUBLISHER_NAMES");
+	if (env)
+		names = env;
+	batch b;
+	long idle_ms = 10;
+	bool unlink_ring = true;
+	bool verbose = false;
+	for (int i = 1; i < argc; i++) {
+		std::string opt = argv[i];
+		if (opt == "-v") {
+			verbose = true;
+			continue;
+		}
+		if (opt == "-u") {
+			unlink_ring = false;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return usage();
+		std::string v = argv[++i];
+		if (opt == "-r") {
+			name = v;
+		} else if (opt == "-p") {
+			names = v;
+		} else if (opt == "-n") {
+			b.max_records = std::strtoul(v.c_str(), nullptr, 10);
+		} else if (opt == "-t") {
+			b.max_ms = std::strtol(v.c_str(), nullptr, 10);
+		} else if (opt == "-i") {
+			idle_ms = std::strtol(v.c_str(), nullptr, 10);
+		} else {
+			return usage();
+		}
+	}
+	if (names.empty() || b.max_records == 0 || b.max_ms <= 0 || idle_ms <= 0)
+		return usage();
+
+	adc::factory f;
+	auto mp = start_publishers(f, names, "shmring", "adc.ring.collector");
+	if (!mp)
+		return 1;
+
+	adc::shm_ring ring;
+	int e = ring.open(name, size);
+	if (!e)
+		e = ring.lock_consumer();
+	if (e) {
+		std::cerr << "adc.ring.collector: " << name << ": " << strerror(e) << std::endl;
+		return 1;
+	}
+	catch_stop_signals();
+
+	counts c;
+	// drops before the collector started are reported with the first batch.
+	uint64_t dropped = 0;
+	auto send = [&]() {
+		uint64_t d = ring.dropped();
+		if (b.records.empty() && d == dropped)
+			return;
+		auto app_data = f.get_builder();
+		app_data->add("dropped", d - dropped);
+		dropped = d;
+		send_batch(f, *mp, "adc_ring_collector", app_data, b, false, c);
+	};
+	std::string r;
+	while (!stopping) {
+		bool got = false;
+		while (ring.read(r)) {
+			got = true;
+			c.received++;
+			if (b.add(std::move(r)))
+				send();
+		}
+		if (b.ms_left() == 0)
+			send();
+		if (!got)
+			std::this_thread::sleep_for(std::chrono::milliseconds(idle_ms));
+	}
+	while (ring.read(r)) {
+		c.received++;
+		if (b.add(std::move(r)))
+			send();
+	}
+	send();
+	mp->terminate();
+	ring.close();
+	if (unlink_ring)
+		shm_unlink(name.c_str());
+	if (verbose) {
+		std::cerr << "received " << c.received << " dropped " << dropped
+			<< " batches " << c.batches << " failed " << c.failed << std::endl;
+	}
+	return 0;
+}
+
+} // adcRingCollector
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::adcRingCollector::main(argc, argv);
+}
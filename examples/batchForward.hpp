@@ -0,0 +1,216 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef adc_examples_batchForward_hpp
+#define adc_examples_batchForward_hpp
+#include "adc/factory.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef ADC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/*! \file batchForward.hpp
+ * The batching and forwarding shared by the node-local collectors
+ * (adc.aggregator and adc.ring.collector): messages gathered from local
+ * processes are sent on in batches, each one message through the
+ * publishers named on the command line.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace batchForward {
+
+inline volatile sig_atomic_t stopping = 0;
+
+inline void on_signal(int)
+{
+	stopping = 1;
+}
+
+/**
+ * \brief set stopping on SIGINT and SIGTERM.
+ */
+inline void catch_stop_signals()
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+}
+
+/**
+ * \brief start the publishers named (colon-separated) in names, as by
+ * factory::get_multi_publisher_from_env, except the collector's own
+ * publisher self. Problems are reported with the program name prog.
+ * \return the publishers, or an empty pointer.
+ */
+inline std::shared_ptr<adc::multi_publisher_api> start_publishers(adc::factory& f,
+	const std::string& names, const std::string& self, const std::string& prog)
+{
+	std::vector<std::string> plugins;
+	for (size_t p = 0; p <= names.size(); ) {
+		size_t q = names.find(':', p);
+		if (q == std::string::npos)
+			q = names.size();
+		if (q > p)
+			plugins.push_back(names.substr(p, q - p));
+		p = q + 1;
+	}
+	for (const auto& n : plugins) {
+		if (n == self) {
+			std::cerr << prog << ": cannot forward to the " << self << " publisher" << std::endl;
+			return std::shared_ptr<adc::multi_publisher_api>();
+		}
+	}
+	auto mp = f.get_multi_publisher_from_env(plugins);
+	if (mp->get_names().empty()) {
+		std::cerr << prog << ": no publishers could be started from " << names << std::endl;
+		return std::shared_ptr<adc::multi_publisher_api>();
+	}
+	return mp;
+}
+
+/**
+ * \brief messages waiting to be sent. A batch is due when it holds
+ * max_records messages or max_bytes, or max_ms after its first message.
+ */
+struct batch {
+	std::vector<std::string> records;
+	size_t bytes = 0;
+	std::chrono::steady_clock::time_point first;
+	size_t max_records = 256;
+	size_t max_bytes = 4 * 1024 * 1024;
+	long max_ms = 1000;
+
+	/// \brief add message r. \return true if the batch is now full.
+	bool add(std::string&& r)
+	{
+		if (records.empty())
+			first = std::chrono::steady_clock::now();
+		bytes += r.size();
+		records.push_back(std::move(r));
+		return records.size() >= max_records || bytes >= max_bytes;
+	}
+
+	/// \return ms until the batch is due by age (0 if overdue), or -1 if empty.
+	int ms_left() const
+	{
+		if (records.empty())
+			return -1;
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+			first + std::chrono::milliseconds(max_ms) -
+			std::chrono::steady_clock::now()).count();
+		return left > 0 ? (int)left : 0;
+	}
+};
+
+struct counts {
+	uint64_t received = 0;
+	uint64_t batches = 0;
+	uint64_t failed = 0;
+	uint64_t raw_bytes = 0;
+	uint64_t sent_bytes = 0;
+};
+
+/**
+ * \brief return the base64 (RFC 4648) text of data.
+ */
+inline std::string base64(const unsigned char *data, size_t len)
+{
+	static const char *digits =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	out.reserve((len + 2) / 3 * 4);
+	size_t i = 0;
+	for (; i + 2 < len; i += 3) {
+		uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+		out += digits[v >> 18];
+		out += digits[(v >> 12) & 63];
+		out += digits[(v >> 6) & 63];
+		out += digits[v & 63];
+	}
+	if (i < len) {
+		uint32_t v = data[i] << 16;
+		if (i + 1 < len)
+			v |= data[i + 1] << 8;
+		out += digits[v >> 18];
+		out += digits[(v >> 12) & 63];
+		out += (i + 1 < len) ? digits[(v >> 6) & 63] : '=';
+		out += '=';
+	}
+	return out;
+}
+
+/**
+ * \brief publish the batch b as one message of application and empty it.
+ * app_data gets the fields records, encoding and data after any the
+ * caller added; with compress (and zlib), data is the base64 text of the
+ * zlib-compressed newline-separated messages, else their json array.
+ */
+inline void send_batch(adc::factory& f, adc::multi_publisher_api& mp,
+	const std::string& application, std::shared_ptr<adc::builder_api> app_data,
+	batch& b, bool compress, counts& c)
+{
+	auto msg = f.get_builder();
+	msg->add_header_section(application);
+	app_data->add("records", (uint64_t)b.records.size());
+	std::string data;
+#ifdef ADC_HAVE_ZLIB
+	if (compress) {
+		std::string lines;
+		lines.reserve(b.bytes + b.records.size());
+		for (const auto& r : b.records) {
+			lines += r;
+			lines += '\n';
+		}
+		uLongf zlen = compressBound(lines.size());
+		std::vector<unsigned char> z(zlen);
+		if (compress2(z.data(), &zlen, (const Bytef *)lines.data(), lines.size(),
+			Z_BEST_SPEED) == Z_OK) {
+			data = base64(z.data(), zlen);
+			app_data->add("encoding", "zlib+base64");
+			app_data->add("data", data);
+		} else {
+			compress = false;
+		}
+	}
+#else
+	compress = false;
+#endif
+	if (!compress) {
+		data.reserve(b.bytes + b.records.size() + 2);
+		data += '[';
+		for (size_t i = 0; i < b.records.size(); i++) {
+			if (i)
+				data += ',';
+			data += b.records[i];
+		}
+		data += ']';
+		app_data->add("encoding", "json");
+		app_data->add_json_string("data", data);
+	}
+	msg->add_app_data_section(app_data);
+	if (mp.publish(msg))
+		c.failed++;
+	c.batches++;
+	c.raw_bytes += b.bytes;
+	c.sent_bytes += data.size();
+	b.records.clear();
+	b.bytes = 0;
+}
+
+} // batchForward
+} // adc_examples
+
+/** @}*/
+#endif // adc_examples_batchForward_hpp
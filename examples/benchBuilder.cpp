@@ -0,0 +1,504 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+/*! \file benchBuilder.cpp
+ * This measures the cost of the builder operations on the publish path:
+ * scalar add() of each type, add_array() from 1 to 10^6 elements,
+ * add_host_section() for each ADC_HS_* bit, add_memory_usage_section(),
+ * get_value() and get<T>() at increasing depth, array read-back by
+ * get_value() and get_array(), and serialize() (which flattens the
+ * sections) and parse_builder() of messages from a bare header to the
+ * demoBuilder message.
+ *
+ * usage: bench.builder [-o output.json] [-t min_ms]
+ *
+ * Each case repeats its operation until min_ms (default 200) have passed,
+ * and reports ns/op and the heap allocations and bytes allocated per op.
+ * The results are written as json to output.json, or stdout, so they can
+ * be compared across commits. Scalar adds cycle through 1024 field names
+ * and start a new builder every 1024 operations.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace benchBuilder {
+
+// allocation counters maintained by the replaced global operator new.
+uint64_t alloc_count = 0;
+uint64_t alloc_bytes = 0;
+
+} // benchBuilder
+} // adc_examples
+
+void *operator new(size_t n)
+{
+	adc_examples::benchBuilder::alloc_count++;
+	adc_examples::benchBuilder::alloc_bytes += n;
+	void *p = malloc(n ? n : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace adc_examples {
+namespace benchBuilder {
+
+typedef std::chrono::steady_clock clock;
+
+struct result {
+	std::string name;
+	std::string param;
+	uint64_t ops;
+	double ns_per_op;
+	double allocs_per_op;
+	double bytes_per_op;
+};
+
+std::vector<result> results;
+double min_seconds = 0.2;
+
+/**
+ * \brief time op(i) for i = 0..n-1, growing n until min_seconds pass or
+ * max_ops is reached, and record the last batch as name/param.
+ */
+template <class F>
+void run(const std::string& name, const std::string& param, F op, uint64_t max_ops = UINT64_MAX)
+{
+	op(0); // warm up caches and lazy initialization.
+	uint64_t n = 1;
+	for (;;) {
+		uint64_t c0 = alloc_count;
+		uint64_t b0 = alloc_bytes;
+		auto start = clock::now();
+		for (uint64_t i = 0; i < n; i++)
+			op(i);
+		double sec = std::chrono::duration<double>(clock::now() - start).count();
+		if (sec >= min_seconds || n >= max_ops) {
+			results.push_back({ name, param, n, sec * 1e9 / n,
+				double(alloc_count - c0) / n, double(alloc_bytes - b0) / n });
+			std::cerr << name << " " << param << ": " << sec * 1e9 / n << " ns/op" << std::endl;
+			return;
+		}
+		double grow = sec > 0 ? 1.2 * min_seconds / sec : 100;
+		if (grow < 2)
+			grow = 2;
+		if (grow > 100)
+			grow = 100;
+		n = std::min<uint64_t>(max_ops, uint64_t(n * grow));
+	}
+}
+
+/**
+ * \brief add-time cases for each scalar type; v is added as field
+ * keys[i % 1024] of a builder renewed every 1024 operations.
+ */
+class scalar_cases {
+	adc::factory& f;
+	std::vector<std::string> keys;
+	std::shared_ptr<adc::builder_api> b;
+
+public:
+	scalar_cases(adc::factory& f) : f(f) {
+		for (int i = 0; i < 1024; i++)
+			keys.push_back("field" + std::to_string(i));
+	}
+
+	template <class T>
+	void add(const std::string& param, T v) {
+		b = f.get_builder();
+		run("add", param, [&](uint64_t i) {
+			if ((i & 1023) == 0)
+				b = f.get_builder();
+			b->add(keys[i & 1023], v);
+		});
+	}
+
+	template <class F>
+	void custom(const std::string& name, const std::string& param, F adder) {
+		b = f.get_builder();
+		run(name, param, [&](uint64_t i) {
+			if ((i & 1023) == 0)
+				b = f.get_builder();
+			adder(b, keys[i & 1023]);
+		});
+	}
+};
+
+void bench_scalars(adc::factory& f)
+{
+	scalar_cases s(f);
+	std::string str("a short string value");
+	char cstr[] = "a short c string";
+	s.add("bool", true);
+	s.add("char", 'A');
+	s.add("char16_t", u'A');
+	s.add("char32_t", U'A');
+	s.add("char*", (char *)cstr);
+	s.add("const char*", (const char *)cstr);
+	s.add("string_view", std::string_view(str));
+	s.custom("add", "string", [&](std::shared_ptr<adc::builder_api>& b, const std::string& k) {
+		b->add(k, str);
+	});
+	s.add("uint8_t", (uint8_t)std::numeric_limits<uint8_t>::max());
+	s.add("uint16_t", (uint16_t)std::numeric_limits<uint16_t>::max());
+	s.add("uint32_t", (uint32_t)std::numeric_limits<uint32_t>::max());
+	s.add("uint64_t", (uint64_t)std::numeric_limits<uint64_t>::max());
+	s.add("int8_t", (int8_t)std::numeric_limits<int8_t>::max());
+	s.add("int16_t", (int16_t)std::numeric_limits<int16_t>::max());
+	s.add("int32_t", (int32_t)std::numeric_limits<int32_t>::max());
+	s.add("int64_t", (int64_t)std::numeric_limits<int64_t>::max());
+	s.add("float", 3.14f);
+	s.add("double", 3.14);
+	s.add("complex<float>", std::complex<float>(1.5f, -2.5f));
+	s.add("complex<double>", std::complex<double>(1.5, -2.5));
+	struct timeval tv;
+	gettimeofday(&tv, nullptr);
+	s.add("timeval", tv);
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	s.add("timespec", ts);
+	s.custom("add_epoch", "int64_t", [&](std::shared_ptr<adc::builder_api>& b, const std::string& k) {
+		b->add_epoch(k, ts.tv_sec);
+	});
+	s.custom("add_path", "string_view", [&](std::shared_ptr<adc::builder_api>& b, const std::string& k) {
+		b->add_path(k, std::string_view("/usr/lib64/libc.so.6"));
+	});
+	s.custom("add_json_string", "string_view", [&](std::shared_ptr<adc::builder_api>& b, const std::string& k) {
+		b->add_json_string(k, std::string_view("{\"a\":\"b\",\"c\":[1,2,3]}"));
+	});
+	s.custom("add_number_string", "string_view", [&](std::shared_ptr<adc::builder_api>& b, const std::string& k) {
+		b->add_number_string(k, std::string_view("3.14159265358979323846"));
+	});
+}
+
+void bench_arrays(adc::factory& f)
+{
+	const size_t max_len = 1000000;
+	std::vector<int32_t> ia(max_len);
+	std::vector<uint64_t> ua(max_len);
+	std::vector<double> da(max_len);
+	std::vector<std::string> sv(max_len);
+	std::vector<const char *> ca(max_len);
+	for (size_t i = 0; i < max_len; i++) {
+		ia[i] = -(int32_t)i;
+		ua[i] = UINT64_MAX - i;
+		da[i] = 3.14 * i;
+		sv[i] = "s" + std::to_string(i);
+		ca[i] = sv[i].c_str();
+	}
+	auto b = f.get_builder();
+	for (size_t len = 1; len <= max_len; len *= 10) {
+		std::string n = std::to_string(len);
+		run("add_array", "int32_t[" + n + "]", [&](uint64_t) {
+			b->add_array("a", ia.data(), len);
+		});
+		run("add_array", "uint64_t[" + n + "]", [&](uint64_t) {
+			b->add_array("a", ua.data(), len);
+		});
+		run("add_array", "double[" + n + "]", [&](uint64_t) {
+			b->add_array("a", da.data(), len);
+		});
+		run("add_array", "const char*[" + n + "]", [&](uint64_t) {
+			b->add_array("a", ca.data(), len);
+		});
+	}
+}
+
+void bench_sections(adc::factory& f)
+{
+	const std::pair<std::string, adc::adc_hs_subsection_flags> bits[] = {
+		{ "ADC_HS_BASE", ADC_HS_BASE },
+		{ "ADC_HS_OS", ADC_HS_OS },
+		{ "ADC_HS_RAMSIZE", ADC_HS_RAMSIZE },
+		{ "ADC_HS_ENV", ADC_HS_ENV },
+		{ "ADC_HS_CPU", ADC_HS_CPU },
+		{ "ADC_HS_GPU", ADC_HS_GPU },
+		{ "ADC_HS_NUMA", ADC_HS_NUMA },
+		{ "ADC_HS_ALL", ADC_HS_ALL }
+	};
+	auto b = f.get_builder();
+	for (const auto& bit : bits) {
+		run("add_host_section", bit.first, [&](uint64_t) {
+			b->add_host_section(bit.second);
+		});
+	}
+	run("add_memory_usage_section", "", [&](uint64_t) {
+		b->add_memory_usage_section();
+	});
+	run("add_header_section", "", [&](uint64_t) {
+		b->add_header_section("bench_builder");
+	});
+}
+
+void bench_get_value(adc::factory& f)
+{
+	// sections nested 4 deep, each with a scalar x.
+	auto b = f.get_builder();
+	b->add_header_section("bench_builder");
+	std::shared_ptr<adc::builder_api> s = b;
+	std::string path;
+	std::vector<std::string> paths;
+	for (int depth = 1; depth <= 4; depth++) {
+		s->add("x", (int64_t)depth);
+		paths.push_back(path + "/x");
+		if (depth < 4) {
+			auto child = f.get_builder();
+			s->add_section("s" + std::to_string(depth), child);
+			path += "/s" + std::to_string(depth);
+			s = child;
+		}
+	}
+	for (size_t d = 0; d < paths.size(); d++) {
+		run("get_value", "depth " + std::to_string(d + 1), [&](uint64_t) {
+			if (b->get_value_int64(paths[d]) != (int64_t)d + 1)
+				abort();
+		});
+	}
+	for (size_t d = 0; d < paths.size(); d++) {
+		run("get<int64_t>", "depth " + std::to_string(d + 1), [&](uint64_t) {
+			if (b->get<int64_t>(paths[d]) != (int64_t)d + 1)
+				abort();
+		});
+	}
+	run("get_value", "/header/application", [&](uint64_t) {
+		if (!b->get_value_string("/header/application"))
+			abort();
+	});
+
+	// read back arrays as analysis tools do.
+	for (size_t n = 1000; n <= 1000000; n *= 1000) {
+		std::vector<double> v(n, 1.5);
+		auto a = f.get_builder();
+		a->add_array("v", v.data(), n);
+		std::string label = std::to_string(n) + " double";
+		run("get_value array", label, [&](uint64_t) {
+			if (a->get_value("v").count != n)
+				abort();
+		});
+		std::vector<double> out;
+		run("get_array", label, [&](uint64_t) {
+			if (a->get_array("v", out) || out.size() != n)
+				abort();
+		});
+	}
+}
+
+/**
+ * \brief fill b as demoBuilder does, less the slow host subsections.
+ */
+void populate_demo(adc::factory& f, std::shared_ptr<adc::builder_api> b)
+{
+	auto app_data = f.get_builder();
+	app_data->add("bool0", false);
+	app_data->add("char1", 'A');
+	app_data->add("c16", u'A');
+	app_data->add("c32", U'A');
+	std::string cppstr("cppstr");
+	app_data->add("cppstr", cppstr);
+	app_data->add("cstr1", "cstr_nul");
+	app_data->add_json_string("jstr1", std::string("{\"a\":\"b\", \"c\":[1,2, 3]}"));
+	app_data->add("u8", std::numeric_limits<uint8_t>::max());
+	app_data->add("u16", std::numeric_limits<uint16_t>::max());
+	app_data->add("u32", std::numeric_limits<uint32_t>::max());
+	app_data->add("u64", std::numeric_limits<uint64_t>::max());
+	app_data->add("i8", std::numeric_limits<int8_t>::max());
+	app_data->add("i16", std::numeric_limits<int16_t>::max());
+	app_data->add("i32", std::numeric_limits<int32_t>::max());
+	app_data->add("i64", std::numeric_limits<int64_t>::max());
+	app_data->add("flt", std::numeric_limits<float>::max());
+	app_data->add("dbl", std::numeric_limits<double>::max());
+	app_data->add("fcplx", std::complex<float>(1, 2));
+	app_data->add("dcplx", std::complex<double>(1, 2));
+	const char *cstrings[] = { "a", "B", "c2" };
+	int ia[4] = { 0, -1, -2, -3 };
+	double da[4] = { 0, 3.14, 6.28, 9.42 };
+	uint64_t ua64[4] = { UINT64_MAX, UINT64_MAX - 1, UINT64_MAX - 2, UINT64_MAX - 3 };
+	app_data->add_array("cstrs", cstrings, 3);
+	app_data->add_array("ia", ia, 4);
+	app_data->add_array("da", da, 4);
+	app_data->add_array("ua64", ua64, 4);
+	b->add_header_section("cxx_demo_1");
+	b->add_host_section(ADC_HS_OS | ADC_HS_RAMSIZE);
+	b->add_app_data_section(app_data);
+	b->add_memory_usage_section();
+	auto version = f.get_builder();
+	version->add("version", "1.1.2");
+	const char *tags[] = { "boca_raton", "saronida_2" };
+	version->add_array("tags", tags, 2);
+	b->add_code_section("repartitioner", version, f.get_builder());
+	b->add_code_configuration_section(f.get_builder());
+	auto model_data = f.get_builder();
+	model_data->add("nx", 3);
+	model_data->add("ny", 10);
+	b->add_model_data_section(model_data);
+	auto status_details = f.get_builder();
+	status_details->add("tmax", 15000.25);
+	status_details->add("step", 234);
+	b->add_exit_data_section(1, "we didn't succeed due to high temperatures", status_details);
+}
+
+void bench_serialize(adc::factory& f)
+{
+	std::vector<std::pair<std::string, std::shared_ptr<adc::builder_api> > > shapes;
+
+	auto header = f.get_builder();
+	header->add_header_section("bench_builder");
+	shapes.push_back({ "header", header });
+
+	auto small = f.get_builder();
+	small->add_header_section("bench_builder");
+	auto app_data = f.get_builder();
+	for (int i = 0; i < 10; i++)
+		app_data->add("v" + std::to_string(i), (int64_t)i);
+	small->add_app_data_section(app_data);
+	shapes.push_back({ "header+10 scalars", small });
+
+	auto nested = f.get_builder();
+	nested->add_header_section("bench_builder");
+	std::shared_ptr<adc::builder_api> s = nested;
+	for (int depth = 1; depth <= 4; depth++) {
+		auto child = f.get_builder();
+		for (int i = 0; i < 10; i++)
+			child->add("v" + std::to_string(i), (int64_t)i);
+		s->add_section("s" + std::to_string(depth), child);
+		s = child;
+	}
+	shapes.push_back({ "4 nested sections", nested });
+
+	auto demo = f.get_builder();
+	populate_demo(f, demo);
+	shapes.push_back({ "demoBuilder", demo });
+
+	auto big = f.get_builder();
+	big->add_header_section("bench_builder");
+	std::vector<double> da(10000);
+	for (size_t i = 0; i < da.size(); i++)
+		da[i] = 0.5 * i;
+	auto big_data = f.get_builder();
+	big_data->add_array("da", da.data(), da.size());
+	big->add_app_data_section(big_data);
+	shapes.push_back({ "double[10000]", big });
+
+	for (auto& shape : shapes) {
+		size_t bytes = shape.second->serialize().size();
+		run("serialize", shape.first + " (" + std::to_string(bytes) + " bytes)", [&](uint64_t) {
+			if (shape.second->serialize().empty())
+				abort();
+		});
+		std::string text = shape.second->serialize();
+		run("parse_builder", shape.first + " (" + std::to_string(bytes) + " bytes)", [&](uint64_t) {
+			if (!f.parse_builder(text))
+				abort();
+		});
+		run("parse_builder lazy", shape.first + " (" + std::to_string(bytes) + " bytes)", [&](uint64_t) {
+			if (!f.parse_builder(text, ADC_PARSE_LAZY))
+				abort();
+		});
+	}
+}
+
+void write_json(std::ostream& out)
+{
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	out << "{\"benchmark\":\"bench.builder\",\"builder_version\":\""
+		<< adc::builder_api_version.name << "\",\"host\":\"" << host
+		<< "\",\"time\":" << time(nullptr) << ",\"compiler\":\"" << __VERSION__
+		<< "\",\"min_ms\":" << min_seconds * 1000 << ",\"results\":[";
+	for (size_t i = 0; i < results.size(); i++) {
+		const result& r = results[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":\"" << r.name << "\",\"param\":\"" << r.param
+			<< "\",\"ops\":" << r.ops << ",\"ns_per_op\":" << r.ns_per_op
+			<< ",\"allocs_per_op\":" << r.allocs_per_op
+			<< ",\"bytes_per_op\":" << r.bytes_per_op << "}";
+	}
+	out << "\n]}" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::string output;
+	for (int i = 1; i < argc; i++) {
+		std::string opt = argv[i];
+		if (i + 1 < argc && opt == "-o") {
+			output = argv[++i];
+		} else if (i + 1 < argc && opt == "-t") {
+			min_seconds = std::strtod(argv[++i], nullptr) / 1000;
+		} else {
+			std::cerr << "usage: bench.builder [-o output.json] [-t min_ms]" << std::endl;
+			return 1;
+		}
+	}
+	if (min_seconds <= 0)
+		min_seconds = 0.2;
+
+	adc::factory f;
+	bench_scalars(f);
+	bench_arrays(f);
+	bench_sections(f);
+	bench_get_value(f);
+	bench_serialize(f);
+
+	if (output.empty()) {
+		write_json(std::cout);
+		return 0;
+	}
+	std::ofstream out(output);
+	write_json(out);
+	if (!out) {
+		std::cerr << "bench.builder: unable to write " << output << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+} // benchBuilder
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::benchBuilder::main(argc, argv);
+}
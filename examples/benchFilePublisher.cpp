@@ -0,0 +1,134 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <vector>
+
+/*! \file benchFilePublisher.cpp
+ * This measures the publish throughput of the file-oriented publishers
+ * under each buffering and flush policy, for a range of message sizes.
+ * The memory-mapped and io_uring publishers are included for comparison.
+ *
+ * usage: bench.file.publisher [output_directory [messages_per_case]]
+ *
+ * The output directory defaults to ./test.outputs; run it on the file
+ * system of interest (e.g. NFS or Lustre) to see the syscall cost per record.
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace benchFilePublisher {
+
+struct bench_case {
+	std::string plugin;
+	std::string flush;
+	size_t payload;
+};
+
+/**
+ * \brief time count publications of b through a freshly configured plugin.
+ * \return seconds elapsed including finalize, or a negative value on error.
+ */
+double time_case(adc::factory& f, const bench_case& c, const std::string& dir,
+		std::shared_ptr<adc::builder_api> b, size_t count)
+{
+	std::map<std::string, std::string> opts = {
+		{ "DIRECTORY", dir },
+		{ "FILE", "bench." + c.flush + ".log" },
+		{ "FLUSH", c.flush },
+		{ "FLUSH_COUNT", "64" },
+		{ "FLUSH_MS", "100" }
+	};
+	if (c.plugin == "uringfile") {
+		// room for the largest case in one registered buffer.
+		opts["BUFFER_SIZE"] = "4194304";
+	}
+	auto p = f.get_publisher(c.plugin, opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize " << c.plugin << std::endl;
+		return -1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; i++) {
+		if (p->publish(b)) {
+			std::cout << "publish failed for " << c.plugin << std::endl;
+			p->finalize();
+			return -1;
+		}
+	}
+	p->finalize();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+ * \brief report messages/second and MB/second for file and multifile
+ * publishers under each flush policy.
+ */
+int main(int argc, char **argv) {
+	std::string dir = "./test.outputs";
+	size_t count = 10000;
+	if (argc > 1)
+		dir = argv[1];
+	if (argc > 2)
+		count = std::strtoul(argv[2], nullptr, 10);
+
+	adc::factory f;
+	std::vector<bench_case> cases;
+	for (auto plugin : { "file", "multifile" }) {
+		for (size_t payload : { 256, 4096, 65536 }) {
+			for (auto flush : { "record", "count", "interval", "finalize" }) {
+				cases.push_back({ plugin, flush, payload });
+			}
+		}
+	}
+	// mmapfile has no flush policy; the mapping is written back by the kernel.
+	for (size_t payload : { 256, 4096, 65536 }) {
+		cases.push_back({ "mmapfile", "mapped", payload });
+	}
+	// synchronous writes vs io_uring submission for 1KB-1MB records.
+	for (size_t payload : { 1024, 16384, 131072, 1048576 }) {
+		cases.push_back({ "file", "record", payload });
+		cases.push_back({ "uringfile", "record", payload });
+		cases.push_back({ "uringfile", "buffer", payload });
+	}
+
+	std::cout << std::left << std::setw(10) << "plugin" << std::setw(10) << "flush"
+		<< std::setw(10) << "bytes" << std::setw(14) << "msg/s"
+		<< "MB/s" << std::endl;
+	for (const auto& c : cases) {
+		auto b = f.get_builder();
+		b->add_header_section("bench_file_publisher");
+		auto app_data = f.get_builder();
+		app_data->add("pad", std::string(c.payload, 'x'));
+		b->add_app_data_section(app_data);
+		size_t msg_size = b->serialize().size();
+
+		double sec = time_case(f, c, dir, b, count);
+		if (sec <= 0)
+			return 1;
+		std::cout << std::left << std::setw(10) << c.plugin << std::setw(10) << c.flush
+			<< std::setw(10) << msg_size << std::setw(14) << std::fixed
+			<< std::setprecision(0) << count / sec
+			<< std::setprecision(1) << (count * msg_size) / sec / 1.0e6 << std::endl;
+	}
+	return 0;
+}
+
+} // benchFilePublisher
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::benchFilePublisher::main(argc, argv);
+}
@@ -0,0 +1,32 @@
+#! /bin/bash
+# Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# This is a stand-in for ldms_message_publish (and ldmsd_stream_publish)
+# for load tests with adc.loadgen, where no ldmsd is running:
+#   export ADC_LDMS_MESSAGE_PUBLISH_PLUGIN_PROG=$PWD/fake_ldms_message_publish.sh
+# It accepts the same arguments, reads the message given with -f, and
+# appends its size to $FAKE_LDMS_LOG if set. Like the real program, it
+# deletes the input file unless it is /proc/self/fd/0 (the message is
+# in memory on stdin).
+f=""
+while test $# -gt 0; do
+	case "$1" in
+	-f) f="$2"; shift ;;
+	esac
+	shift
+done
+if test "x$f" = "x"; then
+	echo "expected -f json input filename" 1>&2
+	exit 1
+fi
+n=$(wc -c < "$f")
+if test -n "$FAKE_LDMS_LOG"; then
+	echo "$n" >> "$FAKE_LDMS_LOG"
+fi
+case "$f" in
+/proc/self/fd/*) ;;
+*) /bin/rm -f "$f" ;;
+esac
+exit 0
@@ -0,0 +1,64 @@
+#! /usr/bin/env python3
+# Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# This is a local stand-in for the ADC ingest server, for load tests of
+# the curl publisher with adc.loadgen:
+#   ./loadgen-http-sink.py 8080 &
+#   export ADC_CURL_PLUGIN_URL=http://127.0.0.1:8080/log
+# It answers each POST with 200 and the json {"collection": ..., "bytes": N},
+# echoing the body too with --echo. At SIGINT or SIGTERM it prints the
+# requests and bytes received.
+import json
+import signal
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from threading import Lock
+
+counts = {"requests": 0, "bytes": 0}
+lock = Lock()
+echo = "--echo" in sys.argv
+
+
+class Sink(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        n = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(n)
+        with lock:
+            counts["requests"] += 1
+            counts["bytes"] += n
+        reply = {"collection": "loadgen", "bytes": n}
+        if echo:
+            reply["body"] = body.decode("utf-8", "replace")
+        data = json.dumps(reply).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, *args):
+        pass
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != "--echo"]
+    port = int(args[0]) if args else 8080
+    server = ThreadingHTTPServer(("127.0.0.1", port), Sink)
+
+    def stop(*_):
+        raise KeyboardInterrupt
+
+    signal.signal(signal.SIGTERM, stop)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("requests %d bytes %d" % (counts["requests"], counts["bytes"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,17 +1,22 @@
 #! /bin/bash
 # This is example input for the adc script_plugin publisher.
 #
-# arguments: name of a file containint one json object
+# arguments: name of a file containing one json object
 #
 # requirements:
 # This script can do anything else the user wants, but the
-# last thing it must do is delete the input file given.
+# last thing it must do is delete the input file given, unless
+# it is /proc/self/fd/0 (with PAYLOAD memfd, the message is in
+# memory on stdin).
 if test "x$1" = "x"; then
 	echo "expected json input filename" 1>&2
 	exit 1
 fi
 json_reformat < $1 >> test.outputs/script
-/bin/rm $1
+case "$1" in
+/proc/self/fd/*) ;;
+*) /bin/rm $1 ;;
+esac
 # Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
 #
 # SPDX-License-Identifier: BSD-3-Clause
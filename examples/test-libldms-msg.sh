@@ -0,0 +1,34 @@
+#! /bin/bash
+# Test the libldms_msg publisher against a private ldmsd on this host.
+# usage: test-libldms-msg.sh [port]
+# ldmsd and ldmsd_controller (ldms 4.5 or later) must be in PATH.
+port=${1:-10412}
+rm -rf test.outputs
+mkdir -p test.outputs
+. ./test-env-publishers
+export ADC_MULTI_PUBLISHER_NAMES=libldms_msg
+export ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_AUTH=none
+export ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_HOST=localhost
+export ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_PORT=$port
+export ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_DEBUG=1
+
+ldmsd -x sock:$port -a none -l test.outputs/ldmsd.log -r test.outputs/ldmsd.pid -v INFO
+sleep 1
+if ! test -s test.outputs/ldmsd.pid; then
+	echo "ldmsd did not start; see test.outputs/ldmsd.log"
+	exit 1
+fi
+../inst-mpi/bin/adc.hello.world.auto
+rc=$?
+ldmsd_controller -x sock -p $port -h localhost -a none --cmd "msg_stats" > test.outputs/msg_stats
+kill $(cat test.outputs/ldmsd.pid)
+if test $rc = 0 && grep -q "$ADC_LIBLDMS_MSG_PUBLISH_PLUGIN_TAG" test.outputs/msg_stats; then
+	echo "libldms_msg ok"
+else
+	echo "libldms_msg failed; see test.outputs/msg_stats"
+	exit 1
+fi
+# Copyright 2025 NTESS. See the top-level LICENSE.txt file for details.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
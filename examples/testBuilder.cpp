@@ -190,6 +190,30 @@ void roundtrip_string(const char *name, const char *val, adc::scalar_type cptype
 #endif
 
 
+// check the typed accessors against fields added by populate_builder.
+static void check_typed_get(std::shared_ptr< adc::builder_api > b, int32_t *ia, double *da, size_t count)
+{
+	std::cerr << "typed get " << std::flush;
+	auto i32 = b->get<int32_t>("i32");
+	auto wrong = b->get<int64_t>("i32");
+	auto str = b->get<std::string>("jstr1");
+	std::vector<double> dv;
+	std::vector<int32_t> iv;
+	double small[1];
+	size_t n = 0;
+	if (!i32 || *i32 != std::numeric_limits<int32_t>::max() / 2 || wrong || !str ||
+		b->get_array("da", dv) || dv.size() != count ||
+		memcmp(dv.data(), da, sizeof(double)*count) ||
+		b->get_array("ia", iv) || memcmp(iv.data(), ia, sizeof(int32_t)*count) ||
+		b->get_array("ia", dv) != EDOM ||
+		b->get_array("da", small, 1, n) != ERANGE || n != count ||
+		b->get_array("nosuch", dv) != ENOENT) {
+		std::cerr << "BAD" << std::endl;
+	} else {
+		std::cerr << "ok" << std::endl;
+	}
+}
+
 void populate_builder(std::shared_ptr< adc::builder_api > b, adc::factory & f) {
 #if ADC_BOOST_JSON_PUBLIC
 	boost::json::object jo = {{"a","b"},{"C","d"},{"n",1}};
@@ -310,6 +334,7 @@ void populate_builder(std::shared_ptr< adc::builder_api > b, adc::factory & f) {
 	ROUNDTRIP_ARRAY("ua", ua, 4, uint64_t, cp_uint64);
 	ROUNDTRIP_ARRAY("fa", fa, 4, float, cp_f32);
 	ROUNDTRIP_ARRAY("da", da, 4, double, cp_f64);
+	check_typed_get(b, ia, da, 4);
 
 	b->add_array("nulembed", "a\0b", 3);
 	ROUNDTRIP_ARRAY("nulembed", "a\0b", 3, const char, cp_char);
@@ -390,6 +415,31 @@ void populate_builder(std::shared_ptr< adc::builder_api > b, adc::factory & f) {
 	std::cout << "-------------------------------" << std::endl;
 }
 
+// check that b parses back to the same record, eagerly and lazily.
+static void check_parse_builder(std::shared_ptr< adc::builder_api > b, adc::factory & f)
+{
+	std::string ss = b->serialize();
+	for (adc_parse_flags flags : { ADC_PARSE_DEFAULT, ADC_PARSE_LAZY }) {
+		std::cerr << "parse_builder " << flags << " " << std::flush;
+		auto p = f.parse_builder(ss, flags);
+		if (!p) {
+			std::cerr << "BAD: no builder" << std::endl;
+			continue;
+		}
+		auto str = p->get<std::string>("cstr1");
+		auto i32 = p->get<int32_t>("i32");
+		if (boost::json::parse(p->serialize()) != boost::json::parse(ss) ||
+			!str || str != b->get<std::string>("cstr1") ||
+			!i32 || *i32 != *b->get<int32_t>("i32") ||
+			!p->get_section("adc_workflow") || f.parse_builder("[1]") ||
+			f.parse_builder("{\"a\":") ) {
+			std::cerr << "BAD" << std::endl;
+		} else {
+			std::cerr << "ok" << std::endl;
+		}
+	}
+}
+
 int main(int /* argc */ , char ** /* argv */)
 {
 	std::cout << "adc pub version: " << adc::publisher_api_version.name << std::endl;
@@ -401,6 +451,7 @@ int main(int /* argc */ , char ** /* argv */)
 	std::shared_ptr< adc::builder_api > b = f.get_builder();
 
 	populate_builder(b, f);
+	check_parse_builder(b, f);
 
 #if 1 // switch to 0 when developing new fields and testing them
 	std::shared_ptr< adc::publisher_api > p0 = f.get_publisher("none");
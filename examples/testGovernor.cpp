@@ -0,0 +1,90 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+/*! \file testGovernor.cpp
+ * This checks the overhead governor of the multi_publisher with no
+ * critical publishers: publishing in a tight loop against a 1% budget
+ * must pause the file publisher, and the adc_governor pause record must
+ * still reach the file before it is paused.
+ *
+ * usage: test.governor [output_file]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testGovernor {
+
+int main(int argc, char **argv) {
+	std::string path = "test.outputs.governor.log";
+	if (argc > 1)
+		path = argv[1];
+	unlink(path.c_str());
+	// the governor reads its settings when the multi_publisher is made.
+	setenv("ADC_MULTI_PUBLISHER_BUDGET", "1", 1);
+	setenv("ADC_MULTI_PUBLISHER_BUDGET_WINDOW", "0.01", 1);
+	unsetenv("ADC_MULTI_PUBLISHER_CRITICAL");
+
+	adc::factory f;
+	std::map<std::string, std::string> opts = {
+		{ "DIRECTORY", "." },
+		{ "FILE", path }
+	};
+	auto p = f.get_publisher("file", opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize file publisher" << std::endl;
+		return 1;
+	}
+	auto m = f.get_multi_publisher();
+	m->add(p);
+
+	auto b = f.get_builder();
+	b->add_header_section("test_governor");
+	auto app_data = f.get_builder();
+	app_data->add("filler", std::string(1000, 'x'));
+	b->add_app_data_section(app_data);
+	auto start = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200))
+		m->publish(b);
+	m->terminate();
+
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string log = ss.str();
+	int e = 0;
+	size_t g = log.find("adc_governor");
+	if (g == std::string::npos) {
+		std::cout << "no adc_governor record in " << path << std::endl;
+		e++;
+	} else if (log.find("\"pause\"", g) == std::string::npos) {
+		std::cout << "adc_governor record is not a pause" << std::endl;
+		e++;
+	}
+	unlink(path.c_str());
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testGovernor
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testGovernor::main(argc, argv);
+}
@@ -0,0 +1,128 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+/*! \file testRateLimit.cpp
+ * This checks the token bucket of the ratelimit publisher decorating the
+ * file publisher: a burst of BURST messages passes and the rest yield
+ * EAGAIN, tokens come back at RATE per second, an exit_data message
+ * always passes, a summary is written at finalize, and PUBLISHER_FILE
+ * given only in the environment (ADC_RATELIMIT_PLUGIN_PUBLISHER_FILE)
+ * reaches the file publisher.
+ *
+ * usage: test.ratelimit [output_file]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testRateLimit {
+
+/// \return the number of records in the file at path.
+int count_records(const std::string& path)
+{
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string log = ss.str();
+	int n = 0;
+	for (size_t p = log.find("<adct-json>"); p != std::string::npos;
+		p = log.find("<adct-json>", p + 1))
+		n++;
+	return n;
+}
+
+int main(int argc, char **argv) {
+	std::string path = "test.outputs.ratelimit.log";
+	if (argc > 1)
+		path = argv[1];
+	unlink(path.c_str());
+	setenv("ADC_RATELIMIT_PLUGIN_PUBLISHER_FILE", path.c_str(), 1);
+
+	adc::factory f;
+	std::map<std::string, std::string> opts = {
+		{ "PUBLISHER", "file" },
+		{ "PUBLISHER_DIRECTORY", "." },
+		{ "RATE", "10" },
+		{ "BURST", "5" },
+		{ "SUMMARY_SECONDS", "0" }
+	};
+	auto p = f.get_publisher("ratelimit", opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize ratelimit publisher" << std::endl;
+		return 1;
+	}
+	auto b = f.get_builder();
+	b->add_header_section("test_ratelimit");
+	int e = 0;
+
+	// the bucket starts full: BURST pass, the rest are refused.
+	int passed = 0, limited = 0;
+	for (int i = 0; i < 20; i++) {
+		int rc = p->publish(b);
+		if (!rc)
+			passed++;
+		else if (rc == EAGAIN)
+			limited++;
+	}
+	if (passed != 5 || limited != 15) {
+		std::cout << "burst: passed " << passed << " limited " << limited << std::endl;
+		e++;
+	}
+
+	// 10 per second refills about 3 tokens in 300 ms.
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	int refilled = 0;
+	for (int i = 0; i < 10; i++)
+		if (!p->publish(b))
+			refilled++;
+	if (refilled < 2 || refilled > 4) {
+		std::cout << "refill: passed " << refilled << " after 300 ms" << std::endl;
+		e++;
+	}
+
+	// exit_data passes with the bucket empty.
+	auto x = f.get_builder();
+	x->add_header_section("test_ratelimit");
+	x->add_exit_data_section(0, "done", f.get_builder());
+	if (p->publish(x)) {
+		std::cout << "exit_data message was limited" << std::endl;
+		e++;
+	}
+	p->finalize();
+
+	// the messages passed, the exit_data one, and the final summary.
+	int expected = passed + refilled + 2;
+	int records = count_records(path);
+	if (records != expected) {
+		std::cout << path << " has " << records << " records, expected "
+			<< expected << std::endl;
+		e++;
+	}
+	unlink(path.c_str());
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testRateLimit
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testRateLimit::main(argc, argv);
+}
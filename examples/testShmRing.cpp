@@ -0,0 +1,135 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/publisher/impl/shmring.ipp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/*! \file testShmRing.cpp
+ * This checks the shm_ring used by the shmring publisher: records come
+ * out in order across the wrap, a full ring and an oversized record are
+ * refused and counted as dropped, and a reservation left uncommitted by a
+ * producer that died while copying its record is skipped after stall_ms
+ * instead of stalling the consumer.
+ *
+ * usage: test.shmring [ring_name]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testShmRing {
+
+int main(int argc, char **argv) {
+	std::string name = "/adc-test-ring-" + std::to_string(getpid());
+	if (argc > 1)
+		name = argv[1];
+	shm_unlink(name.c_str());
+	adc::shm_ring ring;
+	int rc = ring.open(name, 4096);
+	if (rc) {
+		std::cout << "open " << name << ": " << strerror(rc) << std::endl;
+		return 1;
+	}
+	int e = 0;
+	std::string out;
+
+	// in order, across several wraps.
+	for (int i = 0; i < 200; i++) {
+		std::string m = "record " + std::to_string(i) + std::string(i % 50, 'x');
+		if (ring.write(m.data(), m.size())) {
+			std::cout << "write " << i << " failed" << std::endl;
+			e++;
+		}
+		if (!ring.read(out) || out != m) {
+			std::cout << "read " << i << " got '" << out << "'" << std::endl;
+			e++;
+		}
+	}
+	if (ring.read(out)) {
+		std::cout << "read from an empty ring" << std::endl;
+		e++;
+	}
+
+	// full and oversized.
+	std::string big(1000, 'b');
+	int full = 0;
+	for (int i = 0; i < 10; i++)
+		if (ring.write(big.data(), big.size()) == EAGAIN)
+			full++;
+	std::string huge(ring.capacity(), 'h');
+	if (ring.write(huge.data(), huge.size()) != EMSGSIZE) {
+		std::cout << "oversized record not refused" << std::endl;
+		e++;
+	}
+	if (!full || ring.dropped() != (uint64_t)full + 1) {
+		std::cout << "full " << full << " dropped " << ring.dropped() << std::endl;
+		e++;
+	}
+	while (ring.read(out))
+		;
+
+	// a producer dying inside write: its source page is unreadable, so it
+	// faults in the copy after reserving and marking its record.
+	uint64_t before = ring.dropped();
+	pid_t pid = fork();
+	if (pid == 0) {
+		adc::shm_ring child;
+		if (child.open(name, 4096))
+			_exit(2);
+		void *bad = mmap(nullptr, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		child.write(static_cast<const char *>(bad), 100);
+		_exit(3);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (!WIFSIGNALED(status)) {
+		std::cout << "producer did not die in write" << std::endl;
+		e++;
+	}
+	std::string after = "after the dead producer";
+	ring.write(after.data(), after.size());
+	ring.stall_ms = 50;
+	if (ring.read(out)) {
+		std::cout << "read past an uncommitted record before stall_ms" << std::endl;
+		e++;
+	}
+	auto start = std::chrono::steady_clock::now();
+	bool got = false;
+	while (!got && std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+		got = ring.read(out);
+		if (!got)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (!got || out != after) {
+		std::cout << "consumer stalled on the dead producer's record" << std::endl;
+		e++;
+	}
+	if (ring.dropped() != before + 1) {
+		std::cout << "skipped record not counted as dropped" << std::endl;
+		e++;
+	}
+
+	ring.close();
+	shm_unlink(name.c_str());
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testShmRing
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testShmRing::main(argc, argv);
+}
@@ -0,0 +1,166 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+/*! \file testSpool.cpp
+ * This checks the spool publisher decorating the curl publisher, with
+ * PROG a script standing in for curl that fails while the file "down"
+ * exists and otherwise logs a line per nonempty payload: messages
+ * published while the endpoint is down are spooled and survive
+ * finalize, a later process
+ * replays them once it is up, and the spool files are then removed.
+ * PUBLISHER_PROG is given only in the environment
+ * (ADC_SPOOL_PLUGIN_PUBLISHER_PROG), so it must reach the curl publisher.
+ *
+ * usage: test.spool [output_directory]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testSpool {
+
+namespace fs = std::filesystem;
+
+/// \return the number of deliveries logged in the file at path.
+int count_deliveries(const std::string& path)
+{
+	std::ifstream in(path);
+	std::string line;
+	int n = 0;
+	while (std::getline(in, line))
+		n++;
+	return n;
+}
+
+/// \return the number of spool files under dir.
+int count_spools(const std::string& dir)
+{
+	std::error_code ec;
+	int n = 0;
+	for (auto it = fs::recursive_directory_iterator(dir, ec);
+		!ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+		if (it->path().extension() == ".spool")
+			n++;
+	return n;
+}
+
+/// \brief wait up to seconds for done() to hold. \return done().
+template <typename F>
+bool wait_for(F done, int seconds)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	while (!done() && std::chrono::steady_clock::now() < end)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	return done();
+}
+
+int main(int argc, char **argv) {
+	std::string dir = "test.outputs.spool";
+	if (argc > 1)
+		dir = argv[1];
+	std::error_code ec;
+	fs::remove_all(dir, ec);
+	fs::create_directories(dir, ec);
+	dir = fs::absolute(dir).string();
+	std::string down = dir + "/down";
+	std::string log = dir + "/curl.log";
+	std::string spools = dir + "/spool";
+	std::string prog = dir + "/fakecurl.sh";
+	{
+		std::ofstream s(prog);
+		s << "#!/bin/sh\n"
+			"f=\"\"\n"
+			"while [ $# -gt 0 ]; do case \"$1\" in -d) f=\"${2#@}\"; shift;; esac; shift; done\n"
+			"[ -e " << down << " ] && exit 7\n"
+			"[ -s \"$f\" ] || exit 1\n"
+			"echo delivered >> " << log << "\n";
+	}
+	fs::permissions(prog, fs::perms::owner_all, ec);
+	setenv("ADC_SPOOL_PLUGIN_PUBLISHER_PROG", prog.c_str(), 1);
+
+	adc::factory f;
+	std::map<std::string, std::string> opts = {
+		{ "PUBLISHER", "curl" },
+		{ "PUBLISHER_URL", "http://localhost/test_spool" },
+		{ "DIRECTORY", spools },
+		{ "RETRY_MIN_MS", "100" },
+		{ "RETRY_MAX_MS", "400" }
+	};
+	auto b = f.get_builder();
+	b->add_header_section("test_spool");
+	int e = 0;
+	const int n = 5;
+
+	// endpoint down: every message ends up in the spool.
+	std::ofstream(down).close();
+	auto p = f.get_publisher("spool", opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize spool publisher" << std::endl;
+		return 1;
+	}
+	for (int i = 0; i < n; i++)
+		if (p->publish(b)) {
+			std::cout << "publish " << i << " failed while down" << std::endl;
+			e++;
+		}
+	p->finalize();
+	if (count_deliveries(log) != 0 || count_spools(spools) != 1) {
+		std::cout << "down: " << count_deliveries(log) << " delivered, "
+			<< count_spools(spools) << " spool files" << std::endl;
+		e++;
+	}
+
+	// endpoint up: a new publisher drains what the first one left.
+	unlink(down.c_str());
+	p = f.get_publisher("spool", opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize second spool publisher" << std::endl;
+		return 1;
+	}
+	if (!wait_for([&]() { return count_deliveries(log) == n; }, 10)) {
+		std::cout << "replayed " << count_deliveries(log) << " of " << n << std::endl;
+		e++;
+	}
+	if (p->publish(b)) {
+		std::cout << "publish failed while up" << std::endl;
+		e++;
+	}
+	p->finalize();
+	if (count_deliveries(log) != n + 1) {
+		std::cout << "up: " << count_deliveries(log) << " delivered, expected "
+			<< n + 1 << std::endl;
+		e++;
+	}
+	if (count_spools(spools)) {
+		std::cout << "spool files left after replay" << std::endl;
+		e++;
+	}
+
+	fs::remove_all(dir, ec);
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testSpool
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testSpool::main(argc, argv);
+}
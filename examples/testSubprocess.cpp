@@ -0,0 +1,173 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/publisher/impl/subprocess.ipp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+/*! \file testSubprocess.cpp
+ * This checks the process launch shared by the publishers that run a
+ * program per message: option parsing (split_words, parse_affinity),
+ * launch reporting the child's exit status, deliver handing a payload to
+ * the child in a memfd or in a scratch file that is removed afterward,
+ * and launch_limiter running at most max_inflight children, queueing at
+ * most max_queued and refusing the rest.
+ *
+ * usage: test.subprocess [output_prefix]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testSubprocess {
+
+/// \return the content of the file at path.
+std::string slurp(const std::string& path)
+{
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+/// \brief wait up to seconds for done() to hold. \return done().
+template <typename F>
+bool wait_for(F done, int seconds)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	while (!done() && std::chrono::steady_clock::now() < end)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return done();
+}
+
+int main(int argc, char **argv) {
+	std::string prefix = "test.outputs.subprocess." + std::to_string(getpid());
+	if (argc > 1)
+		prefix = argv[1];
+	int e = 0;
+
+	// option parsing.
+	auto words = adc::subprocess::split_words("  curl -k\t-s ");
+	if (words != std::vector<std::string>({ "curl", "-k", "-s" })) {
+		std::cout << "split_words gave " << words.size() << " words" << std::endl;
+		e++;
+	}
+	cpu_set_t set;
+	bool use;
+	if (adc::subprocess::parse_affinity("0-1,3", set, use) || !use ||
+		CPU_COUNT(&set) != 3 || !CPU_ISSET(3, &set) || CPU_ISSET(2, &set)) {
+		std::cout << "parse_affinity 0-1,3 failed" << std::endl;
+		e++;
+	}
+	if (adc::subprocess::parse_affinity("", set, use) || use) {
+		std::cout << "parse_affinity of an empty value set affinity" << std::endl;
+		e++;
+	}
+	if (adc::subprocess::parse_affinity("3-1", set, use) != EINVAL ||
+		adc::subprocess::parse_affinity("x", set, use) != EINVAL) {
+		std::cout << "parse_affinity accepted a bad list" << std::endl;
+		e++;
+	}
+
+	// launch reports the exit status; a missing program is an error.
+	adc::subprocess::options o;
+	std::atomic<int> status(-2);
+	if (adc::subprocess::launch({ "sh", "-c", "exit 3" }, o, "", true,
+		[&status](int s) { status = s; })) {
+		std::cout << "launch of sh failed" << std::endl;
+		e++;
+	}
+	if (!wait_for([&]() { return status != -2; }, 5) ||
+		!WIFEXITED(status) || WEXITSTATUS(status) != 3) {
+		std::cout << "launch reported status " << status << std::endl;
+		e++;
+	}
+	if (!adc::subprocess::launch({ "/nonexistent/adc-test-program" }, o)) {
+		std::cout << "launch of a missing program succeeded" << std::endl;
+		e++;
+	}
+
+	// deliver, in a memfd and in a scratch file.
+	const std::string msg = "{\"test\":\"subprocess\"}";
+	for (bool memfd : { true, false }) {
+		std::string out = prefix + (memfd ? ".memfd" : ".file");
+		std::string scratch = prefix + ".scratch";
+		unlink(out.c_str());
+		std::atomic<bool> done(false);
+		int rc = adc::subprocess::deliver(msg, memfd,
+			[&scratch]() { return scratch; },
+			[&](const std::string& path, int fd) {
+				adc::subprocess::options so;
+				so.stdin_fd = fd;
+				if (memfd && path != adc::subprocess::stdin_path)
+					return EINVAL;
+				return adc::subprocess::launch(
+					{ "sh", "-c", "cat \"$0\" > \"$1\"", path, out }, so,
+					fd < 0 ? path : "", true, [&done](int) { done = true; });
+			}, "test");
+		if (rc || !wait_for([&]() { return done.load(); }, 5) ||
+			slurp(out) != msg) {
+			std::cout << "deliver (memfd " << memfd << ") gave '" << slurp(out)
+				<< "'" << std::endl;
+			e++;
+		}
+		if (access(scratch.c_str(), F_OK) == 0) {
+			std::cout << "scratch file " << scratch << " left behind" << std::endl;
+			e++;
+		}
+		unlink(out.c_str());
+	}
+
+	// launch_limiter: 1 running and 2 queued; the 4th is refused.
+	adc::publisher_stats stats;
+	{
+		adc::launch_limiter limiter;
+		limiter.configure(1, 2);
+		limiter.attach(&stats);
+		std::atomic<int> finished(0);
+		int refused = 0;
+		for (int i = 0; i < 4; i++) {
+			int rc = limiter.launch({ "sh", "-c", "sleep 0.2; exit " + std::to_string(i) },
+				o, "", false, [&finished](int) { finished++; });
+			if (rc == EAGAIN)
+				refused++;
+			else if (rc)
+				e++;
+		}
+		if (refused != 1 || !wait_for([&]() { return finished == 3; }, 10)) {
+			std::cout << "limiter: refused " << refused << " finished "
+				<< finished << std::endl;
+			e++;
+		}
+		auto s = stats.get();
+		if (s.inflight_max != 1 || s.queued_max != 2 || s.delivered != 1 ||
+			s.delivery_failures != 2 || s.delivery_codes[2] != 1) {
+			std::cout << "limiter stats: inflight_max " << s.inflight_max
+				<< " queued_max " << s.queued_max << " delivered " << s.delivered
+				<< " failures " << s.delivery_failures << std::endl;
+			e++;
+		}
+	}
+
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testSubprocess
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testSubprocess::main(argc, argv);
+}
@@ -0,0 +1,160 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*! \file testSyslogSocket.cpp
+ * This checks the socket transport of the syslog publisher against a
+ * local datagram socket standing in for /dev/log: a message larger than
+ * CHUNK_SIZE must arrive as sequenced RFC 5424 chunks that reassemble to
+ * the published json, and a full socket must drop messages (EAGAIN)
+ * rather than block.
+ *
+ * usage: test.syslog.socket [socket_path]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testSyslogSocket {
+
+/**
+ * \brief extract the value of param="..." from frame f, or "".
+ */
+std::string sd_param(const std::string& f, const std::string& param)
+{
+	std::string key = " " + param + "=\"";
+	size_t p = f.find(key);
+	if (p == std::string::npos)
+		return "";
+	p += key.size();
+	return f.substr(p, f.find('"', p) - p);
+}
+
+/**
+ * \brief return the MSG part of frame f: the text after the structured data.
+ */
+std::string frame_msg(const std::string& f)
+{
+	// the header has 6 space-separated fields before the structured data.
+	size_t p = 0;
+	for (int i = 0; i < 6; i++)
+		p = f.find(' ', p) + 1;
+	if (f[p] == '-')
+		return f.substr(p + 2);
+	return f.substr(f.find("] ", p) + 2);
+}
+
+int main(int argc, char **argv) {
+	std::string path = "./test.outputs.syslog.sock";
+	if (argc > 1)
+		path = argv[1];
+	unlink(path.c_str());
+	int s = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+	if (s < 0 || bind(s, (struct sockaddr *)&sa, sizeof(sa))) {
+		std::cout << "unable to bind " << path << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	adc::factory f;
+	std::map<std::string, std::string> opts = {
+		{ "TRANSPORT", "socket" },
+		{ "SOCKET", path },
+		{ "CHUNK_SIZE", "4096" }
+	};
+	auto p = f.get_publisher("syslog", opts);
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize syslog socket publisher" << std::endl;
+		return 1;
+	}
+	auto b = f.get_builder();
+	b->add_header_section("test_syslog_socket");
+	auto app_data = f.get_builder();
+	app_data->add("filler", std::string(10000, 'x'));
+	b->add_app_data_section(app_data);
+	std::string json = b->serialize();
+
+	int e = 0;
+	if (p->publish(b)) {
+		std::cout << "publish failed" << std::endl;
+		e++;
+	}
+	std::string joined, id;
+	size_t total = 0;
+	for (size_t seq = 1; total == 0 || seq <= total; seq++) {
+		char buf[8192];
+		ssize_t n = recv(s, buf, sizeof(buf), MSG_DONTWAIT);
+		if (n <= 0) {
+			std::cout << "missing chunk " << seq << std::endl;
+			e++;
+			break;
+		}
+		std::string frame(buf, n);
+		if (frame.size() > 4096 || frame.compare(0, 5, "<14>1") != 0 ||
+			sd_param(frame, "seq") != std::to_string(seq)) {
+			std::cout << "bad frame " << seq << ": " << frame.substr(0, 120) << std::endl;
+			e++;
+		}
+		if (seq == 1) {
+			id = sd_param(frame, "uuid");
+			total = std::stoul("0" + sd_param(frame, "total"));
+		} else if (sd_param(frame, "uuid") != id) {
+			std::cout << "chunk " << seq << " uuid mismatch" << std::endl;
+			e++;
+		}
+		joined += frame_msg(frame);
+	}
+	if (total < 2 || joined != json) {
+		std::cout << "reassembly failed: " << total << " chunks" << std::endl;
+		e++;
+	} else {
+		std::cout << "reassembled " << json.size() << " bytes from " << total << " chunks" << std::endl;
+	}
+
+	// nobody reads now; the socket fills and publish must not block.
+	int drops = 0;
+	for (int i = 0; i < 10000 && !drops; i++) {
+		int err = p->publish(b);
+		if (err == EAGAIN)
+			drops++;
+		else if (err) {
+			std::cout << "unexpected publish error " << strerror(err) << std::endl;
+			e++;
+			break;
+		}
+	}
+	if (!drops) {
+		std::cout << "full socket did not drop" << std::endl;
+		e++;
+	}
+	p->finalize();
+	close(s);
+	unlink(path.c_str());
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testSyslogSocket
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testSyslogSocket::main(argc, argv);
+}
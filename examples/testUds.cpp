@@ -0,0 +1,138 @@
+/* Copyright 2026 NTESS. See the top-level LICENSE.txt file for details.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "adc/factory.hpp"
+#include "adc/publisher/impl/uds.ipp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*! \file testUds.cpp
+ * This checks the uds publisher against a stand-in for adc.aggregator:
+ * the default socket is per user, a missing aggregator is not fatal at
+ * initialize and makes publish return ENOTCONN, each message arrives as
+ * one packet once the aggregator is listening, and publish reconnects
+ * by itself after the aggregator restarts.
+ *
+ * usage: test.uds [socket_path]
+ */
+
+/** \addtogroup examples
+ *  @{
+ */
+
+namespace adc_examples {
+namespace testUds {
+
+/// \brief listen on path as adc.aggregator does. \return the socket or -1.
+int listen_at(const std::string& path)
+{
+	int s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+	unlink(path.c_str());
+	if (s < 0 || bind(s, (struct sockaddr *)&sa, sizeof(sa)) || listen(s, 4)) {
+		std::cout << "listen " << path << ": " << strerror(errno) << std::endl;
+		if (s >= 0)
+			close(s);
+		return -1;
+	}
+	return s;
+}
+
+/// \return the next packet on connection c, or "" on error.
+std::string receive(int c)
+{
+	char buf[65536];
+	ssize_t n = recv(c, buf, sizeof(buf), 0);
+	return n > 0 ? std::string(buf, n) : std::string();
+}
+
+int main(int argc, char **argv) {
+	std::string path = "test.outputs.uds." + std::to_string(getpid()) + ".sock";
+	if (argc > 1)
+		path = argv[1];
+	unlink(path.c_str());
+	int e = 0;
+
+	adc::factory f;
+	auto p = f.get_publisher("uds", { { "SOCKET", path }, { "RETRY_MS", "50" } });
+	std::string mine = "/" + std::to_string(geteuid()) + "/";
+	if (adc::uds_plugin::default_socket().find(mine) == std::string::npos) {
+		std::cout << "default socket " << adc::uds_plugin::default_socket()
+			<< " is not per user" << std::endl;
+		e++;
+	}
+
+	// no aggregator yet.
+	if (!p || p->initialize()) {
+		std::cout << "unable to initialize uds publisher" << std::endl;
+		return 1;
+	}
+	auto b = f.get_builder();
+	b->add_header_section("test_uds");
+	std::string msg = b->serialize();
+	if (p->publish(b) != ENOTCONN) {
+		std::cout << "publish without an aggregator did not fail" << std::endl;
+		e++;
+	}
+
+	// the aggregator starts; publish connects after RETRY_MS.
+	int l = listen_at(path);
+	if (l < 0)
+		return 1;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	for (int i = 0; i < 3; i++)
+		if (p->publish(b)) {
+			std::cout << "publish " << i << " failed" << std::endl;
+			e++;
+		}
+	int c = accept(l, nullptr, nullptr);
+	for (int i = 0; i < 3; i++)
+		if (receive(c) != msg) {
+			std::cout << "packet " << i << " is not the message" << std::endl;
+			e++;
+		}
+
+	// the aggregator restarts; the next publish reconnects.
+	close(c);
+	close(l);
+	l = listen_at(path);
+	if (l < 0)
+		return 1;
+	if (p->publish(b)) {
+		std::cout << "publish after the aggregator restarted failed" << std::endl;
+		e++;
+	} else {
+		c = accept(l, nullptr, nullptr);
+		if (receive(c) != msg) {
+			std::cout << "no packet after the aggregator restarted" << std::endl;
+			e++;
+		}
+		close(c);
+	}
+	p->finalize();
+	close(l);
+	unlink(path.c_str());
+	std::cout << (e ? "FAIL" : "PASS") << std::endl;
+	return e;
+}
+
+} // testUds
+} // adc_examples
+
+/** @}*/
+
+int main(int argc, char **argv)
+{
+	return adc_examples::testUds::main(argc, argv);
+}